@@ -0,0 +1,444 @@
+/** \file
+ * Microbenchmarks of the robot's hot paths, built against the simulated devices.
+ *
+ * Components are made the way the robot makes them, so their tasks keep running in the
+ * background while they are timed.  make bench writes the results to bench.json in the build
+ * directory and bench/compare_bench.py holds them up against bench/baseline.json.
+ *
+ * Script tokens are timed twice: compiling lines of each token, and Execute for the tokens the
+ * script task finishes by itself.  The commands answered by another component cost a message
+ * round trip, which has a benchmark of its own.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "WPILib.h"
+
+#include "ADXRS453Z.h"
+#include "AutoParser.h"
+#include "Autonomous.h"
+#include "Blackboard.h"
+#include "ComponentBase.h"
+#include "Drivetrain.h"
+#include "InputBindings.h"
+#include "InputShaper.h"
+#include "JoystickMonitor.h"
+#include "RobotParams.h"
+#include "Trajectory.h"
+
+const char* const BENCH_TASKNAME = "tBench";
+const char* const BENCH_QUEUE = "/tmp/qBench";
+const char* const BENCH_REPLY_QUEUE = "/tmp/qBenchReply";
+const int BENCH_SCRIPT_LINES = 100;			//copies of a line per compile, so the per line cost shows
+
+///Answers every COMMAND_COMPONENT_TEST, as little as a component can do for a round trip
+class EchoComponent : public ComponentBase
+{
+public:
+	EchoComponent() : ComponentBase(BENCH_TASKNAME, BENCH_QUEUE, COMPONENT_PRIORITY)
+	{
+		pTask = new Task(BENCH_TASKNAME, (FUNCPTR) &EchoComponent::StartTask,
+				COMPONENT_PRIORITY, COMPONENT_STACKSIZE);
+		pTask->Start((intptr_t)this);
+	}
+
+	static void *StartTask(void *pThis)
+	{
+		((EchoComponent *)pThis)->DoWork();
+		return(NULL);
+	}
+
+private:
+	void OnStateChange() {};
+
+	void Run()
+	{
+		if(localMessage.command == COMMAND_COMPONENT_TEST)
+		{
+			SendCommandResponse(COMMAND_SYSTEM_OK);
+		}
+	}
+};
+
+///Reaches the private hot paths, and makes each component once for every benchmark to share
+struct RobotBench
+{
+	static Drivetrain *GetDrivetrain()
+	{
+		static Drivetrain *pDrivetrain = new Drivetrain();
+		return(pDrivetrain);
+	}
+
+	static Autonomous *GetAutonomous()
+	{
+		static Autonomous *pAutonomous = new Autonomous();
+		return(pAutonomous);
+	}
+
+	static void KiwiDrive(float x, float y, float r)
+	{
+		GetDrivetrain()->KiwiDrive(x, y, r);
+	}
+
+	static bool Execute(const AutoInstruction &instruction)
+	{
+		return(GetAutonomous()->Execute(instruction));
+	}
+
+	static short AssembleSensorData(unsigned char *data)
+	{
+		return(ADXRS453Z::assemble_sensor_data(data));
+	}
+
+	static void CheckParity(unsigned char *command)
+	{
+		ADXRS453Z::check_parity(command);
+	}
+
+	static int Bits(unsigned char val)
+	{
+		return(ADXRS453Z::bits(val));
+	}
+};
+
+static void BM_KiwiDrive(benchmark::State &state, float x, float y, float r)
+{
+	RobotBench::GetDrivetrain();
+
+	for(auto _ : state)
+	{
+		RobotBench::KiwiDrive(x, y, r);
+	}
+
+	RobotBench::KiwiDrive(0.0, 0.0, 0.0);
+}
+
+BENCHMARK_CAPTURE(BM_KiwiDrive, hold_heading, 0.5f, 0.25f, 0.0f);
+BENCHMARK_CAPTURE(BM_KiwiDrive, turning, 0.5f, 0.25f, 0.5f);
+
+///Compiles iCopies of szLines, formatted with the copy number so MODE lines can differ
+static void BM_Compile(benchmark::State &state, const char *szLines, int iCopies)
+{
+	AutoProgram program;
+	std::string script;
+	char szCopy[128];
+	int iLines = 0;
+
+	for(int i = 0; i < iCopies; i++)
+	{
+		snprintf(szCopy, sizeof(szCopy), szLines, i);
+		script += szCopy;
+		script += '\n';
+	}
+
+	for(unsigned i = 0; i < script.size(); i++)
+	{
+		iLines += (script[i] == '\n');
+	}
+
+	std::istringstream check(script);
+
+	if(!program.Compile(check))
+	{
+		state.SkipWithError(program.GetErrors()[0].c_str());
+		return;
+	}
+
+	for(auto _ : state)
+	{
+		std::istringstream stream(script);
+
+		benchmark::DoNotOptimize(program.Compile(stream));
+	}
+
+	state.SetItemsProcessed(state.iterations() * iLines);
+}
+
+BENCHMARK_CAPTURE(BM_Compile, START, "START", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, FINISH, "FINISH", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, MODE, "MODE %d", AUTO_MAX_MODES);
+BENCHMARK_CAPTURE(BM_Compile, DEBUG, "DEBUG 1", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, MESSAGE, "MESSAGE both delays start now", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, BEGIN, "BEGIN", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, END, "END", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, DELAY, "DELAY 1.5", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, PARALLEL_JOIN, "PARALLEL\nJOIN", BENCH_SCRIPT_LINES / 2);
+BENCHMARK_CAPTURE(BM_Compile, RACE_JOIN, "RACE\nJOIN", BENCH_SCRIPT_LINES / 2);
+BENCHMARK_CAPTURE(BM_Compile, WAIT_UNTIL, "WAIT_UNTIL HEADING >= 90", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, DRIVE_DISTANCE, "DRIVE_DISTANCE 0.6 48.0 4.0", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, TURN_ANGLE, "TURN_ANGLE 0.5 -90.0", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, DRIVE_TIME, "DRIVE_TIME 0.4 1.5", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, PATH, "PATH 60 120  0 0 0  24 36 0  48 48 90", BENCH_SCRIPT_LINES);
+BENCHMARK_CAPTURE(BM_Compile, TRAJECTORY, "TRAJECTORY scoring.traj", BENCH_SCRIPT_LINES);
+
+///Generates the trajectory for the PATH in szLine, what the planner does for a path not in the cache
+static void BM_TrajectoryGenerate(benchmark::State &state, const char *szLine)
+{
+	AutoProgram program;
+	std::istringstream stream(szLine);
+	Trajectory trajectory;
+
+	if(!program.Compile(stream))
+	{
+		state.SkipWithError(program.GetErrors()[0].c_str());
+		return;
+	}
+
+	const AutoPath &path = program.GetPath(0);
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(trajectory.Generate(&path.waypoints[0], path.waypoints.size(), path.limits));
+	}
+
+	state.counters["samples"] = trajectory.GetSize();
+}
+
+BENCHMARK_CAPTURE(BM_TrajectoryGenerate, straight, "PATH 60 120  0 0 0  0 96 0");
+BENCHMARK_CAPTURE(BM_TrajectoryGenerate, scoring, "PATH 60 120  0 0 0  24 36 0  48 48 90");
+BENCHMARK_CAPTURE(BM_TrajectoryGenerate, long_turning, "PATH 80 100  0 0 0  24 48 45  72 96 90  120 96 180  168 48 270");
+
+/** Executes instruction uTimed of szLines, running the ones around it once so blocks close.
+ *
+ * Only tokens the script task finishes itself are here.  MESSAGE and END print every time, and
+ * the rest wait on another component or a sensor for most of their time.
+ */
+static void BM_Execute(benchmark::State &state, const char *szLines, unsigned uTimed)
+{
+	AutoProgram program;
+	std::istringstream stream(szLines);
+
+	RobotBench::GetAutonomous();
+
+	if(!program.Compile(stream))
+	{
+		state.SkipWithError(program.GetErrors()[0].c_str());
+		return;
+	}
+
+	for(unsigned i = 0; i < uTimed; i++)
+	{
+		RobotBench::Execute(program.GetInstruction(i));
+	}
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(RobotBench::Execute(program.GetInstruction(uTimed)));
+	}
+
+	for(unsigned i = uTimed + 1; i < program.GetSize(); i++)
+	{
+		RobotBench::Execute(program.GetInstruction(i));
+	}
+}
+
+BENCHMARK_CAPTURE(BM_Execute, START, "START", 0);
+BENCHMARK_CAPTURE(BM_Execute, FINISH, "FINISH", 0);
+BENCHMARK_CAPTURE(BM_Execute, MODE, "MODE 0", 0);
+BENCHMARK_CAPTURE(BM_Execute, DEBUG, "DEBUG 0", 0);
+BENCHMARK_CAPTURE(BM_Execute, BEGIN, "BEGIN", 0);
+BENCHMARK_CAPTURE(BM_Execute, PARALLEL, "PARALLEL\nJOIN", 0);
+BENCHMARK_CAPTURE(BM_Execute, RACE, "RACE\nJOIN", 0);
+BENCHMARK_CAPTURE(BM_Execute, JOIN, "PARALLEL\nJOIN", 1);
+BENCHMARK_CAPTURE(BM_Execute, DELAY, "DELAY 0", 0);
+
+///The raw 32 bit SPI words from a gyro turning at a few degrees/s either way
+static void BM_GyroAssembleSensorData(benchmark::State &state)
+{
+	unsigned char data[2][4] = { { 0x04, 0x01, 0x90, 0x01 }, { 0x07, 0xfe, 0x70, 0x00 } };
+	unsigned uWord = 0;
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(RobotBench::AssembleSensorData(data[uWord++ & 1]));
+	}
+}
+
+BENCHMARK(BM_GyroAssembleSensorData);
+
+static void BM_GyroCheckParity(benchmark::State &state)
+{
+	unsigned char command[4];
+
+	for(auto _ : state)
+	{
+		command[0] = 0x20;
+		command[1] = 0x00;
+		command[2] = 0x00;
+		command[3] = 0x00;
+		RobotBench::CheckParity(command);
+		benchmark::DoNotOptimize(command);
+	}
+}
+
+BENCHMARK(BM_GyroCheckParity);
+
+static void BM_GyroBits(benchmark::State &state)
+{
+	unsigned char uByte = 0;
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(RobotBench::Bits(uByte++));
+	}
+}
+
+BENCHMARK(BM_GyroBits);
+
+///One message to a component and its response back, the cost of every autonomous command
+static void BM_ComponentRoundTrip(benchmark::State &state)
+{
+	static EchoComponent *pEcho = new EchoComponent();
+	RobotMessage message;
+	RobotMessage response;
+	int iReply;
+
+	// read write so the component can open it without waiting for us
+
+	mkfifo(BENCH_REPLY_QUEUE, 0666);
+	iReply = open(BENCH_REPLY_QUEUE, O_RDWR);
+
+	memset(&message, 0, sizeof(message));
+	message.command = COMMAND_COMPONENT_TEST;
+	message.replyQ = BENCH_REPLY_QUEUE;
+
+	for(auto _ : state)
+	{
+		message.uSequence++;
+		pEcho->SendMessage(&message);
+
+		if((read(iReply, (char *)&response, sizeof(response)) != sizeof(response)) ||
+				(response.uSequence != message.uSequence))
+		{
+			state.SkipWithError("lost the response");
+			break;
+		}
+	}
+
+	close(iReply);
+}
+
+BENCHMARK(BM_ComponentRoundTrip)->UseRealTime();
+
+static void BM_JoystickUpdate(benchmark::State &state)
+{
+	JoystickMonitor monitor(INPUT_CONTROLLER_1);
+
+	for(auto _ : state)
+	{
+		monitor.Update();
+	}
+}
+
+BENCHMARK(BM_JoystickUpdate);
+
+///What the main loop asks of the snapshot each packet
+static void BM_JoystickQuery(benchmark::State &state)
+{
+	JoystickMonitor monitor(INPUT_CONTROLLER_1);
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(monitor.GetAxis(L310_THUMBSTICK_LEFT_X));
+		benchmark::DoNotOptimize(monitor.ButtonPressed(L310_BUTTON_START));
+		benchmark::DoNotOptimize(monitor.AxisMoved(L310_TRIGGER_RIGHT));
+	}
+}
+
+BENCHMARK(BM_JoystickQuery);
+
+///The drive action from the monitors' snapshots, as the drivetrain reads it
+static void BM_InputAxis(benchmark::State &state)
+{
+	float fAxes[INPUT_CONTROLLERS][JOYSTICK_AXIS_COUNT] = { { 0.5, -0.25, 0.0, 0.1 } };
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(fAxes);
+		benchmark::DoNotOptimize(InputAxis(ACTION_DRIVE_ROTATE, fAxes));
+	}
+}
+
+BENCHMARK(BM_InputAxis);
+
+///A drive stick's deadzone, curve and slew limit, once per axis per packet
+static void BM_InputShape(benchmark::State &state)
+{
+	InputShaper shaper;
+	AxisShape shape = { DRIVE_TRIGGER_DEADZONE, 0.5, 4.0 };
+	float fRaw = -1.0;
+	double fTime = 0.0;
+
+	shaper.SetShape(shape);
+
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(shaper.Shape(fRaw, fTime));
+		fRaw = (fRaw >= 1.0) ? -1.0 : fRaw + 0.01;
+		fTime += 0.02;
+	}
+}
+
+BENCHMARK(BM_InputShape);
+
+/** Reading the heading from the blackboard, as any task may.
+ *
+ * With a writer the pose slot next door is rewritten as fast as one core can, which is what
+ * the cache line alignment is there for: the estimate reads should barely notice.
+ */
+static void BM_BlackboardRead(benchmark::State &state, bool bWriter)
+{
+	struct {
+		BlackboardSlot<StateEstimate> estimate;
+		BlackboardSlot<RobotPose> pose;
+	} board;
+	StateEstimate estimate;
+	std::atomic<bool> bStop(false);
+	std::thread writer;
+
+	memset(&estimate, 0, sizeof(estimate));
+	board.estimate.Write(estimate);
+
+	if(bWriter)
+	{
+		writer = std::thread([&board, &bStop]()
+		{
+			RobotPose pose = { 0.0, 0.0, 0.0, 0.0 };
+
+			while(!bStop.load(std::memory_order_relaxed))
+			{
+				pose.x += 1.0;
+				board.pose.Write(pose);
+			}
+		});
+	}
+
+	for(auto _ : state)
+	{
+		board.estimate.Read(estimate);
+		benchmark::DoNotOptimize(estimate.fHeading);
+	}
+
+	bStop.store(true);
+
+	if(bWriter)
+	{
+		writer.join();
+	}
+}
+
+BENCHMARK_CAPTURE(BM_BlackboardRead, alone, false);
+BENCHMARK_CAPTURE(BM_BlackboardRead, neighbour_written, true)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Compares two kiwi_bench JSON results and flags what got slower.
+
+    compare_bench.py baseline.json bench.json [--threshold 10] [--metric real_time]
+
+A benchmark is a regression when it takes more than threshold percent longer than in the
+baseline.  When the runs were made with --benchmark_repetitions, as make bench does, the
+medians are compared and the slowdown also has to be more than twice the spread of the two
+runs, so a noisy machine does not cry wolf.  Exits 1 if anything regressed, so it can gate a
+build.
+
+Timings only compare between runs on the same machine.  Record a new baseline with make bench
+and copy bench.json over bench/baseline.json when the machine or the expected numbers change.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path, metric):
+    """Time per iteration of each benchmark and its standard deviation in nanoseconds, by name."""
+    scale = {'ns': 1.0, 'us': 1.0e3, 'ms': 1.0e6, 's': 1.0e9}
+
+    with open(path) as results:
+        benchmarks = json.load(results)['benchmarks']
+
+    repeated = set(b['run_name'] for b in benchmarks if b.get('run_type') == 'aggregate')
+    times = {}
+    spread = {}
+
+    for b in benchmarks:
+        if 'error_occurred' in b and b['error_occurred']:
+            continue
+
+        if b['run_name'] in repeated:
+            if b.get('aggregate_name') == 'stddev':
+                spread[b['run_name']] = b[metric] * scale[b.get('time_unit', 'ns')]
+            if b.get('aggregate_name') != 'median':
+                continue
+        elif b.get('run_type') == 'aggregate':
+            continue
+
+        times[b['run_name']] = b[metric] * scale[b.get('time_unit', 'ns')]
+
+    return times, spread
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('baseline')
+    parser.add_argument('current')
+    parser.add_argument('--threshold', type=float, default=10.0, help='percent slower that counts as a regression')
+    parser.add_argument('--metric', default='real_time', choices=['real_time', 'cpu_time'])
+    args = parser.parse_args()
+
+    baseline, baseline_spread = load(args.baseline, args.metric)
+    current, current_spread = load(args.current, args.metric)
+    regressions = 0
+
+    print('%-40s %14s %14s %9s' % ('benchmark', 'baseline ns', 'current ns', 'change'))
+
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline or name not in current:
+            print('%-40s %14s %14s %9s' % (name, '%.1f' % baseline[name] if name in baseline else '-',
+                                            '%.1f' % current[name] if name in current else '-', 'new' if name in current else 'gone'))
+            continue
+
+        change = 100.0 * (current[name] - baseline[name]) / baseline[name]
+        noise = 2.0 * (baseline_spread.get(name, 0.0) ** 2 + current_spread.get(name, 0.0) ** 2) ** 0.5
+        flag = ''
+
+        if change > args.threshold and current[name] - baseline[name] > noise:
+            flag = '  REGRESSION'
+            regressions += 1
+
+        print('%-40s %14.1f %14.1f %+8.1f%%%s' % (name, baseline[name], current[name], change, flag))
+
+    if regressions:
+        print('%d benchmarks more than %.0f%% slower than the baseline' % (regressions, args.threshold))
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,278 @@
+/** \file
+ * Driver station load generator for the simulation build.
+ *
+ * A queue's depth is read with FIONREAD on a second read end of its pipe, which sees what is
+ * waiting without taking any of it.  The ends are opened lazily, since the components only
+ * make their queues once the robot's main loop has started.
+ */
+
+#include "SimLoad.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "RobotClock.h"
+#include "RobotMessage.h"
+#include "RobotParams.h"
+
+SimLoad::SimLoad()
+{
+	const char *szQueues[] = { DRIVETRAIN_QUEUE, AUTONOMOUS_QUEUE };
+
+	pRecord = NULL;
+	bSynthesize = false;
+	fStormRate = 0.0;
+	fPacketRate = 0.0;
+	uSeed = 1;
+	uModeChanges = 0;
+	uWatches = 0;
+
+	for(unsigned i = 0; i < sizeof(szQueues) / sizeof(szQueues[0]); i++)
+	{
+		Queue queue;
+
+		memset(&queue, 0, sizeof(queue));
+		queue.szName = szQueues[i];
+		queue.iFile = -1;
+		queues.push_back(queue);
+	}
+}
+
+SimLoad::~SimLoad()
+{
+	for(unsigned i = 0; i < queues.size(); i++)
+	{
+		if(queues[i].iFile >= 0)
+		{
+			close(queues[i].iFile);
+		}
+	}
+
+	if(pRecord != NULL)
+	{
+		fclose(pRecord);
+	}
+}
+
+bool SimLoad::Replay(const char *szFileName)
+{
+	FILE *pFile = fopen(szFileName, "r");
+	unsigned uPacket;
+	SimPacket packet;
+
+	if(pFile == NULL)
+	{
+		printf("SimLoad: cannot read %s: %s\n", szFileName, strerror(errno));
+		return(false);
+	}
+
+	memset(&packet, 0, sizeof(packet));
+
+	while(fscanf(pFile, "%u %f %f %f %f %f %f %x", &uPacket, &packet.axes[0], &packet.axes[1],
+			&packet.axes[2], &packet.axes[3], &packet.axes[4], &packet.axes[5], &packet.buttons) == 8)
+	{
+		replay.push_back(packet);
+	}
+
+	fclose(pFile);
+
+	if(replay.empty())
+	{
+		printf("SimLoad: no packets in %s\n", szFileName);
+		return(false);
+	}
+
+	return(true);
+}
+
+bool SimLoad::Record(const char *szFileName)
+{
+	pRecord = fopen(szFileName, "w");
+
+	if(pRecord == NULL)
+	{
+		printf("SimLoad: cannot write %s: %s\n", szFileName, strerror(errno));
+		return(false);
+	}
+
+	return(true);
+}
+
+///Anything for the driver station to hand out, or record, or a storm to make
+bool SimLoad::IsActive() const
+{
+	return(!replay.empty() || (pRecord != NULL) || bSynthesize || (fStormRate > 0.0) ||
+			(fPacketRate > 0.0));
+}
+
+///Takes over the driver station, once the robot clock has been chosen
+void SimLoad::Start()
+{
+	DriverStation *pDS = DriverStation::GetInstance();
+
+	if(fPacketRate > 0.0)
+	{
+		pDS->SimSetPacketRate(fPacketRate);
+	}
+
+	if(!replay.empty() || (pRecord != NULL) || bSynthesize)
+	{
+		pDS->SimSetPacketSource(this);
+	}
+}
+
+///Called by the driver station with its lock held as packet uPacket goes to the robot
+void SimLoad::Fill(unsigned uPacket, SimPacket &packet)
+{
+	if(!replay.empty())
+	{
+		const SimPacket &recorded = replay[uPacket % replay.size()];
+
+		memcpy(packet.axes, recorded.axes, sizeof(recorded.axes[0]) * SIM_LOAD_AXES);
+		packet.buttons = recorded.buttons;
+	}
+	else if(bSynthesize)
+	{
+		// a random walk, so the robot sees a stick being moved and not noise; the buttons
+		// are left alone since one of them starts recording a trajectory
+
+		for(unsigned i = 0; i < SIM_LOAD_AXES; i++)
+		{
+			float fMove = SIM_LOAD_STICK_STEP * (2.0 * rand_r(&uSeed) / RAND_MAX - 1.0);
+
+			packet.axes[i] = fmaxf(-1.0, fminf(packet.axes[i] + fMove, 1.0));
+		}
+	}
+
+	if(pRecord != NULL)
+	{
+		fprintf(pRecord, "%u %0.4f %0.4f %0.4f %0.4f %0.4f %0.4f %x\n", uPacket, packet.axes[0],
+				packet.axes[1], packet.axes[2], packet.axes[3], packet.axes[4], packet.axes[5],
+				packet.buttons);
+	}
+}
+
+///Runs fSeconds of the schedule watching the queues, switching modes as it goes if bStorm
+void SimLoad::Run(double fSeconds, bool bStorm)
+{
+	double fEnd = RobotClock::GetTime() + fSeconds;
+	double fNextStorm = RobotClock::GetTime();
+
+	bStorm = bStorm && (fStormRate > 0.0);
+
+	while(RobotClock::GetTime() + 0.5 * SIM_LOAD_WATCH < fEnd)
+	{
+		double fNow = RobotClock::GetTime();
+		double fNext = fmin(fNow + SIM_LOAD_WATCH, fEnd);
+
+		if(bStorm)
+		{
+			// close enough counts, a stepped clock cannot stop short of a step
+
+			if(fNow + 0.5 * SIM_LOAD_WATCH >= fNextStorm)
+			{
+				Storm();
+				fNextStorm += 1.0 / fStormRate;
+			}
+
+			fNext = fmin(fNext, fNextStorm);
+		}
+
+		SimRun(fNext - fNow);
+		Watch();
+	}
+}
+
+///Switches to a mode other than the one we are in, auto to teleop as often as anything else
+void SimLoad::Storm()
+{
+	DriverStation *pDS = DriverStation::GetInstance();
+	DriverStation::SimMode current = pDS->SimGetMode();
+	DriverStation::SimMode next = current;
+
+	while(next == current)
+	{
+		switch(rand_r(&uSeed) % 3)
+		{
+		case 0:
+			next = DriverStation::kSimDisabled;
+			break;
+		case 1:
+			next = DriverStation::kSimAutonomous;
+			break;
+		default:
+			next = DriverStation::kSimTeleop;
+			break;
+		}
+	}
+
+	pDS->SimSetMode(next);
+	uModeChanges++;
+}
+
+void SimLoad::Watch()
+{
+	uWatches++;
+
+	for(unsigned i = 0; i < queues.size(); i++)
+	{
+		Queue &queue = queues[i];
+		int iBytes = 0;
+
+		if(queue.iFile < 0)
+		{
+			queue.iFile = open(queue.szName, O_RDONLY | O_NONBLOCK);
+
+			if(queue.iFile < 0)
+			{
+				continue;
+			}
+
+			queue.uCapacity = fcntl(queue.iFile, F_GETPIPE_SZ) / sizeof(RobotMessage);
+		}
+
+		if(ioctl(queue.iFile, FIONREAD, &iBytes) == 0)
+		{
+			unsigned uDepth = iBytes / sizeof(RobotMessage);
+
+			queue.uMax = (uDepth > queue.uMax) ? uDepth : queue.uMax;
+			queue.fTotal += uDepth;
+		}
+	}
+}
+
+void SimLoad::Report()
+{
+	SimPacketStats stats = DriverStation::GetInstance()->SimGetPacketStats();
+
+	if(pRecord != NULL)
+	{
+		fclose(pRecord);
+		pRecord = NULL;
+	}
+
+	printf("SimLoad: %u packets sent, %u seen, %u missed in %u overruns, oldest %0.2f ms, %u mode changes\n",
+			stats.uSent, stats.uSeen, stats.uMissed, stats.uOverruns, stats.fMaxAge * 1000.0,
+			uModeChanges);
+
+	for(unsigned i = 0; i < queues.size(); i++)
+	{
+		const Queue &queue = queues[i];
+
+		if(queue.iFile < 0)
+		{
+			continue;
+		}
+
+		// a full pipe does not drop anything, it blocks whoever sends next
+
+		printf("SimLoad: %-12s mean %0.2f, most %u of %u messages%s\n", queue.szName,
+				uWatches ? queue.fTotal / uWatches : 0.0, queue.uMax, queue.uCapacity,
+				(queue.uMax >= queue.uCapacity) ? ", full, senders blocked" : "");
+	}
+}
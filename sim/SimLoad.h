@@ -0,0 +1,70 @@
+/** \file
+ * Driver station load generator for the simulation build.
+ *
+ * Control packets can come faster than the real 50 Hz, be filled with random stick moves or
+ * replayed from a file recorded by an earlier run, and the mode can be switched back and forth
+ * many times a second.  While the schedule runs the component queues are looked at every
+ * SIM_LOAD_WATCH, and at the end the report shows how many packets the main loop missed and
+ * how deep each queue got.  Raising the rate until packets are missed or the queues keep
+ * growing finds the most the current design can take.
+ *
+ * A recording has one line per packet handed out: the packet number, axes 0 to 5 of joystick 0
+ * and its buttons in hex.  A replay goes round the file as often as it takes.
+ */
+
+#ifndef SIM_LOAD_H
+#define SIM_LOAD_H
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "WPILib.h"
+
+const double SIM_LOAD_WATCH = 0.005;		//seconds between looks at the queues
+const unsigned SIM_LOAD_AXES = 6;			//axes of joystick 0 that are recorded and synthesized
+const float SIM_LOAD_STICK_STEP = 0.1;		//most a synthetic axis moves from one packet to the next
+
+class SimLoad : public SimPacketSource
+{
+public:
+	SimLoad();
+	~SimLoad();
+
+	bool Replay(const char *szFileName);
+	bool Record(const char *szFileName);
+	void Synthesize(bool bSynthesize) { this->bSynthesize = bSynthesize; };
+	void SetStormRate(double fRate) { fStormRate = fRate; };
+	void SetPacketRate(double fRate) { fPacketRate = fRate; };
+	bool IsActive() const;
+	void Start();
+
+	void Fill(unsigned uPacket, SimPacket &packet);
+	void Run(double fSeconds, bool bStorm);
+	void Report();
+
+private:
+	///One of the component queues, opened for reading alongside its component
+	struct Queue {
+		const char *szName;
+		int iFile;
+		unsigned uCapacity;			//messages the pipe holds before a sender blocks
+		unsigned uMax;
+		double fTotal;
+	};
+
+	std::vector<SimPacket> replay;
+	FILE *pRecord;
+	bool bSynthesize;
+	double fStormRate;				//mode switches a second while storming
+	double fPacketRate;				//0 leaves the driver station at its own rate
+	unsigned uSeed;
+	unsigned uModeChanges;
+	unsigned uWatches;
+	std::vector<Queue> queues;
+
+	void Watch();
+	void Storm();
+};
+
+#endif //SIM_LOAD_H
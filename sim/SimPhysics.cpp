@@ -0,0 +1,243 @@
+/** \file
+ * Rigid body model of the kiwi base for the simulation build.
+ *
+ * The body has unit mass, so wheel forces are accelerations.  Force and torque come from the
+ * transpose of the KiwiInverse mix, which is what makes the model agree with the robot's own
+ * kinematics: driving the wheels at a KiwiInverse speed settles on exactly that motion.
+ */
+
+#include "SimPhysics.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "WPILib.h"
+
+#include "KiwiKinematics.h"
+#include "RobotClock.h"
+#include "RobotParams.h"
+
+SimPhysics *SimPhysics::pInstance = NULL;
+
+SimPhysics *SimPhysics::GetInstance()
+{
+	static pthread_mutex_t instanceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+	pthread_mutex_lock(&instanceMutex);
+
+	if(pInstance == NULL)
+	{
+		pInstance = new SimPhysics();
+	}
+
+	pthread_mutex_unlock(&instanceMutex);
+	return(pInstance);
+}
+
+SimPhysics::SimPhysics()
+{
+	pthread_mutex_init(&physicsMutex, NULL);
+	fTime = RobotClock::GetTime();
+	memset(&pose, 0, sizeof(pose));
+	fAccelX = 0.0;
+	fAccelY = 0.0;
+	memset(fPower, 0, sizeof(fPower));
+	memset(fTravel, 0, sizeof(fTravel));
+	memset(fWheelSpeed, 0, sizeof(fWheelSpeed));
+}
+
+///Which wheel a Talon drives, -1 for anything not on the drivetrain
+int SimPhysics::GetWheel(int iDevice)
+{
+	switch(iDevice)
+	{
+	case CAN_DRIVETRAIN_LEFT_MOTOR:
+		return(LEFT);
+	case CAN_DRIVETRAIN_RIGHT_MOTOR:
+		return(RIGHT);
+	case CAN_DRIVETRAIN_BOTTOM_MOTOR:
+		return(BOTTOM);
+	default:
+		return(-1);
+	}
+}
+
+///Brings the model up to the robot clock, called with the lock held
+void SimPhysics::Advance()
+{
+	double fNow = RobotClock::GetTime();
+
+	while(fTime + SIM_PHYSICS_STEP <= fNow + 1.0e-9)
+	{
+		Step(SIM_PHYSICS_STEP);
+		fTime += SIM_PHYSICS_STEP;
+	}
+}
+
+void SimPhysics::Step(double fDelta)
+{
+	KiwiMotion motion;
+	KiwiWheels wheels;
+	float fForce[WHEELS];
+	float fForceX;
+	float fForceY;
+	float fGyration = SIM_GYRATION_RATIO * DRIVETRAIN_BASE_RADIUS;
+
+	// the robot frame motion the wheels see, and what each one is being driven toward
+
+	motion.x = pose.vx;
+	motion.y = pose.vy;
+	motion.r = pose.fRate;
+	KiwiFieldToRobot(pose.fHeading, motion.x, motion.y);
+	wheels = KiwiInverse(motion, DRIVETRAIN_BASE_RADIUS);
+
+	fWheelSpeed[LEFT] = wheels.left;
+	fWheelSpeed[RIGHT] = wheels.right;
+	fWheelSpeed[BOTTOM] = wheels.bottom;
+
+	for(int i = 0; i < WHEELS; i++)
+	{
+		// the motors are driven with the negated KiwiDrive values
+		fForce[i] = SIM_TRACTION_GAIN * (-fPower[i] * SIM_FREE_SPEED - fWheelSpeed[i]);
+		fTravel[i] += fWheelSpeed[i] * fDelta;
+	}
+
+	fForceX = fForce[BOTTOM] - 0.5f * (fForce[LEFT] + fForce[RIGHT]);
+	fForceY = KIWI_SIN60 * (fForce[RIGHT] - fForce[LEFT]);
+	KiwiRobotToField(pose.fHeading, fForceX, fForceY);
+
+	fAccelX = fForceX;
+	fAccelY = fForceY;
+
+	pose.vx += fAccelX * fDelta;
+	pose.vy += fAccelY * fDelta;
+	pose.fRate += DRIVETRAIN_BASE_RADIUS * (fForce[LEFT] + fForce[RIGHT] + fForce[BOTTOM]) /
+			(fGyration * fGyration) * fDelta;
+
+	pose.x += pose.vx * fDelta;
+	pose.y += pose.vy * fDelta;
+	pose.fHeading += pose.fRate * fDelta;
+}
+
+void SimPhysics::SetMotor(int iDevice, float fValue)
+{
+	int iWheel = GetWheel(iDevice);
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+
+	if(iWheel >= 0)
+	{
+		fPower[iWheel] = fmaxf(-1.0, fminf(fValue, 1.0));
+	}
+
+	pthread_mutex_unlock(&physicsMutex);
+}
+
+float SimPhysics::GetMotor(int iDevice)
+{
+	int iWheel = GetWheel(iDevice);
+	float fValue;
+
+	pthread_mutex_lock(&physicsMutex);
+	fValue = (iWheel >= 0) ? fPower[iWheel] : 0.0;
+	pthread_mutex_unlock(&physicsMutex);
+	return(fValue);
+}
+
+///Amps drawn, what the power asks for beyond the back EMF of the speed already reached
+double SimPhysics::GetCurrent(int iDevice)
+{
+	int iWheel = GetWheel(iDevice);
+	double fCurrent = 0.0;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+
+	if(iWheel >= 0)
+	{
+		fCurrent = SIM_STALL_CURRENT * fabs(fPower[iWheel] + fWheelSpeed[iWheel] / SIM_FREE_SPEED);
+	}
+
+	pthread_mutex_unlock(&physicsMutex);
+	return(fCurrent);
+}
+
+int SimPhysics::GetEncPosition(int iDevice)
+{
+	int iWheel = GetWheel(iDevice);
+	int iCounts = 0;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+
+	if(iWheel >= 0)
+	{
+		iCounts = (int)lround(fTravel[iWheel] / DRIVETRAIN_INCHES_PER_COUNT);
+	}
+
+	pthread_mutex_unlock(&physicsMutex);
+	return(iCounts);
+}
+
+///Counts per 100 ms, as the Talon reports it
+int SimPhysics::GetEncVel(int iDevice)
+{
+	int iWheel = GetWheel(iDevice);
+	int iVelocity = 0;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+
+	if(iWheel >= 0)
+	{
+		iVelocity = (int)lround(fWheelSpeed[iWheel] * 0.1 / DRIVETRAIN_INCHES_PER_COUNT);
+	}
+
+	pthread_mutex_unlock(&physicsMutex);
+	return(iVelocity);
+}
+
+///Degrees/s, a larger gyro angle is a positive KiwiMotion::r
+float SimPhysics::GetGyroRate()
+{
+	float fRate;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+	fRate = pose.fRate / KIWI_DEG_TO_RAD + SIM_GYRO_BIAS;
+	pthread_mutex_unlock(&physicsMutex);
+	return(fRate);
+}
+
+///Robot frame, in g
+void SimPhysics::GetAccel(double &x, double &y)
+{
+	float fAccelRobotX;
+	float fAccelRobotY;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+	fAccelRobotX = fAccelX;
+	fAccelRobotY = fAccelY;
+	KiwiFieldToRobot(pose.fHeading, fAccelRobotX, fAccelRobotY);
+	pthread_mutex_unlock(&physicsMutex);
+
+	x = fAccelRobotX / SIM_G;
+	y = fAccelRobotY / SIM_G;
+}
+
+///Field frame, heading in degrees
+SimPose SimPhysics::GetPose()
+{
+	SimPose current;
+
+	pthread_mutex_lock(&physicsMutex);
+	Advance();
+	current = pose;
+	pthread_mutex_unlock(&physicsMutex);
+
+	current.fHeading /= KIWI_DEG_TO_RAD;
+	current.fRate /= KIWI_DEG_TO_RAD;
+	return(current);
+}
@@ -0,0 +1,66 @@
+/** \file
+ * Rigid body model of the kiwi base for the simulation build.
+ *
+ * Each wheel pushes along its rolling direction with a force proportional to how far its
+ * surface speed is from what the motor power asks for, which is the steady state of a DC motor
+ * with a traction limit left out.  The three forces are summed into a force and torque on the
+ * body, integrated in fixed steps, and the motion is read back the way the robot reads it:
+ * Talon encoder counts, an ADXRS453Z rate and accelerometer g's in the robot frame.
+ *
+ * The model is advanced lazily to the robot clock by whoever looks at it, so it needs no
+ * thread of its own and keeps up at any clock speed, stepped or not.
+ */
+
+#ifndef SIM_PHYSICS_H
+#define SIM_PHYSICS_H
+
+#include <pthread.h>
+
+const double SIM_PHYSICS_STEP = 0.001;		//seconds per integration step
+const float SIM_FREE_SPEED = 125.0;			//inches/s of wheel surface at full power, 1 / DRIVETRAIN_FOLLOW_KV
+const float SIM_TRACTION_GAIN = 4.4;		//1/s, wheel force per unit mass per inch/s of speed error
+const float SIM_GYRATION_RATIO = 0.6;		//radius of gyration over DRIVETRAIN_BASE_RADIUS
+const float SIM_STALL_CURRENT = 130.0;		//amps
+const float SIM_GYRO_BIAS = 0.25;			//degrees/s, the robot calibrates this out while disabled
+const float SIM_G = 386.09;					//inches/s/s
+
+///Where the robot is, field frame, inches, degrees and their rates
+struct SimPose {
+	double x, y, fHeading;
+	double vx, vy, fRate;
+};
+
+class SimPhysics
+{
+public:
+	static SimPhysics *GetInstance();
+
+	void SetMotor(int iDevice, float fPower);
+	float GetMotor(int iDevice);
+	double GetCurrent(int iDevice);
+	int GetEncPosition(int iDevice);
+	int GetEncVel(int iDevice);
+	float GetGyroRate();
+	void GetAccel(double &x, double &y);
+	SimPose GetPose();
+
+private:
+	enum { LEFT, RIGHT, BOTTOM, WHEELS };
+
+	static SimPhysics *pInstance;
+
+	pthread_mutex_t physicsMutex;
+	double fTime;				//how far the model has been advanced
+	SimPose pose;				//heading kept in radians and radians/s here
+	double fAccelX, fAccelY;	//field frame, inches/s/s
+	float fPower[WHEELS];
+	double fTravel[WHEELS];		//inches each wheel surface has rolled, KiwiInverse sign
+	float fWheelSpeed[WHEELS];
+
+	SimPhysics();
+	int GetWheel(int iDevice);
+	void Advance();
+	void Step(double fDelta);
+};
+
+#endif //SIM_PHYSICS_H
@@ -0,0 +1,74 @@
+# Runs a script in the stepped simulation and checks how autonomous went.
+#
+# ctest runs it as
+#   cmake -DSIM=<kiwi_sim> -DHOME=<ROBOT_HOME> -DCASE=<case> -P SimRepeat.cmake
+# where CASE is
+#   repeat      a MODE script run twice, both autonomous profiles have to be the same
+#   no_modes    a script without MODE lines, which has to run from the top, with a comment
+#               after a command whose optional parameter is left out
+# A script of our own is put in HOME for the runs and whatever was there is put back after.
+
+if(CASE STREQUAL "repeat")
+	set(SCRIPT "MODE 0
+BEGIN
+PATH 60 120  0 0 0  24 36 0  48 48 90
+TURN_ANGLE 0.5 -90.0
+DRIVE_DISTANCE 0.6 24.0 4.0
+END
+")
+	set(RUNS 1 2)
+elseif(CASE STREQUAL "no_modes")
+	set(SCRIPT "BEGIN
+MESSAGE no modes in this one
+DRIVE_TIME 0.5 1.0 # back away from the wall
+DELAY 0.5
+END
+")
+	set(RUNS 1)
+else()
+	message(FATAL_ERROR "unknown CASE ${CASE}")
+endif()
+
+file(MAKE_DIRECTORY ${HOME})
+
+if(EXISTS ${HOME}/RhsScript.txt)
+	file(RENAME ${HOME}/RhsScript.txt ${HOME}/RhsScript.txt.saved)
+endif()
+
+file(WRITE ${HOME}/RhsScript.txt "${SCRIPT}")
+
+foreach(RUN ${RUNS})
+	file(REMOVE ${HOME}/AutoProfile.csv)
+	execute_process(COMMAND ${SIM} --stepped --disabled 16 --auto 6
+		RESULT_VARIABLE RESULT OUTPUT_VARIABLE OUTPUT ERROR_VARIABLE OUTPUT)
+
+	if(NOT RESULT EQUAL 0 OR NOT EXISTS ${HOME}/AutoProfile.csv OR NOT OUTPUT MATCHES "auto status \"auto ok\"")
+		set(FAILURE "run ${RUN} did not finish autonomous:\n${OUTPUT}")
+		break()
+	endif()
+
+	file(RENAME ${HOME}/AutoProfile.csv ${HOME}/AutoProfile${RUN}.csv)
+endforeach()
+
+file(REMOVE ${HOME}/RhsScript.txt)
+
+if(EXISTS ${HOME}/RhsScript.txt.saved)
+	file(RENAME ${HOME}/RhsScript.txt.saved ${HOME}/RhsScript.txt)
+endif()
+
+if(NOT FAILURE AND CASE STREQUAL "repeat")
+	execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files
+		${HOME}/AutoProfile1.csv ${HOME}/AutoProfile2.csv RESULT_VARIABLE RESULT)
+
+	if(NOT RESULT EQUAL 0)
+		file(READ ${HOME}/AutoProfile1.csv FIRST)
+		file(READ ${HOME}/AutoProfile2.csv SECOND)
+		set(FAILURE "the two runs differ\nfirst:\n${FIRST}\nsecond:\n${SECOND}")
+	endif()
+endif()
+
+file(REMOVE ${HOME}/AutoProfile1.csv ${HOME}/AutoProfile2.csv)
+
+if(FAILURE)
+	message(FATAL_ERROR "${FAILURE}")
+endif()
@@ -0,0 +1,872 @@
+/** \file
+ * Desktop stand-in for the parts of WPILib the robot uses.
+ *
+ * Time is the RobotClock.  By default it is real time multiplied by --speed; with --stepped
+ * the schedule itself moves the clock SIM_STEP at a time, as fast as the robot keeps up, and
+ * two runs with the same options come out the same.  The driver station plays the match
+ * schedule from the command line, handing out a control packet every 20 ms of robot time
+ * (or --ds-rate a second, see SimLoad.h), and the program ends when the schedule does.
+ */
+
+#include "WPILib.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LatencyProbe.h"
+#include "RobotClock.h"
+#include "RobotParams.h"
+#include "SimLoad.h"
+#include "SimPhysics.h"
+
+const double SIM_PACKET_PERIOD = 0.02;		//seconds between driver station packets
+
+const double SIM_STEP = 0.001;				//seconds per step of a stepped run
+const float SIM_LATENCY_SWING = 0.5;			//drive stick position --latency swings between, either way
+
+static SteppedClock *pSimStepper = NULL;
+static double fSimDisabledTime = 16.0;		//long enough for the gyro to calibrate
+static double fSimAutoTime = 15.0;
+static double fSimTeleopTime = 0.0;
+static double fSimTestTime = 0.0;
+static std::string simSelection;
+
+double GetTime()
+{
+	return(RobotClock::GetTime());
+}
+
+void Wait(double seconds)
+{
+	RobotClock::Delay(seconds);
+}
+
+Timer::Timer()
+{
+	fStartTime = RobotClock::GetTime();
+	fAccumulated = 0.0;
+	bRunning = false;
+}
+
+void Timer::Start()
+{
+	if(!bRunning)
+	{
+		fStartTime = RobotClock::GetTime();
+		bRunning = true;
+	}
+}
+
+void Timer::Stop()
+{
+	if(bRunning)
+	{
+		fAccumulated += RobotClock::GetTime() - fStartTime;
+		bRunning = false;
+	}
+}
+
+void Timer::Reset()
+{
+	fAccumulated = 0.0;
+	fStartTime = RobotClock::GetTime();
+}
+
+double Timer::Get()
+{
+	return(fAccumulated + (bRunning ? RobotClock::GetTime() - fStartTime : 0.0));
+}
+
+double Timer::GetFPGATimestamp()
+{
+	return(RobotClock::GetTime());
+}
+
+/** Priority and stack size are only kept for the signature.
+ *
+ * Real time priorities need privileges a desktop user does not have, and the default pthread
+ * stack is larger than anything the robot asks for.
+ */
+Task::Task(const char *name, FUNCPTR function, int32_t priority, uint32_t stackSize)
+{
+	this->name = name;
+	this->function = function;
+	bStarted = false;
+}
+
+Task::~Task()
+{
+	if(bStarted)
+	{
+		pthread_cancel(thread);
+		pthread_join(thread, NULL);
+	}
+}
+
+struct SimTaskStart {
+	FUNCPTR function;
+	intptr_t arg0;
+};
+
+static void *SimTaskEntry(void *pArg)
+{
+	SimTaskStart start = *(SimTaskStart *)pArg;
+
+	delete (SimTaskStart *)pArg;
+	RobotClock::GetInstance()->BeginTask();
+	start.function(start.arg0);
+	return(NULL);
+}
+
+bool Task::Start(intptr_t arg0)
+{
+	SimTaskStart *pStart = new SimTaskStart;
+
+	pStart->function = function;
+	pStart->arg0 = arg0;
+
+	if(pthread_create(&thread, NULL, &SimTaskEntry, pStart) != 0)
+	{
+		printf("Task %s failed to start\n", name.c_str());
+		delete pStart;
+		return(false);
+	}
+
+	pthread_setname_np(thread, name.substr(0, 15).c_str());
+	RobotClock::GetInstance()->AddTask();
+	bStarted = true;
+	return(true);
+}
+
+SPI::SPI(Port port)
+{
+	this->port = port;
+}
+
+/** Answers every transfer as the ADXRS453Z would answer a rate read.
+ *
+ * The rate is sent as a 16 bit two's complement count of 1/80 degrees/s, split across the
+ * reply the way ADXRS453Z::assemble_sensor_data() puts it back together.
+ */
+int32_t SPI::Transaction(uint8_t *dataToSend, uint8_t *dataReceived, uint8_t size)
+{
+	long lRate = lround(SimPhysics::GetInstance()->GetGyroRate() * 80.0);
+	uint16_t uRate = (uint16_t)(int16_t)fmax(INT16_MIN, fmin(lRate, INT16_MAX));
+
+	memset(dataReceived, 0, size);
+
+	if(size >= 3)
+	{
+		dataReceived[0] = 0x04 | ((uRate >> 14) & 0x03);		//status: valid sensor data
+		dataReceived[1] = (uRate >> 6) & 0xFF;
+		dataReceived[2] = (uRate << 2) & 0xFC;
+
+		// odd parity, P0 over the first 16 bits and P over all of them
+		if(__builtin_parity(dataReceived[0] ^ dataReceived[1]) == 0)
+		{
+			dataReceived[0] |= 0x10;
+		}
+
+		if((size >= 4) && (__builtin_parity(dataReceived[0] ^ dataReceived[1] ^ dataReceived[2]) == 0))
+		{
+			dataReceived[3] |= 0x01;
+		}
+	}
+
+	return(size);
+}
+
+CANTalon::CANTalon(int deviceNumber)
+{
+	iDevice = deviceNumber;
+}
+
+void CANTalon::Set(float value, uint8_t syncGroup)
+{
+	SimPhysics::GetInstance()->SetMotor(iDevice, value);
+}
+
+float CANTalon::Get()
+{
+	return(SimPhysics::GetInstance()->GetMotor(iDevice));
+}
+
+double CANTalon::GetOutputCurrent()
+{
+	return(SimPhysics::GetInstance()->GetCurrent(iDevice));
+}
+
+int CANTalon::GetEncPosition()
+{
+	return(SimPhysics::GetInstance()->GetEncPosition(iDevice));
+}
+
+int CANTalon::GetEncVel()
+{
+	return(SimPhysics::GetInstance()->GetEncVel(iDevice));
+}
+
+double BuiltInAccelerometer::GetX()
+{
+	double x;
+	double y;
+
+	SimPhysics::GetInstance()->GetAccel(x, y);
+	return(x);
+}
+
+double BuiltInAccelerometer::GetY()
+{
+	double x;
+	double y;
+
+	SimPhysics::GetInstance()->GetAccel(x, y);
+	return(y);
+}
+
+double BuiltInAccelerometer::GetZ()
+{
+	return(1.0);
+}
+
+DriverStation *DriverStation::pInstance = NULL;
+
+DriverStation *DriverStation::GetInstance()
+{
+	static pthread_mutex_t instanceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+	pthread_mutex_lock(&instanceMutex);
+
+	if(pInstance == NULL)
+	{
+		pInstance = new DriverStation();
+	}
+
+	pthread_mutex_unlock(&instanceMutex);
+	return(pInstance);
+}
+
+DriverStation::DriverStation()
+{
+	pthread_mutex_init(&dsMutex, NULL);
+	mode = kSimDisabled;
+	memset(axes, 0, sizeof(axes));
+	memset(buttons, 0, sizeof(buttons));
+
+	for(uint32_t i = 0; i < kJoystickPorts; i++)
+	{
+		povs[i] = -1;
+	}
+
+	fPacketPeriod = SIM_PACKET_PERIOD;
+	iLastPacket = -1;
+	pSource = NULL;
+	memset(&stats, 0, sizeof(stats));
+}
+
+float DriverStation::GetStickAxis(uint32_t stick, uint32_t axis)
+{
+	float fValue = 0.0;
+
+	pthread_mutex_lock(&dsMutex);
+
+	if((stick < kJoystickPorts) && (axis < kMaxJoystickAxes))
+	{
+		fValue = axes[stick][axis];
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+	return(fValue);
+}
+
+///Buttons are numbered from 1
+bool DriverStation::GetStickButton(uint32_t stick, uint8_t button)
+{
+	bool bDown = false;
+
+	pthread_mutex_lock(&dsMutex);
+
+	if((stick < kJoystickPorts) && (button > 0) && (button <= kMaxJoystickButtons))
+	{
+		bDown = (buttons[stick] >> (button - 1)) & 1;
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+	return(bDown);
+}
+
+///Every button of a stick at once, button 1 in bit 0
+uint32_t DriverStation::GetStickButtons(uint32_t stick)
+{
+	uint32_t uButtons = 0;
+
+	pthread_mutex_lock(&dsMutex);
+
+	if(stick < kJoystickPorts)
+	{
+		uButtons = buttons[stick];
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+	return(uButtons);
+}
+
+///Degrees clockwise from up, -1 when centered; only the first POV of a stick is simulated
+int DriverStation::GetStickPOV(uint32_t stick, uint32_t pov)
+{
+	int iAngle = -1;
+
+	pthread_mutex_lock(&dsMutex);
+
+	if((stick < kJoystickPorts) && (pov == 0))
+	{
+		iAngle = povs[stick];
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+	return(iAngle);
+}
+
+bool DriverStation::IsEnabled()
+{
+	return(SimGetMode() != kSimDisabled);
+}
+
+bool DriverStation::IsAutonomous()
+{
+	return(SimGetMode() == kSimAutonomous);
+}
+
+bool DriverStation::IsOperatorControl()
+{
+	return(SimGetMode() == kSimTeleop);
+}
+
+bool DriverStation::IsTest()
+{
+	return(SimGetMode() == kSimTest);
+}
+
+/** True once for each packet period the robot's main loop looks in, which polls this.
+ *
+ * Only the newest packet is handed out, like the real one a busy robot misses the ones in
+ * between.  A packet source gets to fill in the sticks as each one is handed out.
+ */
+bool DriverStation::IsNewControlData()
+{
+	double fNow = RobotClock::GetTime();
+	long long iPacket = (long long)floor(fNow / fPacketPeriod + 1.0e-9);
+	bool bNew = false;
+
+	pthread_mutex_lock(&dsMutex);
+
+	if(iPacket > iLastPacket)
+	{
+		if(iPacket > iLastPacket + 1)
+		{
+			stats.uMissed += iPacket - iLastPacket - 1;
+			stats.uOverruns += (iLastPacket >= 0);
+		}
+
+		stats.uSeen++;
+		stats.fMaxAge = fmax(stats.fMaxAge, fNow - iPacket * fPacketPeriod);
+		iLastPacket = iPacket;
+
+		if(pSource != NULL)
+		{
+			SimPacket packet;
+
+			memcpy(packet.axes, axes[0], sizeof(packet.axes));
+			packet.buttons = buttons[0];
+			pSource->Fill(iPacket, packet);
+			memcpy(axes[0], packet.axes, sizeof(packet.axes));
+			buttons[0] = packet.buttons;
+		}
+
+		bNew = true;
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+	return(bNew);
+}
+
+void DriverStation::WaitForData()
+{
+	double fNext;
+
+	pthread_mutex_lock(&dsMutex);
+	fNext = (iLastPacket + 1) * fPacketPeriod;
+	pthread_mutex_unlock(&dsMutex);
+
+	Wait(fNext - RobotClock::GetTime());
+	IsNewControlData();
+}
+
+void DriverStation::SimSetMode(SimMode mode)
+{
+	pthread_mutex_lock(&dsMutex);
+	this->mode = mode;
+	pthread_mutex_unlock(&dsMutex);
+}
+
+DriverStation::SimMode DriverStation::SimGetMode()
+{
+	SimMode current;
+
+	pthread_mutex_lock(&dsMutex);
+	current = mode;
+	pthread_mutex_unlock(&dsMutex);
+	return(current);
+}
+
+void DriverStation::SimSetAxis(uint32_t stick, uint32_t axis, float value)
+{
+	pthread_mutex_lock(&dsMutex);
+
+	if((stick < kJoystickPorts) && (axis < kMaxJoystickAxes))
+	{
+		axes[stick][axis] = value;
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+}
+
+void DriverStation::SimSetButton(uint32_t stick, uint32_t button, bool bDown)
+{
+	pthread_mutex_lock(&dsMutex);
+
+	if((stick < kJoystickPorts) && (button > 0) && (button <= kMaxJoystickButtons))
+	{
+		if(bDown)
+		{
+			buttons[stick] |= 1 << (button - 1);
+		}
+		else
+		{
+			buttons[stick] &= ~(1 << (button - 1));
+		}
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+}
+
+void DriverStation::SimSetPOV(uint32_t stick, int angle)
+{
+	pthread_mutex_lock(&dsMutex);
+
+	if(stick < kJoystickPorts)
+	{
+		povs[stick] = angle;
+	}
+
+	pthread_mutex_unlock(&dsMutex);
+}
+
+///Packets a second, the real driver station sends 50
+void DriverStation::SimSetPacketRate(double fRate)
+{
+	pthread_mutex_lock(&dsMutex);
+	fPacketPeriod = 1.0 / fRate;
+	iLastPacket = (long long)floor(RobotClock::GetTime() / fPacketPeriod + 1.0e-9) - 1;
+	pthread_mutex_unlock(&dsMutex);
+}
+
+void DriverStation::SimSetPacketSource(SimPacketSource *pSource)
+{
+	pthread_mutex_lock(&dsMutex);
+	this->pSource = pSource;
+	pthread_mutex_unlock(&dsMutex);
+}
+
+SimPacketStats DriverStation::SimGetPacketStats()
+{
+	SimPacketStats current;
+
+	pthread_mutex_lock(&dsMutex);
+	current = stats;
+	current.uSent = (unsigned)floor(RobotClock::GetTime() / fPacketPeriod + 1.0e-9) + 1;
+	pthread_mutex_unlock(&dsMutex);
+	return(current);
+}
+
+float Joystick::GetRawAxis(uint32_t axis)
+{
+	return(DriverStation::GetInstance()->GetStickAxis(uPort, axis));
+}
+
+bool Joystick::GetRawButton(uint32_t button)
+{
+	return(DriverStation::GetInstance()->GetStickButton(uPort, button));
+}
+
+int Joystick::GetPOV(uint32_t pov)
+{
+	return(DriverStation::GetInstance()->GetStickPOV(uPort, pov));
+}
+
+void SendableChooser::AddObject(const char *name, void *object)
+{
+	choices.push_back(std::make_pair(std::string(name), object));
+}
+
+void SendableChooser::AddDefault(const char *name, void *object)
+{
+	defaultChoice = name;
+	AddObject(name, object);
+}
+
+///The choice named with --select, otherwise the default
+void *SendableChooser::GetSelected()
+{
+	void *pDefault = NULL;
+
+	for(unsigned i = 0; i < choices.size(); i++)
+	{
+		if(choices[i].first == simSelection)
+		{
+			return(choices[i].second);
+		}
+
+		if(choices[i].first == defaultChoice)
+		{
+			pDefault = choices[i].second;
+		}
+	}
+
+	return(pDefault);
+}
+
+void SendableChooser::SimSelect(const char *name)
+{
+	simSelection = name;
+}
+
+static pthread_mutex_t dashboardMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, double> dashboardNumbers;
+static std::map<std::string, std::string> dashboardStrings;
+
+void SmartDashboard::PutNumber(const std::string &key, double value)
+{
+	pthread_mutex_lock(&dashboardMutex);
+	dashboardNumbers[key] = value;
+	pthread_mutex_unlock(&dashboardMutex);
+}
+
+double SmartDashboard::GetNumber(const std::string &key, double defaultValue)
+{
+	std::map<std::string, double>::iterator it;
+	double fValue = defaultValue;
+
+	pthread_mutex_lock(&dashboardMutex);
+	it = dashboardNumbers.find(key);
+
+	if(it != dashboardNumbers.end())
+	{
+		fValue = it->second;
+	}
+
+	pthread_mutex_unlock(&dashboardMutex);
+	return(fValue);
+}
+
+void SmartDashboard::PutString(const std::string &key, const std::string &value)
+{
+	pthread_mutex_lock(&dashboardMutex);
+	dashboardStrings[key] = value;
+	pthread_mutex_unlock(&dashboardMutex);
+}
+
+std::string SmartDashboard::GetString(const std::string &key, const std::string &defaultValue)
+{
+	std::map<std::string, std::string>::iterator it;
+	std::string value = defaultValue;
+
+	pthread_mutex_lock(&dashboardMutex);
+	it = dashboardStrings.find(key);
+
+	if(it != dashboardStrings.end())
+	{
+		value = it->second;
+	}
+
+	pthread_mutex_unlock(&dashboardMutex);
+	return(value);
+}
+
+void SmartDashboard::PutBoolean(const std::string &key, bool value)
+{
+	PutNumber(key, value ? 1.0 : 0.0);
+}
+
+bool SmartDashboard::GetBoolean(const std::string &key, bool defaultValue)
+{
+	return(GetNumber(key, defaultValue ? 1.0 : 0.0) != 0.0);
+}
+
+RobotBase *RobotBase::pInstance = NULL;
+
+static void *SimCompetition(void *pRobot)
+{
+	RobotClock::GetInstance()->BeginTask();
+	((RobotBase *)pRobot)->StartCompetition();
+	return(NULL);
+}
+
+static void SimUsage(const char *szProgram)
+{
+	printf("usage: %s [options]\n"
+			"  --speed N          robot seconds per real second (1)\n"
+			"  --stepped          step the clock as fast as the robot keeps up, runs repeat exactly\n"
+			"  --disabled S       seconds disabled before autonomous (%0.0f)\n"
+			"  --auto S           seconds of autonomous (%0.0f)\n"
+			"  --teleop S         seconds of teleop after autonomous (%0.0f)\n"
+			"  --test S           seconds of test mode at the end, which runs the checklist (%0.0f)\n"
+			"  --select NAME      SendableChooser entry to pick, \"Mode 1\" for example\n"
+			"  --axis S:A=V       hold axis A of joystick S at V during teleop\n"
+			"  --latency N        move the drive stick N times a second in teleop and report the\n"
+			"                     joystick to motor latency, needs a clock that is not stepped\n"
+			"  --ds-rate HZ       control packets a second (50)\n"
+			"  --synthetic        fill each packet with random stick moves\n"
+			"  --replay FILE      fill the packets from a recording, over and over\n"
+			"  --record FILE      write every packet the robot gets to FILE\n"
+			"  --storm N          switch between disabled, auto and teleop N times a second\n"
+			"                     during teleop\n"
+			"scripts and trajectories are read from %s\n",
+			szProgram, fSimDisabledTime, fSimAutoTime, fSimTeleopTime, fSimTestTime, ROBOT_HOME);
+}
+
+///Lets fSeconds of robot time go by, stepping the clock ourselves on a stepped run
+void SimRun(double fSeconds)
+{
+	double fEnd = RobotClock::GetTime() + fSeconds;
+
+	if(pSimStepper == NULL)
+	{
+		RobotClock::Delay(fSeconds);
+		return;
+	}
+
+	while(pSimStepper->Now() + 0.5 * SIM_STEP < fEnd)
+	{
+		pSimStepper->Step(SIM_STEP);
+	}
+}
+
+///One part of the schedule, watched by the load generator if it has anything to do
+static void SimPhase(SimLoad *pLoad, double fSeconds, bool bStorm)
+{
+	if(pLoad->IsActive())
+	{
+		pLoad->Run(fSeconds, bStorm);
+	}
+	else
+	{
+		SimRun(fSeconds);
+	}
+}
+
+/** Swings the drive stick back and forth about fRate times a second for fSeconds.
+ *
+ * The moves are spread at random over the packet period so the wait for the next packet is
+ * sampled evenly, and each one is marked so the latency probe can time it from the stick.
+ */
+static void SimLatency(double fRate, double fSeconds)
+{
+	DriverStation *pDS = DriverStation::GetInstance();
+	double fEnd = RobotClock::GetTime() + fSeconds;
+	float fValue = SIM_LATENCY_SWING;
+	unsigned uSeed = 1;
+
+	while(true)
+	{
+		double fWait = (0.5 + rand_r(&uSeed) / (double)RAND_MAX) / fRate;
+
+		if(RobotClock::GetTime() + fWait >= fEnd)
+		{
+			break;
+		}
+
+		SimRun(fWait);
+		pDS->SimSetAxis(0, L310_THUMBSTICK_LEFT_X, fValue);
+		LatencyProbe::GetInstance()->MarkInput(RobotClock::GetTime());
+		fValue = -fValue;
+	}
+
+	SimRun(fEnd - RobotClock::GetTime());
+	pDS->SimSetAxis(0, L310_THUMBSTICK_LEFT_X, 0.0);
+}
+
+/** Runs the robot through the match schedule and reports where it ended up.
+ *
+ * The robot's own main loop never returns, so it gets a thread and this one keeps the
+ * schedule.  Tasks are not shut down at the end, the process just exits.
+ */
+int SimMain(int argc, char **argv, RobotBase *(*pCreateRobot)())
+{
+	DriverStation *pDS;
+	RobotBase *pRobot;
+	pthread_t competition;
+	std::vector<std::pair<std::pair<unsigned, unsigned>, float> > teleopAxes;
+	SimPose pose;
+	double fSpeed = 1.0;
+	double fLatencyRate = 0.0;
+	SimLoad *pLoad = new SimLoad();
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *szArg = argv[i];
+		const char *szValue = (i + 1 < argc) ? argv[i + 1] : NULL;
+		unsigned uStick;
+		unsigned uAxis;
+		float fValue;
+
+		if(!strcmp(szArg, "--stepped"))
+		{
+			pSimStepper = new SteppedClock();
+			continue;
+		}
+		else if(!strcmp(szArg, "--synthetic"))
+		{
+			pLoad->Synthesize(true);
+			continue;
+		}
+		else if(szValue == NULL)
+		{
+			SimUsage(argv[0]);
+			return(1);
+		}
+		else if(!strcmp(szArg, "--speed") && (atof(szValue) > 0.0))
+		{
+			fSpeed = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--disabled"))
+		{
+			fSimDisabledTime = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--auto"))
+		{
+			fSimAutoTime = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--teleop"))
+		{
+			fSimTeleopTime = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--test"))
+		{
+			fSimTestTime = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--select"))
+		{
+			SendableChooser::SimSelect(szValue);
+		}
+		else if(!strcmp(szArg, "--ds-rate") && (atof(szValue) > 0.0))
+		{
+			pLoad->SetPacketRate(atof(szValue));
+		}
+		else if(!strcmp(szArg, "--replay"))
+		{
+			if(!pLoad->Replay(szValue))
+			{
+				return(1);
+			}
+		}
+		else if(!strcmp(szArg, "--record"))
+		{
+			if(!pLoad->Record(szValue))
+			{
+				return(1);
+			}
+		}
+		else if(!strcmp(szArg, "--storm") && (atof(szValue) > 0.0))
+		{
+			pLoad->SetStormRate(atof(szValue));
+		}
+		else if(!strcmp(szArg, "--latency") && (atof(szValue) > 0.0))
+		{
+			fLatencyRate = atof(szValue);
+		}
+		else if(!strcmp(szArg, "--axis") && (sscanf(szValue, "%u:%u=%f", &uStick, &uAxis, &fValue) == 3))
+		{
+			teleopAxes.push_back(std::make_pair(std::make_pair(uStick, uAxis), fValue));
+		}
+		else
+		{
+			SimUsage(argv[0]);
+			return(1);
+		}
+
+		i++;
+	}
+
+	// the clock has to be chosen before anything reads it
+
+	if(pSimStepper != NULL)
+	{
+		RobotClock::Set(pSimStepper);
+	}
+	else
+	{
+		RobotClock::Set(new ScaledClock(fSpeed));
+	}
+
+	mkdir(ROBOT_HOME, 0777);
+
+	pDS = DriverStation::GetInstance();
+	pLoad->Start();
+	pRobot = pCreateRobot();
+	pthread_create(&competition, NULL, &SimCompetition, pRobot);
+	RobotClock::GetInstance()->AddTask();
+
+	SimPhase(pLoad, fSimDisabledTime, false);
+
+	if(fSimAutoTime > 0.0)
+	{
+		pDS->SimSetMode(DriverStation::kSimAutonomous);
+		SimPhase(pLoad, fSimAutoTime, false);
+	}
+
+	if(fSimTeleopTime > 0.0)
+	{
+		SmartDashboard::PutBoolean(LATENCY_ENABLE_KEY, fLatencyRate > 0.0);
+		pDS->SimSetMode(DriverStation::kSimTeleop);
+
+		for(unsigned i = 0; i < teleopAxes.size(); i++)
+		{
+			pDS->SimSetAxis(teleopAxes[i].first.first, teleopAxes[i].first.second, teleopAxes[i].second);
+		}
+
+		if(fLatencyRate > 0.0)
+		{
+			SimLatency(fLatencyRate, fSimTeleopTime);
+		}
+		else
+		{
+			SimPhase(pLoad, fSimTeleopTime, true);
+		}
+	}
+
+	if(fSimTestTime > 0.0)
+	{
+		pDS->SimSetMode(DriverStation::kSimTest);
+		SimPhase(pLoad, fSimTestTime, false);
+	}
+
+	pDS->SimSetMode(DriverStation::kSimDisabled);
+	SimPhase(pLoad, 2 * SIM_PACKET_PERIOD, false);
+
+	if(pLoad->IsActive())
+	{
+		pLoad->Report();
+	}
+
+	pose = SimPhysics::GetInstance()->GetPose();
+	printf("Simulation: %0.2f s, pose %0.2f, %0.2f in, heading %0.2f deg, auto status \"%s\"\n",
+			RobotClock::GetTime(), pose.x, pose.y, pose.fHeading,
+			SmartDashboard::GetString("Auto Status").c_str());
+
+	fflush(stdout);
+	_exit(0);
+}
@@ -0,0 +1,275 @@
+/** \file
+ * Desktop stand-in for the parts of WPILib the robot uses.
+ *
+ * The simulation build puts this directory ahead of WPILib on the include path, so the robot
+ * code compiles unchanged against it.  Every class keeps the WPILib 2015 signatures the robot
+ * calls and nothing more.  Motors, encoders, the gyro and the accelerometer are backed by the
+ * kiwi base model in SimPhysics; the driver station follows the match schedule given on the
+ * command line.  Time is the RobotClock, which may run faster than the wall clock or only
+ * move when the simulation steps it.
+ */
+
+#ifndef SIM_WPILIB_H
+#define SIM_WPILIB_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+typedef int (*FUNCPTR)(...);
+
+#define wpi_assert(condition) assert(condition)
+
+void Wait(double seconds);
+double GetTime();
+
+class Timer
+{
+public:
+	Timer();
+	void Start();
+	void Stop();
+	void Reset();
+	double Get();
+	static double GetFPGATimestamp();
+
+private:
+	double fStartTime;
+	double fAccumulated;
+	bool bRunning;
+};
+
+class Task
+{
+public:
+	static const uint32_t kDefaultPriority = 101;
+
+	Task(const char *name, FUNCPTR function, int32_t priority = kDefaultPriority, uint32_t stackSize = 20000);
+	virtual ~Task();
+
+	bool Start(intptr_t arg0 = 0);
+	bool IsReady() const { return(bStarted); };
+
+private:
+	std::string name;
+	FUNCPTR function;
+	pthread_t thread;
+	bool bStarted;
+};
+
+class SPI
+{
+public:
+	enum Port { kOnboardCS0, kOnboardCS1, kOnboardCS2, kOnboardCS3, kMXP };
+
+	explicit SPI(Port port);
+
+	void SetClockRate(double hz) {};
+	void SetMSBFirst() {};
+	void SetLSBFirst() {};
+	void SetClockActiveLow() {};
+	void SetClockActiveHigh() {};
+	void SetChipSelectActiveHigh() {};
+	void SetChipSelectActiveLow() {};
+	int32_t Transaction(uint8_t *dataToSend, uint8_t *dataReceived, uint8_t size);
+
+private:
+	Port port;
+};
+
+class CANSpeedController
+{
+public:
+	enum ControlMode { kPercentVbus = 0, kCurrent = 1, kSpeed = 2, kPosition = 3, kVoltage = 4, kFollower = 5 };
+};
+
+class CANTalon : public CANSpeedController
+{
+public:
+	enum FeedbackDevice { QuadEncoder = 0, AnalogPot = 2, AnalogEncoder = 3 };
+
+	explicit CANTalon(int deviceNumber);
+	virtual ~CANTalon() {};
+
+	void Set(float value, uint8_t syncGroup = 0);
+	float Get();
+	void SetControlMode(ControlMode mode) {};
+	void SetVoltageRampRate(double rampRate) {};
+	void SetFeedbackDevice(FeedbackDevice device) {};
+	void ConfigEncoderCodesPerRev(uint16_t codesPerRev) {};
+	void SetSafetyEnabled(bool enabled) {};
+	bool IsAlive() { return(true); };
+	double GetOutputCurrent();
+	int GetEncPosition();
+	int GetEncVel();
+	int GetDeviceID() { return(iDevice); };
+
+private:
+	int iDevice;
+};
+
+class BuiltInAccelerometer
+{
+public:
+	enum Range { kRange_2G = 0, kRange_4G = 1, kRange_8G = 2 };
+
+	explicit BuiltInAccelerometer(Range range = kRange_8G) {};
+
+	double GetX();
+	double GetY();
+	double GetZ();
+};
+
+///Simulation only, what the driver station hands out for joystick 0 in one control packet
+struct SimPacket {
+	float axes[12];
+	uint32_t buttons;
+};
+
+///Simulation only, plays the driver by filling in each packet as it is handed out
+class SimPacketSource
+{
+public:
+	virtual ~SimPacketSource() {};
+	virtual void Fill(unsigned uPacket, SimPacket &packet) = 0;
+};
+
+///Simulation only, how well the main loop kept up with the packets
+struct SimPacketStats {
+	unsigned uSent;				//!< packets the driver station has sent so far
+	unsigned uSeen;				//!< picked up by IsNewControlData()
+	unsigned uMissed;			//!< replaced by a newer one before the robot looked
+	unsigned uOverruns;			//!< times the robot came back after missing at least one
+	double fMaxAge;				//!< longest a packet waited to be picked up, seconds
+};
+
+class DriverStation
+{
+public:
+	static const uint32_t kJoystickPorts = 6;
+	static const uint32_t kMaxJoystickAxes = 12;
+	static const uint32_t kMaxJoystickButtons = 32;
+
+	static DriverStation *GetInstance();
+
+	float GetStickAxis(uint32_t stick, uint32_t axis);
+	bool GetStickButton(uint32_t stick, uint8_t button);
+	uint32_t GetStickButtons(uint32_t stick);
+	int GetStickPOV(uint32_t stick, uint32_t pov);
+	bool IsEnabled();
+	bool IsDisabled() { return(!IsEnabled()); };
+	bool IsAutonomous();
+	bool IsOperatorControl();
+	bool IsTest();
+	bool IsNewControlData();
+	void WaitForData();
+	float GetBatteryVoltage() { return(12.5); };
+
+	// simulation only, the match schedule and anything that plays the driver
+	enum SimMode { kSimDisabled, kSimAutonomous, kSimTeleop, kSimTest };
+	void SimSetMode(SimMode mode);
+	SimMode SimGetMode();
+	void SimSetAxis(uint32_t stick, uint32_t axis, float value);
+	void SimSetButton(uint32_t stick, uint32_t button, bool bDown);
+	void SimSetPOV(uint32_t stick, int angle);
+	void SimSetPacketRate(double fRate);
+	void SimSetPacketSource(SimPacketSource *pSource);
+	SimPacketStats SimGetPacketStats();
+
+private:
+	static DriverStation *pInstance;
+
+	pthread_mutex_t dsMutex;
+	SimMode mode;
+	float axes[kJoystickPorts][kMaxJoystickAxes];
+	uint32_t buttons[kJoystickPorts];
+	int povs[kJoystickPorts];		//the first POV of each stick, -1 when centered
+	double fPacketPeriod;			//seconds, packet n is sent at n periods
+	long long iLastPacket;			//the last one handed out, -1 before the first
+	SimPacketSource *pSource;
+	SimPacketStats stats;
+
+	DriverStation();
+};
+
+class Joystick
+{
+public:
+	explicit Joystick(uint32_t port) : uPort(port) {};
+	virtual ~Joystick() {};
+
+	float GetRawAxis(uint32_t axis);
+	bool GetRawButton(uint32_t button);
+	int GetPOV(uint32_t pov = 0);
+
+private:
+	uint32_t uPort;
+};
+
+class Sendable
+{
+public:
+	virtual ~Sendable() {};
+};
+
+class SendableChooser : public Sendable
+{
+public:
+	void AddObject(const char *name, void *object);
+	void AddDefault(const char *name, void *object);
+	void *GetSelected();
+
+	static void SimSelect(const char *name);
+
+private:
+	std::vector<std::pair<std::string, void *> > choices;
+	std::string defaultChoice;
+};
+
+class SmartDashboard
+{
+public:
+	static void init() {};
+	static void PutData(const std::string &key, Sendable *data) {};
+	static void PutNumber(const std::string &key, double value);
+	static double GetNumber(const std::string &key, double defaultValue = 0.0);
+	static void PutString(const std::string &key, const std::string &value);
+	static std::string GetString(const std::string &key, const std::string &defaultValue = "");
+	static void PutBoolean(const std::string &key, bool value);
+	static bool GetBoolean(const std::string &key, bool defaultValue = false);
+};
+
+class RobotBase
+{
+public:
+	static RobotBase &getInstance() { return(*pInstance); };
+
+	bool IsEnabled() { return(DriverStation::GetInstance()->IsEnabled()); };
+	bool IsDisabled() { return(DriverStation::GetInstance()->IsDisabled()); };
+	bool IsAutonomous() { return(DriverStation::GetInstance()->IsAutonomous()); };
+	bool IsOperatorControl() { return(DriverStation::GetInstance()->IsOperatorControl()); };
+	bool IsTest() { return(DriverStation::GetInstance()->IsTest()); };
+
+	virtual void StartCompetition() = 0;
+
+protected:
+	RobotBase() { pInstance = this; };
+	virtual ~RobotBase() {};
+
+private:
+	static RobotBase *pInstance;
+};
+
+int SimMain(int argc, char **argv, RobotBase *(*pCreateRobot)());
+void SimRun(double fSeconds);
+
+#define START_ROBOT_CLASS(_ClassName_) \
+	static RobotBase *SimCreateRobot() { return(new _ClassName_()); } \
+	int main(int argc, char **argv) { return(SimMain(argc, argv, &SimCreateRobot)); }
+
+#endif //SIM_WPILIB_H
@@ -4,16 +4,22 @@
  */
 
 #include "ADXRS453Z.h"
+#include "RobotParams.h"
 #include <cstdarg>
 
-int ADXRS453ZUpdateFunction(int pointer_val) {
-	ADXRS453Z * gyro = (ADXRS453Z *) pointer_val;
-	while (true)
+bool ADXRS453Z::Sample(void * pThis, SensorSample & sample) {
+	ADXRS453Z * gyro = (ADXRS453Z *) pThis;
+
+	gyro->Update();
+
+	if (gyro->calibration_timer->Get() < CALIBRATE_PERIOD)
 	{
-		gyro->Update();
-		Wait(0.01);
+		return false;
 	}
-	return 0;
+
+	sample.fValue[0] = gyro->current_rate;
+	sample.fValue[1] = gyro->accumulated_angle;
+	return true;
 }
 
 ADXRS453Z::ADXRS453Z() {
@@ -37,32 +43,32 @@ ADXRS453Z::ADXRS453Z() {
 	current_rate = 0.0;
 	accumulated_offset = 0.0;
 	rate_offset = 0.0;
-	update_timer = new Timer();
+	update_timer = new RobotTimer();
 	update_timer->Start();
-	calibration_timer = new Timer();
+	calibration_timer = new RobotTimer();
 	calibration_timer->Start();
 
-	update_task = new Task("tADSRX543Z", (FUNCPTR) &ADXRS453ZUpdateFunction); //TODO: this should give a unique name for each gyro object
-	task_started = false;
+	iSensor = -1;
+	uParityErrors.store(0);
 }
 
 void ADXRS453Z::Start() {
-	if (task_started)
+	SensorSampler * sampler = SensorSampler::GetInstance();
+
+	if (iSensor < 0)
 	{
-		update_task->Resume();
+		iSensor = sampler->Register("ADXRS453Z", &ADXRS453Z::Sample, this, GYRO_SAMPLE_RATE);
 	}
 	else
 	{
-		update_task->Start((int) this);
-		task_started = true;
+		sampler->Enable(iSensor, true);
 	}
+
+	sampler->Start();
 }
 
 void ADXRS453Z::Stop() {
-	if (task_started)
-	{
-		update_task->Suspend();
-	}
+	SensorSampler::GetInstance()->Enable(iSensor, false);
 }
 
 void ADXRS453Z::Update() {
@@ -70,6 +76,12 @@ void ADXRS453Z::Update() {
 	check_parity(command);
 	spi->Transaction(command, data, DATA_SIZE); //perform transaction, get error code
 
+	//the gyro answers with odd parity over all 32 bits too
+	if ((bits(data[0]) + bits(data[1]) + bits(data[2]) + bits(data[3])) % 2 == 0)
+	{
+		uParityErrors++;
+	}
+
 	if (calibration_timer->Get() < WARM_UP_PERIOD)
 	{
 		lastTime = thisTime = update_timer->Get();
@@ -5,13 +5,15 @@
 #ifndef ADXRS450GYRO_H_
 #define ADXRS450GYRO_H_
 
+#include <atomic>
+
 #include "WPILib.h"
+#include "SensorSampler.h"
+#include "RobotClock.h"
 
 const float WARM_UP_PERIOD = 5.0;  //seconds
 const float CALIBRATE_PERIOD = 15.0; //seconds
 
-int ADXRS453ZUpdateFunction(int pointer_val);
-
 class ADXRS453Z {
 	public:
 		ADXRS453Z();
@@ -23,7 +25,11 @@ class ADXRS453Z {
 		float Offset();
 		void Start();
 		void Stop();
+		int GetSensor() { return iSensor; } //sampler id, samples hold rate then angle
+		unsigned GetParityErrors() { return uParityErrors.load(); } //responses that failed the odd parity check
 	private:
+		friend struct RobotBench; //the benchmarks time the SPI helpers directly
+		static bool Sample(void * pThis, SensorSample & sample); //called from the sensor task
 		void UpdateData();
 		void Calibrate();
 		static void check_parity(unsigned char * command); //gyro requires odd parity for command
@@ -35,16 +41,16 @@ class ADXRS453Z {
 		static const unsigned char THIRD_BYTE_DATA = 0xFC; //mask to find sensor data bits on third byte: D D D D D D X X
 		static const unsigned char READ_COMMAND = 0x20; //0010 0000 for first byte
 		float accumulated_angle;
-		Timer * update_timer;
-		Timer * calibration_timer;
+		RobotTimer * update_timer;
+		RobotTimer * calibration_timer;
 		float current_rate;
 		float accumulated_offset;
 		float rate_offset;
 		unsigned char command[4];
 		unsigned char data[4];
 		SPI * spi;
-		Task * update_task;
-		bool task_started;
+		int iSensor;
+		std::atomic<unsigned> uParityErrors;
 		char sensor_output_1[9];
 		char sensor_output_2[9];
 
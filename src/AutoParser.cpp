@@ -1,10 +1,16 @@
 /** \file
  *  Autonomous script parser
+ *
+ *  Scripts are compiled when they are loaded.  Tokens are found through a perfect hash: the
+ *  compiler searches for a seed that puts every token in its own slot of a small table, so a
+ *  lookup is one hash and one string compare.  Parameters are converted and checked here so
+ *  Execute() never has to look at text.
  */
 
 #include "AutoParser.h"
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <iostream>
 #include <fstream>
@@ -16,144 +22,702 @@
 #include "ComponentBase.h"
 #include "RobotParams.h"
 #include "Autonomous.h"
+#include "StateEstimator.h"
+#include "SensorSampler.h"
+#include "PathPlanner.h"
 
 using namespace std;
 
-const char *szTokens[] = {
-		"START"
-		"FINISH"
-		"MODE",
-		"DEBUG",
-		"MESSAGE",
-		"BEGIN",
-		"END",
-		"DELAY",			//!<(seconds)
-		"NOP" };
-//TODO: add START and FINISH, which send messages to all components
+///Spelling and parameters of each token, in AUTO_COMMAND_TOKENS order
+static constexpr struct {
+	const char *szName;
+	int iParams;				//numeric parameters required
+	int iOptional;				//numeric parameters that may follow them, 0 when left out
+	bool bText;					//the rest of the line is kept as text
+	bool bBranch;				//allowed between PARALLEL and JOIN
+} autoTokens[AUTO_TOKEN_LAST] = {
+		{ "START",			0, 0, false,	false },
+		{ "FINISH",			0, 0, false,	false },
+		{ "MODE",			1, 0, false,	false },
+		{ "DEBUG",			1, 0, false,	true },
+		{ "MESSAGE",		0, 0, true,		true },
+		{ "BEGIN",			0, 0, false,	false },
+		{ "END",			0, 0, false,	false },
+		{ "DELAY",			1, 0, false,	true },			//!<(seconds)
+		{ "PARALLEL",		0, 0, false,	false },
+		{ "RACE",			0, 0, false,	false },
+		{ "JOIN",			0, 0, false,	false },
+		{ "WAIT_UNTIL",		0, 0, false,	true },			//!<(value comparison number)
+		{ "DRIVE_DISTANCE",	2, 1, false,	true },			//!<(speed inches [timeout])
+		{ "TURN_ANGLE",		2, 1, false,	true },			//!<(speed degrees [timeout])
+		{ "DRIVE_TIME",		2, 1, false,	true },			//!<(speed seconds [timeout])
+		{ "PATH",			0, 0, false,	true },			//!<(velocity acceleration x y heading ...)
+		{ "TRAJECTORY",		0, 0, false,	true },			//!<(file name)
+};
+
+///Values WAIT_UNTIL can test, each is one value of a sampler entry
+static const struct {
+	const char *szName;
+	const char *szSensor;		//name the entry registered with
+	int iValue;
+} autoConditions[] = {
+		{ "HEADING",	"StateEstimator",	0 },
+		{ "RATE",		"StateEstimator",	1 },
+		{ "VX",			"StateEstimator",	2 },
+		{ "VY",			"StateEstimator",	3 },
+		{ "X",			"KiwiOdometry",		0 },
+		{ "Y",			"KiwiOdometry",		1 },
+		{ "CURRENT",	"DriveCurrent",		3 },
+};
+
+static const struct {
+	const char *szName;
+	SensorCompare compare;
+} autoCompares[] = {
+		{ ">",	SENSOR_ABOVE },
+		{ ">=",	SENSOR_AT_LEAST },
+		{ "<",	SENSOR_BELOW },
+		{ "<=",	SENSOR_AT_MOST },
+};
+//TODO: START and FINISH should send messages to all components
 // (Begin and End are doing this now, but they shouldn't)
 
-bool Autonomous::Evaluate(std::string rStatement) {
+static constexpr unsigned HashToken(const char *szToken, unsigned uSeed)
+{
+	unsigned uHash = 2166136261u ^ uSeed;
+
+	while(*szToken)
+	{
+		uHash ^= (unsigned char)*szToken++;
+		uHash *= 16777619u;
+	}
+
+	// fold the high bits in, the low bits of FNV only ever see the low bits of the seed
+	return((uHash ^ (uHash >> 16)) & (AUTO_TOKEN_HASH_SIZE - 1));
+}
+
+///True if every token hashes to its own slot with uSeed
+static constexpr bool TokenSeedIsPerfect(unsigned uSeed)
+{
+	bool bUsed[AUTO_TOKEN_HASH_SIZE] = {};
+
+	for(int i = 0; i < AUTO_TOKEN_LAST; i++)
+	{
+		unsigned uHash = HashToken(autoTokens[i].szName, uSeed);
+
+		if(bUsed[uHash])
+		{
+			return(false);
+		}
+
+		bUsed[uHash] = true;
+	}
+
+	return(true);
+}
+
+///The first perfect seed, AUTO_TOKEN_SEED_LIMIT if there is none
+static constexpr unsigned FindTokenSeed()
+{
+	for(unsigned uSeed = 0; uSeed < AUTO_TOKEN_SEED_LIMIT; uSeed++)
+	{
+		if(TokenSeedIsPerfect(uSeed))
+		{
+			return(uSeed);
+		}
+	}
+
+	return(AUTO_TOKEN_SEED_LIMIT);
+}
+
+static constexpr unsigned AUTO_TOKEN_SEED = FindTokenSeed();
+
+static_assert(AUTO_TOKEN_SEED < AUTO_TOKEN_SEED_LIMIT,
+		"no seed puts every script token in its own slot, make AUTO_TOKEN_HASH_SIZE bigger");
+
+///Token lookup table, filled in the first time a script is compiled
+struct TokenHash {
+	signed char iSlot[AUTO_TOKEN_HASH_SIZE];
+
+	TokenHash()
+	{
+		memset(iSlot, -1, sizeof(iSlot));
+
+		for(int i = 0; i < AUTO_TOKEN_LAST; i++)
+		{
+			iSlot[HashToken(autoTokens[i].szName, AUTO_TOKEN_SEED)] = i;
+		}
+	}
+};
+
+///Returns the AUTO_COMMAND_TOKENS value for szToken or -1 if there is no such token
+int AutoProgram::LookupToken(const char *szToken)
+{
+	static const TokenHash tokenHash;
+	int iCommand = tokenHash.iSlot[HashToken(szToken, AUTO_TOKEN_SEED)];
+
+	if((iCommand >= 0) && !strcmp(szToken, autoTokens[iCommand].szName))
+	{
+		return(iCommand);
+	}
+
+	return(-1);
+}
+
+AutoProgram::AutoProgram()
+{
+	instructions.reserve(AUTONOMOUS_SCRIPT_LINES);
+	uOpenBlockLine = 0;
+	memset(iModeEntry, -1, sizeof(iModeEntry));
+}
+
+void AutoProgram::Clear()
+{
+	instructions.clear();
+	errors.clear();
+	text.clear();
+	paths.clear();
+	uOpenBlockLine = 0;
+	memset(iModeEntry, -1, sizeof(iModeEntry));
+}
+
+///False for a script without MODE lines, which is all one routine
+bool AutoProgram::HasModes() const
+{
+	for(int i = 0; i < AUTO_MAX_MODES; i++)
+	{
+		if(iModeEntry[i] >= 0)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+///Where to start running uMode, a script without MODE lines is all one routine
+unsigned AutoProgram::GetModeEntry(unsigned uMode) const
+{
+	if(HasMode(uMode))
+	{
+		return(iModeEntry[uMode]);
+	}
+
+	return(0);
+}
+
+///Compiles a whole script, returns false if any line had an error
+bool AutoProgram::Compile(std::istream &script)
+{
+	std::string line;
+	unsigned uLine = 0;
+
+	Clear();
+
+	while(getline(script, line))
+	{
+		// scripts edited on Windows end their lines with a return
+
+		if(!line.empty() && (line[line.size() - 1] == '\r'))
+		{
+			line.erase(line.size() - 1);
+		}
+
+		CompileLine(line, ++uLine);
+	}
+
+	if(uOpenBlockLine)
+	{
+		AddError(uOpenBlockLine, "no JOIN for", "PARALLEL/RACE");
+	}
+
+	return(errors.empty());
+}
+
+unsigned AutoProgram::AddText(const char *szText)
+{
+	unsigned uOffset = text.size();
+
+	text.append(szText);
+	text.push_back('\0');
+	return(uOffset);
+}
+
+void AutoProgram::AddError(unsigned uLine, const char *szError, const char *szDetail)
+{
+	char szMessage[128];
+
+	snprintf(szMessage, sizeof(szMessage), "line %u: %s %s", uLine, szError, szDetail);
+	errors.push_back(szMessage);
+}
+
+bool AutoProgram::CompileLine(const std::string &line, unsigned uLine)
+{
+	AutoInstruction instruction;
+	std::vector<char> buffer(line.begin(), line.end());
 	char *pToken;
 	char *pCurrLinePos;
+	char *pEnd;
 	int iCommand;
-	float fParam1;
-	//int iParam1;
-	bool bReturn = false; ///setting this to true WILL cause auto parsing to quit!
-	string rStatus;
 
-	if(rStatement.empty()) {
-		printf("statement is empty");
-		return (bReturn);
+	buffer.push_back('\0');
+
+	// find first token, skipping blank lines and comments
+
+	pToken = strtok_r(&buffer[0], szDelimiters, &pCurrLinePos);
+
+	if((pToken == NULL) || (*pToken == sComment))
+	{
+		return(true);
+	}
+
+	iCommand = LookupToken(pToken);
+
+	if(iCommand < 0)
+	{
+		AddError(uLine, "no such token - check script spelling:", pToken);
+		return(false);
+	}
+
+	memset(&instruction, 0, sizeof(instruction));
+	instruction.token = (AUTO_COMMAND_TOKENS)iCommand;
+	instruction.uLine = uLine;
+
+	if(autoTokens[iCommand].bText)
+	{
+		instruction.uText = AddText(pCurrLinePos);
+	}
+	else if(instruction.token == AUTO_TOKEN_WAIT_UNTIL)
+	{
+		if(!CompileCondition(instruction, &pCurrLinePos, uLine))
+		{
+			return(false);
+		}
+	}
+	else if(instruction.token == AUTO_TOKEN_PATH)
+	{
+		if(!CompilePath(instruction, &pCurrLinePos, uLine))
+		{
+			return(false);
+		}
+	}
+	else if(instruction.token == AUTO_TOKEN_TRAJECTORY)
+	{
+		if(!CompilePathFile(instruction, &pCurrLinePos, uLine))
+		{
+			return(false);
+		}
+	}
+	else
+	{
+		for(int i = 0; i < autoTokens[iCommand].iParams + autoTokens[iCommand].iOptional; i++)
+		{
+			pToken = strtok_r(NULL, szDelimiters, &pCurrLinePos);
+
+			if((pToken == NULL) || (*pToken == sComment))
+			{
+				if(i >= autoTokens[iCommand].iParams)
+				{
+					break;
+				}
+
+				AddError(uLine, "missing parameter for", autoTokens[iCommand].szName);
+				return(false);
+			}
+
+			instruction.fParam[i] = strtof(pToken, &pEnd);
+
+			if((pEnd == pToken) || (*pEnd != '\0'))
+			{
+				AddError(uLine, "not a number:", pToken);
+				return(false);
+			}
+		}
+
+		// the loop already stops on a comment when optional parameters are left out
+
+		if((pToken != NULL) && (*pToken != sComment))
+		{
+			pToken = strtok_r(NULL, szDelimiters, &pCurrLinePos);
+		}
+
+		if((pToken != NULL) && (*pToken != sComment))
+		{
+			AddError(uLine, "too many parameters:", pToken);
+			return(false);
+		}
+	}
+
+	if((instruction.token == AUTO_TOKEN_DELAY) && (instruction.fParam[0] < 0.0))
+	{
+		AddError(uLine, "negative delay for", autoTokens[iCommand].szName);
+		return(false);
+	}
+
+	if((instruction.token == AUTO_TOKEN_DRIVE_DISTANCE) || (instruction.token == AUTO_TOKEN_TURN_ANGLE) ||
+			(instruction.token == AUTO_TOKEN_DRIVE_TIME))
+	{
+		if((instruction.fParam[0] == 0.0) || (fabs(instruction.fParam[0]) > 1.0))
+		{
+			AddError(uLine, "speed must be from 0 to 1 for", autoTokens[iCommand].szName);
+			return(false);
+		}
+
+		if((instruction.fParam[2] < 0.0) ||
+				((instruction.token == AUTO_TOKEN_DRIVE_TIME) && (instruction.fParam[1] < 0.0)))
+		{
+			AddError(uLine, "negative time for", autoTokens[iCommand].szName);
+			return(false);
+		}
+	}
+
+	// blocks cannot nest and only hold commands that can run side by side
+
+	if((instruction.token == AUTO_TOKEN_PARALLEL) || (instruction.token == AUTO_TOKEN_RACE))
+	{
+		if(uOpenBlockLine)
+		{
+			AddError(uLine, "blocks cannot nest:", autoTokens[iCommand].szName);
+			return(false);
+		}
+
+		uOpenBlockLine = uLine;
+	}
+	else if(instruction.token == AUTO_TOKEN_JOIN)
+	{
+		if(!uOpenBlockLine)
+		{
+			AddError(uLine, "no PARALLEL or RACE for", autoTokens[iCommand].szName);
+			return(false);
+		}
+
+		uOpenBlockLine = 0;
 	}
+	else if(uOpenBlockLine && !autoTokens[iCommand].bBranch)
+	{
+		AddError(uLine, "not allowed between PARALLEL and JOIN:", autoTokens[iCommand].szName);
+		return(false);
+	}
+
+	if(instruction.token == AUTO_TOKEN_MODE)
+	{
+		int iMode = (int)instruction.fParam[0];
+		char szMode[16];
 
-	// process the autonomous motion
+		if((iMode < 0) || (iMode >= AUTO_MAX_MODES) || (iMode != instruction.fParam[0]))
+		{
+			snprintf(szMode, sizeof(szMode), "%d", AUTO_MAX_MODES - 1);
+			AddError(uLine, "MODE must be a whole number from 0 to", szMode);
+			return(false);
+		}
 
-	pCurrLinePos = (char *) rStatement.c_str();
+		if(iModeEntry[iMode] >= 0)
+		{
+			snprintf(szMode, sizeof(szMode), "%d", iMode);
+			AddError(uLine, "MODE used twice:", szMode);
+			return(false);
+		}
 
-	if(*pCurrLinePos == sComment) {
-		return (bReturn);
+		iModeEntry[iMode] = instructions.size();
 	}
 
-	// find first token
+	// keep the line for the dashboard and debug output
 
-	pToken = strtok_r(pCurrLinePos, szDelimiters, &pCurrLinePos);
+	instruction.uSource = AddText(line.c_str());
 
-	if(pToken == NULL)
+	instructions.push_back(instruction);
+	return(true);
+}
+
+///Reads "value comparison number" for WAIT_UNTIL, the number goes in fParam[0]
+bool AutoProgram::CompileCondition(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine)
+{
+	const unsigned uConditions = sizeof(autoConditions) / sizeof(autoConditions[0]);
+	const unsigned uCompares = sizeof(autoCompares) / sizeof(autoCompares[0]);
+	char *pToken;
+	char *pEnd;
+	unsigned u;
+
+	pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos);
+
+	if((pToken == NULL) || (*pToken == sComment))
 	{
-		SmartDashboard::PutString("Auto Status","DEATH BY PARAMS!");
-		PRINTAUTOERROR;
-		rStatus.append("missing token");
-		printf("%0.3lf %s\n", pDebugTimer->Get(), rStatement.c_str());
-		return (true);
+		AddError(uLine, "missing value for", "WAIT_UNTIL");
+		return(false);
 	}
 
-	// which command are we to execute??
-	// this can be (easily) be made much faster... any student want to improve on this?
+	for(u = 0; (u < uConditions) && strcmp(pToken, autoConditions[u].szName); u++)
+	{
+	}
+
+	if(u == uConditions)
+	{
+		AddError(uLine, "WAIT_UNTIL cannot test", pToken);
+		return(false);
+	}
+
+	instruction.uCondition = u;
+	pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos);
+
+	if((pToken == NULL) || (*pToken == sComment))
+	{
+		AddError(uLine, "missing comparison for", "WAIT_UNTIL");
+		return(false);
+	}
+
+	for(u = 0; (u < uCompares) && strcmp(pToken, autoCompares[u].szName); u++)
+	{
+	}
+
+	if(u == uCompares)
+	{
+		AddError(uLine, "not a comparison:", pToken);
+		return(false);
+	}
+
+	instruction.uCompare = autoCompares[u].compare;
+	pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos);
+
+	if((pToken == NULL) || (*pToken == sComment))
+	{
+		AddError(uLine, "missing parameter for", "WAIT_UNTIL");
+		return(false);
+	}
+
+	instruction.fParam[0] = strtof(pToken, &pEnd);
+
+	if((pEnd == pToken) || (*pEnd != '\0'))
+	{
+		AddError(uLine, "not a number:", pToken);
+		return(false);
+	}
+
+	pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos);
+
+	if((pToken != NULL) && (*pToken != sComment))
+	{
+		AddError(uLine, "too many parameters:", pToken);
+		return(false);
+	}
+
+	return(true);
+}
+
+///Reads "velocity acceleration x y heading x y heading ..." for PATH
+bool AutoProgram::CompilePath(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine)
+{
+	std::vector<float> numbers;
+	AutoPath path;
+	char *pToken;
+	char *pEnd;
+
+	while(((pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos)) != NULL) && (*pToken != sComment))
+	{
+		numbers.push_back(strtof(pToken, &pEnd));
 
-	for(iCommand = AUTO_TOKEN_MODE; iCommand < AUTO_TOKEN_LAST; iCommand++) {
-		//printf("comparing %s to %s\n", pToken, szTokens[iCommand]);
-		if(!strncmp(pToken, szTokens[iCommand], strlen(szTokens[iCommand]))) {
-			break;
+		if((pEnd == pToken) || (*pEnd != '\0'))
+		{
+			AddError(uLine, "not a number:", pToken);
+			return(false);
 		}
 	}
 
-	if(iCommand == AUTO_TOKEN_LAST) {
-		// no valid token found
-		rStatus.append("no tokens - check script spelling");
-		printf("%0.3lf %s\n", pDebugTimer->Get(), rStatement.c_str());
-		return (true);
+	if((numbers.size() < 8) || ((numbers.size() - 2) % 3 != 0))
+	{
+		AddError(uLine, "PATH needs velocity, acceleration and x y heading for each waypoint, at least", "two");
+		return(false);
+	}
+
+	if((numbers[0] <= 0.0) || (numbers[1] <= 0.0))
+	{
+		AddError(uLine, "limits must be positive for", "PATH");
+		return(false);
+	}
+
+	if((numbers.size() - 2) / 3 > TRAJECTORY_MAX_WAYPOINTS)
+	{
+		AddError(uLine, "too many waypoints for", "PATH");
+		return(false);
+	}
+
+	path.limits.fMaxVelocity = numbers[0];
+	path.limits.fMaxAccel = numbers[1];
+
+	for(unsigned u = 2; u < numbers.size(); u += 3)
+	{
+		TrajectoryWaypoint waypoint = { numbers[u], numbers[u + 1], numbers[u + 2] };
+
+		path.waypoints.push_back(waypoint);
+	}
+
+	path.uKey = Trajectory::MakeKey(&path.waypoints[0], path.waypoints.size(), path.limits);
+	instruction.uPath = paths.size();
+	paths.push_back(path);
+	return(true);
+}
+
+///Reads the file name for TRAJECTORY, the file itself is only looked at when the planner maps it
+bool AutoProgram::CompilePathFile(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine)
+{
+	char *pToken = strtok_r(NULL, szDelimiters, ppCurrLinePos);
+	AutoPath path;
+
+	if((pToken == NULL) || (*pToken == sComment) || (strchr(pToken, '/') != NULL))
+	{
+		AddError(uLine, "TRAJECTORY needs the name of a file in", PATH_CACHE_DIR);
+		return(false);
 	}
 
+	memset(&path.limits, 0, sizeof(path.limits));
+	path.fileName = pToken;
+	path.uKey = Trajectory::MakeKey(pToken);
+	instruction.uPath = paths.size();
+	paths.push_back(path);
+	return(true);
+}
+
+/** What a command that could fail means for the script, returns true when it should stop.
+ *
+ * Outside a block a failure stops the script right away.  Inside one the other branches are
+ * already running, so the failure is kept for JOIN, which waits for them and then fails.
+ */
+bool Autonomous::StopOnFailure(bool bOk) {
+	if(bInBlock)
+	{
+		bBlockFailed = bBlockFailed || !bOk;
+		return(false);
+	}
+
+	return(!bOk);
+}
+
+///Runs one compiled instruction, returns true when the script should stop
+bool Autonomous::Execute(const AutoInstruction &instruction) {
+	bool bReturn = false; ///setting this to true WILL cause auto parsing to quit!
+	StateEstimate state;
+
 	// if we are paused wait here before executing a real command
 
 	while(bPauseAutoMode)
 	{
-		Wait(0.02);
+		RobotClock::Delay(0.02);
 	}
 
 	// execute the proper command
 
 	if(iAutoDebugMode)
 	{
-		printf("%0.3lf %s %s\n", pDebugTimer->Get(), pToken, pCurrLinePos);
+		printf("%0.3lf %s\n", pDebugTimer->Get(), pProgram->GetSource(instruction));
 	}
 
-	switch (iCommand)
+	switch (instruction.token)
 	{
 
 	case AUTO_TOKEN_START_AUTO:
 		Start();
-		rStatus.append("starting auto");
 		break;
 
 	case AUTO_TOKEN_FINISH_AUTO:
 		Finish();
-		rStatus.append("finishing auto");
 		break;
 
 	case AUTO_TOKEN_BEGIN:
-		Begin(pCurrLinePos);
-		rStatus.append("begin");
+		Begin();
 		break;
 
 	case AUTO_TOKEN_END:
-		End(pCurrLinePos);
-		rStatus.append("done");
+		End();
 		bReturn = true;
 		break;
 
 	case AUTO_TOKEN_DEBUG:
-		pToken = strtok_r(pCurrLinePos, szDelimiters, &pCurrLinePos);
-		iAutoDebugMode = atoi(pToken);
+		iAutoDebugMode = (int)instruction.fParam[0];
 		break;
 
 	case AUTO_TOKEN_MESSAGE:
-		printf("%0.3lf %03d: %s\n", pDebugTimer->Get(), lineNumber, pCurrLinePos);
+		if(StateEstimator::GetInstance() && StateEstimator::GetInstance()->GetEstimate(state))
+		{
+			printf("%0.3lf %03u: %s (heading %0.1f vel %0.1f,%0.1f)\n", pDebugTimer->Get(), instruction.uLine,
+					pProgram->GetText(instruction), state.fHeading, state.fVelocityX, state.fVelocityY);
+		}
+		else
+		{
+			printf("%0.3lf %03u: %s\n", pDebugTimer->Get(), instruction.uLine, pProgram->GetText(instruction));
+		}
 		break;
 
 	case AUTO_TOKEN_DELAY:
-		pToken = strtok_r(pCurrLinePos, szDelimiters, &pCurrLinePos);
+		if(bInBlock)
+		{
+			bReturn = StopOnFailure(DelayDispatch(instruction.fParam[0]));
+		}
+		else
+		{
+			Delay(instruction.fParam[0]);
+		}
+		break;
 
-		if (pToken == NULL)
+	case AUTO_TOKEN_PARALLEL:
+	case AUTO_TOKEN_RACE:
+		bInBlock = true;
+		bBlockFailed = false;
+		bRaceBlock = (instruction.token == AUTO_TOKEN_RACE);
+		break;
+
+	case AUTO_TOKEN_JOIN:
+		bInBlock = false;
+		bReturn = !Join(bRaceBlock) || bBlockFailed;
+		bBlockFailed = false;
+		break;
+
+	case AUTO_TOKEN_WAIT_UNTIL:
+		if(bInBlock)
 		{
-			rStatus.append("missing parameter");
+			bReturn = StopOnFailure(WaitUntilDispatch(autoConditions[instruction.uCondition].szSensor,
+					autoConditions[instruction.uCondition].iValue,
+					(SensorCompare)instruction.uCompare, instruction.fParam[0]));
 		}
 		else
 		{
-			fParam1 = atof(pToken);
-			rStatus.append("wait");
+			bReturn = StopOnFailure(WaitUntil(autoConditions[instruction.uCondition].szSensor,
+					autoConditions[instruction.uCondition].iValue,
+					(SensorCompare)instruction.uCompare, instruction.fParam[0]));
+		}
+		break;
+
+	case AUTO_TOKEN_DRIVE_DISTANCE:
+		bReturn = StopOnFailure(Drive(COMMAND_DRIVETRAIN_DRIVE_DISTANCE, instruction));
+		break;
+
+	case AUTO_TOKEN_TURN_ANGLE:
+		bReturn = StopOnFailure(Drive(COMMAND_DRIVETRAIN_TURN_ANGLE, instruction));
+		break;
 
-			Delay(fParam1);
+	case AUTO_TOKEN_DRIVE_TIME:
+		bReturn = StopOnFailure(Drive(COMMAND_DRIVETRAIN_DRIVE_TIME, instruction));
+		break;
+
+	case AUTO_TOKEN_PATH:
+	case AUTO_TOKEN_TRAJECTORY:
+		bReturn = StopOnFailure(FollowPath(pProgram->GetPath(instruction.uPath)));
+		break;
+
+	case AUTO_TOKEN_MODE:
+		// running into the next mode means this one forgot its END
+
+		if(lineNumber != uEntryLine)
+		{
+			bReturn = true;
 		}
 		break;
+
 	default:
-		rStatus.append("unknown token");
 		break;
 	}
 
 	if(bReturn)
 	{
-		printf("%0.3lf %s\n", pDebugTimer->Get(), rStatement.c_str());
+		printf("%0.3lf %s\n", pDebugTimer->Get(), pProgram->GetSource(instruction));
 	}
 
 	SmartDashboard::PutBoolean("bReturn", bReturn);
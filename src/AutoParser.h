@@ -1,14 +1,70 @@
 /** \file
  * Tokens used in our scripting language
+ *
+ * Scripts are compiled once, when they are loaded, into an array of AutoInstructions with
+ * their parameters already converted.  Mistakes are reported with their line number before
+ * autonomous starts, and nothing is parsed while the script is running.
+ *
+ * Commands between PARALLEL and JOIN are all sent at once and JOIN waits for every one of them
+ * to respond.  RACE works the same way but JOIN returns as soon as the first one finishes and
+ * cancels the others.  A DELAY inside a block is a branch that finishes on its own, so a RACE
+ * with a DELAY in it is a timeout.
+ *
+ * One script holds a library of routines, each starting with a MODE line.  The compiler
+ * remembers where each MODE starts so the selected routine can start without searching.
+ *
+ * WAIT_UNTIL waits for a published value to cross a threshold.  The sensor task checks it as
+ * each sample arrives, so the script carries on within one sample of the condition coming
+ * true.  Put it in a RACE with a DELAY to give up after a while.  The values are HEADING and
+ * RATE (degrees, degrees/s), VX and VY (field inches/s), X and Y (field inches) and CURRENT
+ * (amps, the highest drive motor); the comparisons are >, >=, < and <=.
+ *
+ * DRIVE_DISTANCE, TURN_ANGLE and DRIVE_TIME run closed loop in the drivetrain and answer when
+ * they finish.  Speed is motor power up to 1, and a negative speed makes DRIVE_TIME back up.
+ * The optional last parameter is a timeout in seconds; a motion that takes longer is
+ * cancelled and fails.
+ *
+ * PATH gives a wheel speed and acceleration limit (inches/s, inches/s/s) and then x y heading
+ * for each waypoint in the field frame, starting where the robot will be.  Every PATH is
+ * handed to the PathPlanner when the script loads, so its trajectory is ready by the time
+ * autonomous starts.  The drivetrain follows it at its control rate and answers when the robot
+ * has arrived.  TRAJECTORY follows one made off the robot instead, by the name of its file in
+ * the path cache directory.
+ *
+ *	\verbatim
+	PARALLEL
+		MESSAGE both delays start now
+		DELAY 1.0
+		DELAY 2.0
+	JOIN
+	RACE
+		WAIT_UNTIL HEADING >= 90
+		DELAY 3.0
+	JOIN
+	DRIVE_DISTANCE 0.6 48.0 4.0
+	TURN_ANGLE 0.5 -90.0
+	PATH 60 120  0 0 0  24 36 0  48 48 90
+	TRAJECTORY scoring.traj
+	\endverbatim
  */
 
 #ifndef AUTOPARSER_H
 #define AUTOPARSER_H
 
-// any line in the parser file that begins with a space or a # is skipped
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "Trajectory.h"
+
+// any line in the parser file that begins with a # or is blank is skipped
 
 const char sComment = '#';
-const char szDelimiters[] = " ,[]()";
+const char szDelimiters[] = " \t\r,[]()";
+const int AUTO_MAX_PARAMS = 3;
+const unsigned AUTO_TOKEN_HASH_SIZE = 64;			//must be a power of two
+const unsigned AUTO_TOKEN_SEED_LIMIT = 1 << 12;		//perfect hash seeds the compiler tries
+const int AUTO_MAX_MODES = 16;						//MODE numbers run from 0 to AUTO_MAX_MODES - 1
 
 ///N - doesn't need a response; R - needs a response; _ - contained within auto thread
 typedef enum AUTO_COMMAND_TOKENS
@@ -21,8 +77,74 @@ typedef enum AUTO_COMMAND_TOKENS
 	AUTO_TOKEN_BEGIN,				//!<	mark beginning of mode block
 	AUTO_TOKEN_END,					//!<	mark end of mode block
 	AUTO_TOKEN_DELAY,				//!<	delay (seconds - float)
+	AUTO_TOKEN_PARALLEL,			//!<	start sending commands without waiting, JOIN waits for all of them
+	AUTO_TOKEN_RACE,				//!<	like PARALLEL but JOIN waits for the first and cancels the rest
+	AUTO_TOKEN_JOIN,				//!<	wait for the commands since PARALLEL or RACE
+	AUTO_TOKEN_WAIT_UNTIL,			//!<	wait for a condition, value comparison number
+	AUTO_TOKEN_DRIVE_DISTANCE,		//!<R	drive straight, speed inches [timeout]
+	AUTO_TOKEN_TURN_ANGLE,			//!<R	turn in place, speed degrees [timeout]
+	AUTO_TOKEN_DRIVE_TIME,			//!<R	drive straight, speed seconds [timeout]
+	AUTO_TOKEN_PATH,				//!<R	trajectory, velocity acceleration then x y heading per waypoint
+	AUTO_TOKEN_TRAJECTORY,			//!<R	trajectory from a file, name
 	AUTO_TOKEN_LAST
 } AUTO_COMMAND_TOKENS;
 
-#endif  // AUTOPARSER_H
+///One script line, ready to run
+struct AutoInstruction {
+	AUTO_COMMAND_TOKENS token;
+	unsigned uLine;							//!< line in the script file, counting from 1
+	unsigned uSource;						//!< offset of the original line in the text pool
+	unsigned uText;							//!< offset of MESSAGE text in the text pool
+	unsigned char uCondition;				//!< WAIT_UNTIL value, index into the condition table
+	unsigned char uCompare;					//!< WAIT_UNTIL comparison, a SensorCompare
+	unsigned uPath;							//!< PATH and TRAJECTORY, index into the program's paths
+	float fParam[AUTO_MAX_PARAMS];
+};
+
+///The waypoints and limits of one PATH line, or the file of a TRAJECTORY
+struct AutoPath {
+	TrajectoryLimits limits;
+	std::vector<TrajectoryWaypoint> waypoints;
+	std::string fileName;
+	uint64_t uKey;							//!< what the PathPlanner knows it by
+};
+
+///A compiled script
+class AutoProgram
+{
+public:
+	AutoProgram();
 
+	bool Compile(std::istream &script);
+	void Clear();
+
+	unsigned GetSize() const { return(instructions.size()); };
+	const AutoInstruction &GetInstruction(unsigned uIndex) const { return(instructions[uIndex]); };
+	const char *GetSource(const AutoInstruction &instruction) const { return(text.c_str() + instruction.uSource); };
+	const char *GetText(const AutoInstruction &instruction) const { return(text.c_str() + instruction.uText); };
+	const std::vector<std::string> &GetErrors() const { return(errors); };
+	bool HasMode(unsigned uMode) const { return((uMode < (unsigned)AUTO_MAX_MODES) && (iModeEntry[uMode] >= 0)); };
+	bool HasModes() const;
+	unsigned GetModeEntry(unsigned uMode) const;
+	unsigned GetPathCount() const { return(paths.size()); };
+	const AutoPath &GetPath(unsigned uPath) const { return(paths[uPath]); };
+
+	static int LookupToken(const char *szToken);
+
+private:
+	std::vector<AutoInstruction> instructions;
+	std::vector<std::string> errors;
+	std::string text;						//every string the program needs, nul separated
+	std::vector<AutoPath> paths;
+	unsigned uOpenBlockLine;				//line of a PARALLEL or RACE still waiting for its JOIN
+	int iModeEntry[AUTO_MAX_MODES];			//instruction each MODE starts at, -1 if not in the script
+
+	bool CompileLine(const std::string &line, unsigned uLine);
+	bool CompileCondition(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine);
+	bool CompilePath(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine);
+	bool CompilePathFile(AutoInstruction &instruction, char **ppCurrLinePos, unsigned uLine);
+	unsigned AddText(const char *szText);
+	void AddError(unsigned uLine, const char *szError, const char *szDetail);
+};
+
+#endif  // AUTOPARSER_H
@@ -0,0 +1,214 @@
+/** \file
+ * Timeline of an autonomous run.
+ *
+ * Each record keeps when its instruction started and ended on the timer wheel clock.  Pause
+ * time is kept as a running total for the run, so a record only has to remember the total
+ * when it began; a pause that starts before an instruction and ends during it is split
+ * between them correctly without either side having to know about the other.
+ */
+
+#include "AutoProfiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TimerWheel.h"
+
+AutoProfiler::AutoProfiler()
+{
+	pthread_mutex_init(&profileMutex, NULL);
+	memset(records, 0, sizeof(records));
+	uRecords = 0;
+	uDropped = 0;
+	bOpen = false;
+	fRunStart = TimerWheel::GetTime();
+	fPaused = 0.0;
+	fPauseStart = 0.0;
+	bPaused = false;
+}
+
+AutoProfiler::~AutoProfiler()
+{
+	pthread_mutex_destroy(&profileMutex);
+}
+
+///Pause time so far this run, including a pause still going on, called with the lock held
+double AutoProfiler::GetPaused(double fNow) const
+{
+	return(fPaused + (bPaused ? fNow - fPauseStart : 0.0));
+}
+
+///Forgets the last run, a pause in progress carries over into the new one
+void AutoProfiler::Start()
+{
+	double fNow = TimerWheel::GetTime();
+
+	pthread_mutex_lock(&profileMutex);
+	uRecords = 0;
+	uDropped = 0;
+	bOpen = false;
+	fRunStart = fNow;
+	fPaused = 0.0;
+	fPauseStart = fNow;
+	pthread_mutex_unlock(&profileMutex);
+}
+
+void AutoProfiler::Begin(unsigned uInstruction)
+{
+	double fNow = TimerWheel::GetTime();
+
+	pthread_mutex_lock(&profileMutex);
+
+	if(uRecords < AUTOPROFILE_MAX_RECORDS)
+	{
+		AutoProfileRecord &record = records[uRecords++];
+
+		record.uInstruction = uInstruction;
+		record.fStart = fNow - fRunStart;
+		record.fEnd = record.fStart;
+		record.fWaiting = 0.0;
+		record.fPaused = GetPaused(fNow);	//the total so far until End() makes it a difference
+		bOpen = true;
+	}
+	else
+	{
+		uDropped++;
+		bOpen = false;
+	}
+
+	pthread_mutex_unlock(&profileMutex);
+}
+
+void AutoProfiler::End()
+{
+	double fNow = TimerWheel::GetTime();
+
+	pthread_mutex_lock(&profileMutex);
+
+	if(bOpen)
+	{
+		AutoProfileRecord &record = records[uRecords - 1];
+
+		record.fEnd = fNow - fRunStart;
+		record.fPaused = GetPaused(fNow) - record.fPaused;
+		bOpen = false;
+	}
+
+	pthread_mutex_unlock(&profileMutex);
+}
+
+///Adds to the instruction in progress
+void AutoProfiler::AddWait(double fSeconds)
+{
+	pthread_mutex_lock(&profileMutex);
+
+	if(bOpen)
+	{
+		records[uRecords - 1].fWaiting += fSeconds;
+	}
+
+	pthread_mutex_unlock(&profileMutex);
+}
+
+void AutoProfiler::Pause(bool bPause)
+{
+	double fNow = TimerWheel::GetTime();
+
+	pthread_mutex_lock(&profileMutex);
+
+	if(bPause && !bPaused)
+	{
+		fPauseStart = fNow;
+	}
+	else if(!bPause && bPaused)
+	{
+		fPaused += fNow - fPauseStart;
+	}
+
+	bPaused = bPause;
+	pthread_mutex_unlock(&profileMutex);
+}
+
+/** Writes the run as CSV, one line per instruction, and lists the slowest on the console.
+ *
+ * Running time is what is left of an instruction after its waiting and paused time, so a
+ * slow command shows up as waiting and a slow instruction in our own code as running.
+ */
+bool AutoProfiler::Report(const char *szFileName, const AutoProgram &program)
+{
+	const AutoProfileRecord *run = records;		//only the script task writes records, and it is here
+	unsigned uSlowest[AUTOPROFILE_SLOWEST];
+	unsigned uCount;
+	unsigned uDrop;
+	unsigned uRanked = 0;
+	double fTotal;
+	FILE *pFile;
+
+	pthread_mutex_lock(&profileMutex);
+	uCount = uRecords;
+	uDrop = uDropped;
+	fTotal = TimerWheel::GetTime() - fRunStart;
+	pthread_mutex_unlock(&profileMutex);
+
+	pFile = fopen(szFileName, "w");
+
+	if(pFile != NULL)
+	{
+		fprintf(pFile, "line,start,end,duration,waiting,paused,running,instruction\n");
+
+		for(unsigned i = 0; i < uCount; i++)
+		{
+			const AutoProfileRecord &record = run[i];
+			const AutoInstruction &instruction = program.GetInstruction(record.uInstruction);
+			double fDuration = record.fEnd - record.fStart;
+
+			fprintf(pFile, "%u,%0.4f,%0.4f,%0.4f,%0.4f,%0.4f,%0.4f,\"%s\"\n", instruction.uLine,
+					record.fStart, record.fEnd, fDuration, record.fWaiting, record.fPaused,
+					fDuration - record.fWaiting - record.fPaused, program.GetSource(instruction));
+		}
+
+		fclose(pFile);
+	}
+
+	// a few instructions, a simple insertion keeps the longest at the front
+
+	for(unsigned i = 0; i < uCount; i++)
+	{
+		double fDuration = run[i].fEnd - run[i].fStart - run[i].fPaused;
+		unsigned j = (uRanked < AUTOPROFILE_SLOWEST) ? uRanked++ : AUTOPROFILE_SLOWEST;
+
+		while((j > 0) && (run[uSlowest[j - 1]].fEnd - run[uSlowest[j - 1]].fStart -
+				run[uSlowest[j - 1]].fPaused < fDuration))
+		{
+			if(j < AUTOPROFILE_SLOWEST)
+			{
+				uSlowest[j] = uSlowest[j - 1];
+			}
+
+			j--;
+		}
+
+		if(j < AUTOPROFILE_SLOWEST)
+		{
+			uSlowest[j] = i;
+		}
+	}
+
+	printf("Autonomous: %u instructions in %0.3f s, profile in %s\n", uCount, fTotal, szFileName);
+
+	if(uDrop > 0)
+	{
+		printf("Autonomous: %u more instructions were not profiled\n", uDrop);
+	}
+
+	for(unsigned i = 0; i < uRanked; i++)
+	{
+		const AutoProfileRecord &record = run[uSlowest[i]];
+		const AutoInstruction &instruction = program.GetInstruction(record.uInstruction);
+
+		printf("  %0.3f s (waiting %0.3f) line %u: %s\n", record.fEnd - record.fStart - record.fPaused,
+				record.fWaiting, instruction.uLine, program.GetSource(instruction));
+	}
+
+	return(pFile != NULL);
+}
@@ -0,0 +1,56 @@
+/** \file
+ * Timeline of an autonomous run.
+ *
+ * The script task marks the start and end of every instruction it executes and JOIN adds the
+ * time it spent asleep waiting for responses.  Time spent disabled is taken from the pause
+ * notifications the component task already gets.  Recording is a few stores into a fixed
+ * table, nothing is printed or written until the run is over and Report() is called.
+ */
+
+#ifndef AUTO_PROFILER_H
+#define AUTO_PROFILER_H
+
+#include <pthread.h>
+
+#include "AutoParser.h"
+
+const unsigned AUTOPROFILE_MAX_RECORDS = 256;	//instructions kept per run, the rest are counted
+const unsigned AUTOPROFILE_SLOWEST = 5;			//instructions listed on the console after a run
+
+///What one script instruction cost, times in seconds from the start of the run
+struct AutoProfileRecord {
+	unsigned uInstruction;		//!< index into the program
+	double fStart;
+	double fEnd;
+	double fWaiting;			//!< asleep in JOIN waiting for responses
+	double fPaused;				//!< while the robot was disabled
+};
+
+class AutoProfiler
+{
+public:
+	AutoProfiler();
+	~AutoProfiler();
+
+	void Start();
+	void Begin(unsigned uInstruction);
+	void End();
+	void AddWait(double fSeconds);
+	void Pause(bool bPause);
+	bool Report(const char *szFileName, const AutoProgram &program);
+
+private:
+	pthread_mutex_t profileMutex;		//pauses come from the component task
+	AutoProfileRecord records[AUTOPROFILE_MAX_RECORDS];
+	unsigned uRecords;
+	unsigned uDropped;
+	bool bOpen;							//the last record has begun but not ended
+	double fRunStart;
+	double fPaused;						//total for the run, not counting a pause in progress
+	double fPauseStart;
+	bool bPaused;
+
+	double GetPaused(double fNow) const;
+};
+
+#endif //AUTO_PROFILER_H
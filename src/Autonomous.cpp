@@ -15,107 +15,377 @@
 #include <fstream>
 #include <string>
 #include <math.h>
+#include <time.h>
 
 //Robot
 #include "ComponentBase.h"
 #include "RobotParams.h"
 #include "AutoParser.h"
+#include "PathPlanner.h"
 
 using namespace std;
 
 extern "C" {
 }
 
+///Sends Message and waits for the component to say it is done
 bool Autonomous::CommandResponse(const char *szQueueName) {
+	bool bReturn;
+
+	if(!CommandDispatch(szQueueName))
+	{
+		return(false);
+	}
+
+	bReturn = Join(false);
+
+	if(iAutoDebugMode)
+	{
+		printf("%0.3lf Response received\n", pDebugTimer->Get());
+	}
+
+	return bReturn;
+}
+
+/** Sends Message without waiting, JOIN collects the response.
+ *
+ * If Message.params.autonomous.timeout is set the command fails when it runs longer than that.
+ */
+bool Autonomous::CommandDispatch(const char *szQueueName) {
 	int iPipeXmt;
-	bool bReturn = true;
+	AutoBranch *pBranch;
+	float fTimeout = Message.params.autonomous.timeout;
+
+	pthread_mutex_lock(&branchMutex);
+
+	if(iBranchCount >= AUTONOMOUS_MAX_BRANCHES)
+	{
+		pthread_mutex_unlock(&branchMutex);
+		SmartDashboard::PutString("Auto Status","too many branches!");
+		PRINTAUTOERROR;
+		return(false);
+	}
+
+	// register the branch and its timer before sending so a fast response cannot beat us
+
+	pBranch = &branches[iBranchCount++];
+	pBranch->uSequence = ++uNextSequence;
+	pBranch->szQueue = szQueueName;
+	pBranch->fDeadline = (fTimeout > 0.0) ? TimerWheel::GetTime() + fTimeout : 0.0;
+	pBranch->fRemaining = 0.0;
+	pBranch->uTimer = TIMER_WHEEL_NONE;
+	pBranch->iWatch = -1;
+	pBranch->bDone = false;
+	pBranch->bOk = false;
+
+	if(pBranch->fDeadline > 0.0)
+	{
+		pBranch->uTimer = TimerWheel::GetInstance()->Add(pBranch->fDeadline,
+				&Autonomous::BranchTimer, this, pBranch->uSequence);
+	}
+
+	pthread_mutex_unlock(&branchMutex);
 
 	iPipeXmt = open(szQueueName, O_WRONLY);
 	wpi_assert(iPipeXmt > 0);
 
 	Message.replyQ = AUTONOMOUS_QUEUE;
+	Message.uSequence = pBranch->uSequence;
 	write(iPipeXmt, (char*) &Message, sizeof(RobotMessage));
 	close(iPipeXmt);
+	return(true);
+}
+
+///A delay, it finishes on its own at an absolute deadline
+bool Autonomous::DelayDispatch(float fDelay) {
+	AutoBranch *pBranch;
 
-	bReceivedCommandResponse = false;
+	pthread_mutex_lock(&branchMutex);
 
-	while (!bReceivedCommandResponse)
+	if(iBranchCount >= AUTONOMOUS_MAX_BRANCHES)
 	{
-		//purposefully empty
+		pthread_mutex_unlock(&branchMutex);
+		SmartDashboard::PutString("Auto Status","too many branches!");
+		PRINTAUTOERROR;
+		return(false);
 	}
 
-	if(iAutoDebugMode)
+	pBranch = &branches[iBranchCount++];
+	pBranch->uSequence = ++uNextSequence;
+	pBranch->szQueue = NULL;
+	pBranch->fDeadline = TimerWheel::GetTime() + fDelay;
+	pBranch->fRemaining = 0.0;
+	pBranch->iWatch = -1;
+	pBranch->bDone = false;
+	pBranch->bOk = true;
+	pBranch->uTimer = TimerWheel::GetInstance()->Add(pBranch->fDeadline,
+			&Autonomous::BranchTimer, this, pBranch->uSequence);
+
+	if(pBranch->uTimer == TIMER_WHEEL_NONE)
 	{
-		printf("%0.3lf Response received\n", pDebugTimer->Get());
+		pBranch->bDone = true;
+		pBranch->bOk = false;
 	}
 
-	if (ReceivedCommand == COMMAND_AUTONOMOUS_RESPONSE_OK)
+	pthread_mutex_unlock(&branchMutex);
+	return(true);
+}
+
+/** A condition, it finishes when the sampler sees value iValue of szSensor meet it.
+ *
+ * The watch is checked on the sensor task as each sample is published, so nothing polls.
+ */
+bool Autonomous::WaitUntilDispatch(const char *szSensor, int iValue, SensorCompare compare, float fThreshold) {
+	SensorSampler *pSampler = SensorSampler::GetInstance();
+	AutoBranch *pBranch;
+
+	pthread_mutex_lock(&branchMutex);
+
+	if(iBranchCount >= AUTONOMOUS_MAX_BRANCHES)
 	{
-		SmartDashboard::PutString("Auto Status","auto ok");
-		bReturn = true;
+		pthread_mutex_unlock(&branchMutex);
+		SmartDashboard::PutString("Auto Status","too many branches!");
+		PRINTAUTOERROR;
+		return(false);
 	}
-	else if (ReceivedCommand == COMMAND_AUTONOMOUS_RESPONSE_ERROR)
+
+	pBranch = &branches[iBranchCount++];
+	pBranch->uSequence = ++uNextSequence;
+	pBranch->szQueue = NULL;
+	pBranch->fDeadline = 0.0;
+	pBranch->fRemaining = 0.0;
+	pBranch->uTimer = TIMER_WHEEL_NONE;
+	pBranch->bDone = false;
+	pBranch->bOk = true;
+
+	// the watch can fire before we let go of the branches, CompleteBranch will wait for us
+
+	pBranch->iWatch = pSampler->Watch(pSampler->Find(szSensor), iValue, compare, fThreshold,
+			&Autonomous::ConditionMet, this, pBranch->uSequence);
+
+	if(pBranch->iWatch < 0)
 	{
-		SmartDashboard::PutString("Auto Status","EARLY DEATH!");
-		PRINTAUTOERROR;
-		bReturn = false;
+		printf("Autonomous: cannot watch %s\n", szSensor);
+		pBranch->bDone = true;
+		pBranch->bOk = false;
 	}
 
-	return bReturn;
+	pthread_mutex_unlock(&branchMutex);
+	return(true);
 }
 
+bool Autonomous::WaitUntil(const char *szSensor, int iValue, SensorCompare compare, float fThreshold) {
+	if(!WaitUntilDispatch(szSensor, iValue, compare, fThreshold))
+	{
+		return(false);
+	}
+
+	return(Join(false));
+}
 
-//UNTESTED
-//USAGE: MultiCommandResponse({DRIVETRAIN_QUEUE, CONVEYOR_QUEUE}, {COMMAND_DRIVETRAIN_STRAIGHT, COMMAND_CONVEYOR_SEEK_TOTE});
-bool Autonomous::MultiCommandResponse(vector<char*> szQueueNames, vector<MessageCommand> commands) {
-	//wait for several commands at once
-	//check that queue list is as long as command list
-	if(szQueueNames.size() != commands.size())
+///Called from the component task when a response arrives
+void Autonomous::CompleteBranch(unsigned uSequence, bool bOk) {
+	pthread_mutex_lock(&branchMutex);
+
+	for(int i = 0; i < iBranchCount; i++)
 	{
-		SmartDashboard::PutString("Auto Status","MULTICOMMAND error!");
-		return false;
+		if((branches[i].uSequence == uSequence) && !branches[i].bDone)
+		{
+			TimerWheel::GetInstance()->Cancel(branches[i].uTimer);
+			branches[i].uTimer = TIMER_WHEEL_NONE;
+			branches[i].iWatch = -1;			//watches only complete by firing, and fire once
+			branches[i].bDone = true;
+			branches[i].bOk = bOk;
+			RobotClock::Signal(&branchCond);
+			break;
+		}
 	}
-	bool bReturn = true;
+
+	// responses to cancelled or timed out commands are simply dropped
+
+	pthread_mutex_unlock(&branchMutex);
+}
+
+/** Called on the timer task when a branch's deadline passes.
+ *
+ * A delay answers itself with COMMAND_AUTONOMOUS_RESPONSE_OK.  A command that ran out of time
+ * is told to cancel and answered with COMMAND_AUTONOMOUS_RESPONSE_ERROR, so timeouts arrive the
+ * same way as any other response.
+ */
+void Autonomous::ExpireBranch(unsigned uSequence) {
+	RobotMessage expired;
+	const char *szQueue = NULL;
+	bool bFound = false;
 	int iPipeXmt;
-	uResponseCount = 0;
-	//vector<int> iPipesXmt = new vector<int>();
-	//send messages to each component
-	for (unsigned int i = 0; i < szQueueNames.size(); i++)
+
+	pthread_mutex_lock(&branchMutex);
+
+	for(int i = 0; i < iBranchCount; i++)
+	{
+		if((branches[i].uSequence == uSequence) && !branches[i].bDone)
+		{
+			branches[i].uTimer = TIMER_WHEEL_NONE;
+			szQueue = branches[i].szQueue;
+			bFound = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&branchMutex);
+
+	if(!bFound)
+	{
+		return;
+	}
+
+	memset(&expired, 0, sizeof(expired));
+	expired.replyQ = AUTONOMOUS_QUEUE;
+	expired.uSequence = uSequence;
+	expired.command = COMMAND_AUTONOMOUS_RESPONSE_OK;
+
+	if(szQueue)
 	{
-		iPipeXmt = open(szQueueNames[i], O_WRONLY);
-		wpi_assert(iPipeXmt > 0);
+		printf("Autonomous: command %u timed out\n", uSequence);
 
-		Message.replyQ = AUTONOMOUS_QUEUE;
-		Message.command = commands[i];
-		write(iPipeXmt, (char*) &Message, sizeof(RobotMessage));
+		expired.command = COMMAND_AUTONOMOUS_CANCEL;
+		iPipeXmt = open(szQueue, O_WRONLY);
+		write(iPipeXmt, (char*) &expired, sizeof(RobotMessage));
 		close(iPipeXmt);
+
+		expired.command = COMMAND_AUTONOMOUS_RESPONSE_ERROR;
 	}
 
-	bReceivedCommandResponse = false;
+	iPipeXmt = open(AUTONOMOUS_QUEUE, O_WRONLY);
+	write(iPipeXmt, (char*) &expired, sizeof(RobotMessage));
+	close(iPipeXmt);
+}
+
+///Stops the branch timers when we are disabled and starts them again with the time they had left
+void Autonomous::PauseBranches(bool bPause) {
+	double fNow = TimerWheel::GetTime();
+
+	pthread_mutex_lock(&branchMutex);
 
-	while (uResponseCount < szQueueNames.size())
+	for(int i = 0; i < iBranchCount; i++)
 	{
-		while (!bReceivedCommandResponse)
+		AutoBranch &branch = branches[i];
+
+		if(branch.bDone)
 		{
-			//purposefully empty
+			continue;
 		}
 
-		if(iAutoDebugMode)
+		if(bPause && (branch.uTimer != TIMER_WHEEL_NONE))
 		{
-			printf("%0.3lf Response received\n", pDebugTimer->Get());
+			// if it already fired its response is on the way, leave it be
+
+			if(TimerWheel::GetInstance()->Cancel(branch.uTimer))
+			{
+				branch.fRemaining = branch.fDeadline - fNow;
+				branch.uTimer = TIMER_WHEEL_NONE;
+			}
 		}
+		else if(!bPause && (branch.fRemaining > 0.0))
+		{
+			branch.fDeadline = fNow + branch.fRemaining;
+			branch.fRemaining = 0.0;
+			branch.uTimer = TimerWheel::GetInstance()->Add(branch.fDeadline,
+					&Autonomous::BranchTimer, this, branch.uSequence);
+		}
+	}
+
+	pthread_mutex_unlock(&branchMutex);
+}
+
+/** Waits for every branch, or with bRace for the first one.
+ *
+ * Returns false if a branch we waited for reported an error or timed out.  Branches still
+ * running when a race is won are told to cancel and their responses are ignored.
+ */
+bool Autonomous::Join(bool bRace) {
+	const char *szCancel[AUTONOMOUS_MAX_BRANCHES];
+	unsigned uCancel[AUTONOMOUS_MAX_BRANCHES];
+	int iWatch[AUTONOMOUS_MAX_BRANCHES];
+	int iCancel = 0;
+	int iWatches = 0;
+	bool bReturn = true;
+
+	pthread_mutex_lock(&branchMutex);
+
+	while(true)
+	{
+		int iDone = 0;
 
-		if (ReceivedCommand == COMMAND_AUTONOMOUS_RESPONSE_OK)
+		bReturn = true;
+
+		for(int i = 0; i < iBranchCount; i++)
+		{
+			if(branches[i].bDone)
+			{
+				iDone++;
+				bReturn = bReturn && branches[i].bOk;
+			}
+		}
+
+		if((iDone == iBranchCount) || (bRace && (iDone > 0)))
 		{
-			SmartDashboard::PutString("Auto Status", "auto ok");
-			bReturn = true;
+			break;
 		}
-		else if (ReceivedCommand == COMMAND_AUTONOMOUS_RESPONSE_ERROR)
+
+		double fAsleep = TimerWheel::GetTime();
+
+		RobotClock::GetInstance()->WaitCondition(&branchCond, &branchMutex, CLOCK_FOREVER);
+		profiler.AddWait(TimerWheel::GetTime() - fAsleep);
+	}
+
+	for(int i = 0; i < iBranchCount; i++)
+	{
+		if(branches[i].bDone)
 		{
-			SmartDashboard::PutString("Auto Status", "EARLY DEATH!");
-			bReturn = false;
+			continue;
 		}
+
+		TimerWheel::GetInstance()->Cancel(branches[i].uTimer);
+
+		if(branches[i].iWatch >= 0)
+		{
+			iWatch[iWatches++] = branches[i].iWatch;
+		}
+
+		if(branches[i].szQueue)
+		{
+			szCancel[iCancel] = branches[i].szQueue;
+			uCancel[iCancel++] = branches[i].uSequence;
+		}
+	}
+
+	iBranchCount = 0;
+	pthread_mutex_unlock(&branchMutex);
+
+	// conditions that never came true stop being watched
+
+	for(int i = 0; i < iWatches; i++)
+	{
+		SensorSampler::GetInstance()->Unwatch(iWatch[i]);
+	}
+
+	for(int i = 0; i < iCancel; i++)
+	{
+		Message.command = COMMAND_AUTONOMOUS_CANCEL;
+		Message.uSequence = uCancel[i];
+		CommandNoResponse(szCancel[i]);
+	}
+
+	if (bReturn)
+	{
+		SmartDashboard::PutString("Auto Status","auto ok");
+	}
+	else
+	{
+		SmartDashboard::PutString("Auto Status","EARLY DEATH!");
+		PRINTAUTOERROR;
 	}
+
 	return bReturn;
 }
 
@@ -130,19 +400,12 @@ bool Autonomous::CommandNoResponse(const char *szQueueName) {
 	return (true);
 }
 
+///Waits until an absolute deadline, so the time spent getting here is not added to the delay
 void Autonomous::Delay(float delayTime)
 {
-	//breaks the delay into little bits to prevent issues in the event of disabling
-	for (double fWait = 0.0; fWait < delayTime; fWait += 0.01)
+	if(DelayDispatch(delayTime))
 	{
-		// if we are paused break the delay into pieces
-
-		while (bPauseAutoMode)
-		{
-			Wait(0.02);
-		}
-
-		Wait(0.01);
+		Join(false);
 	}
 }
 
@@ -157,14 +420,14 @@ bool Autonomous::Finish()
 	return true;
 }
 
-bool Autonomous::Begin(char *pCurrLinePos)
+bool Autonomous::Begin()
 {
 	//tell all the components who may need to know that auto is beginning
 	Message.command = COMMAND_AUTONOMOUS_RUN;
 	return (CommandNoResponse(DRIVETRAIN_QUEUE));
 }
 
-bool Autonomous::End(char *pCurrLinePos)
+bool Autonomous::End()
 {
 	//tell all the components who may need to know that auto is beginning
 	Message.command = COMMAND_AUTONOMOUS_COMPLETE;
@@ -172,9 +435,84 @@ bool Autonomous::End(char *pCurrLinePos)
 	return (true);
 }
 
-bool Autonomous::Stop(char *pCurrLinePos) {
+bool Autonomous::Stop() {
 	//tell those who need to know that the autonomous behavior is over - reset variables
 	Message.command = COMMAND_DRIVETRAIN_STOP;
 	return (CommandNoResponse(DRIVETRAIN_QUEUE));
 }
 
+/** Sends a closed loop drivetrain motion: speed, then inches, degrees or seconds, then timeout.
+ *
+ * Outside a block we wait for the drivetrain to finish, inside one JOIN does.
+ */
+bool Autonomous::Drive(MessageCommand command, const AutoInstruction &instruction) {
+	memset(&Message.params, 0, sizeof(Message.params));
+	Message.command = command;
+	Message.params.autonomous.driveSpeed = instruction.fParam[0];
+	Message.params.autonomous.timeout = instruction.fParam[2];
+
+	switch(command)
+	{
+	case COMMAND_DRIVETRAIN_DRIVE_DISTANCE:
+		Message.params.autonomous.driveDistance = instruction.fParam[1];
+		break;
+
+	case COMMAND_DRIVETRAIN_TURN_ANGLE:
+		Message.params.autonomous.turnAngle = instruction.fParam[1];
+		break;
+
+	case COMMAND_DRIVETRAIN_DRIVE_TIME:
+		Message.params.autonomous.driveTime = instruction.fParam[1];
+		break;
+
+	default:
+		break;
+	}
+
+	if(bInBlock)
+	{
+		return(CommandDispatch(DRIVETRAIN_QUEUE));
+	}
+
+	return(CommandResponse(DRIVETRAIN_QUEUE));
+}
+
+/** Has the drivetrain follow the trajectory for a PATH or TRAJECTORY.
+ *
+ * The trajectory is pinned until the drivetrain is done with it.  There is no timeout, the
+ * drivetrain gives up by itself if the robot falls too far behind.
+ */
+bool Autonomous::FollowPath(const AutoPath &path) {
+	const Trajectory *pTrajectory = PathPlanner::GetInstance()->Get(path.uKey);
+
+	if(pTrajectory == NULL)
+	{
+		SmartDashboard::PutString("Auto Status","no trajectory for PATH");
+		PRINTAUTOERROR;
+		return(false);
+	}
+
+	if(iAutoDebugMode)
+	{
+		printf("%0.3lf trajectory %016llx, %u samples, %0.2f s\n", pDebugTimer->Get(),
+				(unsigned long long)path.uKey, pTrajectory->GetSize(), pTrajectory->GetDuration());
+	}
+
+	memset(&Message.params, 0, sizeof(Message.params));
+	Message.command = COMMAND_DRIVETRAIN_FOLLOW_PATH;
+	Message.params.autonomous.trajectory = pTrajectory;
+
+	// once the message is sent the drivetrain owns the pin
+	if(!CommandDispatch(DRIVETRAIN_QUEUE))
+	{
+		PathPlanner::GetInstance()->Release(pTrajectory);
+		return(false);
+	}
+
+	if(bInBlock)
+	{
+		return(true);
+	}
+
+	return(Join(false));
+}
@@ -7,15 +7,44 @@
 
 //Robot
 #include <string>
+#include <pthread.h>
 
 #include "WPILib.h"
 
 #include "ComponentBase.h" //For the ComponentBase class
 #include "RobotParams.h" //For various robot parameters
+#include "AutoParser.h" //For the compiled script
+#include "TimerWheel.h" //For delays and command timeouts
+#include "SensorSampler.h" //For WAIT_UNTIL conditions
+#include "AutoProfiler.h" //For the timeline of each run
 
 const int AUTONOMOUS_SCRIPT_LINES = 150;
 const int AUTONOMOUS_CHECKLIST_LINES = 150;
-const char* const AUTONOMOUS_SCRIPT_FILEPATH = "/home/lvuser/RhsScript.txt";
+const char* const AUTONOMOUS_SCRIPT_DIR = ROBOT_HOME;
+const char* const AUTONOMOUS_SCRIPT_NAME = "RhsScript.txt";
+const char* const AUTONOMOUS_SCRIPT_FILEPATH = ROBOT_HOME "/RhsScript.txt";
+const float AUTONOMOUS_IDLE_WAIT = 0.02;		//seconds between checks for auto mode while idle
+const float AUTONOMOUS_POLL_WAIT = 1.0;		//seconds between loads when we cannot watch the file
+const char* const AUTONOMOUS_PROFILE_FILEPATH = ROBOT_HOME "/AutoProfile.csv";	//rewritten after every run
+
+const int AUTONOMOUS_MAX_BRANCHES = 8;		//commands and delays one PARALLEL block can wait on
+
+/** Something the script is waiting on: a command response, a delay or a condition.
+ *
+ * A delay is a timer that answers for itself.  A command with a timeout also has a timer, and
+ * if it goes off first the command is cancelled and fails as if it had answered with an error.
+ * A condition is a sampler watch that completes the branch when it fires.
+ */
+struct AutoBranch {
+	unsigned uSequence;			//!< matches the response, the timer or the watch
+	const char *szQueue;		//!< where the command went, NULL for a delay or condition
+	double fDeadline;			//!< when the timer goes off, 0 if there is none
+	double fRemaining;			//!< time left on a timer stopped by a pause
+	unsigned uTimer;			//!< TimerWheel handle while the timer is running
+	int iWatch;					//!< SensorSampler watch while the condition is pending, -1 if none
+	bool bDone;
+	bool bOk;
+};
 
 //from 2014
 const float MAX_VELOCITY_PARAM = 1.0;
@@ -41,35 +70,74 @@ public:
 	}
 
 protected:
-	bool Evaluate(std::string statement);	//Evaluates an autonomous script statement
+	bool Execute(const AutoInstruction &instruction);	//Runs one compiled script instruction
 	RobotMessage Message;
-	bool bScriptLoaded; //not yet in use
+	bool bScriptLoaded; //last load compiled without errors
 	bool bInAutoMode;
 	bool bPauseAutoMode;
 
 private:
-	std::string script[AUTONOMOUS_SCRIPT_LINES];	//Autonomous script
-	int lineNumber;
+	friend struct RobotBench;	//the benchmarks time Execute directly
+	AutoProgram programs[2];	//the compiled script we run and a spare to compile into
+	AutoProgram *pProgram;		//only changed between runs
+	AutoProgram *pSpareProgram;
+	int iScriptWatch;			//inotify descriptor, -1 if we have to poll
+	SendableChooser *pModeChooser;
+	int iModeChoices[AUTO_MAX_MODES];	//what the chooser hands back for each mode
+	bool bModeOffered[AUTO_MAX_MODES];	//the modes in the chooser on the dashboard
+	unsigned uSelectedMode;		//read while disabled so starting auto costs nothing
+	unsigned uEntryLine;		//where the running mode started
+	unsigned lineNumber;
 	int iAutoDebugMode;
 	Task *pScript;
-	bool bReceivedCommandResponse;
-	unsigned int uResponseCount;
-	MessageCommand ReceivedCommand;
+	pthread_mutex_t branchMutex;	//guards the branches, responses arrive on the component task
+	pthread_cond_t branchCond;
+	AutoBranch branches[AUTONOMOUS_MAX_BRANCHES];
+	int iBranchCount;
+	unsigned uNextSequence;
+	bool bInBlock;				//between PARALLEL or RACE and JOIN
+	bool bBlockFailed;			//something in the block could not be started, JOIN fails
+	AutoProfiler profiler;
+	bool bRaceBlock;
 
 	void Delay(float);
 	bool Start();
 	bool Finish();
-	bool Begin(char *);
-	bool End(char *);
-	bool Stop(char *);
+	bool Begin();
+	bool End();
+	bool Stop();
+	bool Drive(MessageCommand command, const AutoInstruction &instruction);
+	bool FollowPath(const AutoPath &path);
 	bool CommandResponse(const char *szQueueName);
 	bool CommandNoResponse(const char *szQueueName);
-	bool MultiCommandResponse(vector<char*> szQueueNames, vector<MessageCommand> commands);
+	bool CommandDispatch(const char *szQueueName);
+	bool DelayDispatch(float fDelay);
+	bool WaitUntil(const char *szSensor, int iValue, SensorCompare compare, float fThreshold);
+	bool WaitUntilDispatch(const char *szSensor, int iValue, SensorCompare compare, float fThreshold);
+	bool Join(bool bRace);
+	bool StopOnFailure(bool bOk);
+	void CompleteBranch(unsigned uSequence, bool bOk);
+	void ExpireBranch(unsigned uSequence);
+	void PauseBranches(bool bPause);
+	static void BranchTimer(void *pThis, unsigned uSequence)
+	{
+		((Autonomous *)pThis)->ExpireBranch(uSequence);
+	}
+	static void ConditionMet(void *pThis, unsigned uSequence, const SensorSample &)
+	{
+		((Autonomous *)pThis)->CompleteBranch(uSequence, true);
+	}
 
 	void Init();
 	void OnStateChange();
 	void Run();
 	bool LoadScriptFile();
+	void WatchScriptFile();
+	bool WaitForScriptChange(float fTimeout);
+	void RunScript();
+	void OfferModes();
+	void PlanPaths();
+	void ReadModeSelection();
 };
 
 #endif //AUTONOMOUS_BASE_H
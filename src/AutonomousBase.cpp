@@ -9,9 +9,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string.h>
+#include <sys/inotify.h>
 
 #include "ComponentBase.h"
 #include "RobotParams.h"
+#include "PathPlanner.h"
+#include "Blackboard.h"
+#include "CheckList.h"
 
 using namespace std;
 
@@ -19,26 +24,58 @@ Autonomous::Autonomous()
 : ComponentBase(AUTONOMOUS_TASKNAME, AUTONOMOUS_QUEUE, AUTONOMOUS_PRIORITY)
 {
 	lineNumber = 0;
+	bScriptLoaded = false;
+	pProgram = &programs[0];
+	pSpareProgram = &programs[1];
+	iScriptWatch = -1;
+	uSelectedMode = 0;
+	uEntryLine = 0;
+	pModeChooser = new SendableChooser();
+
+	for(int i = 0; i < AUTO_MAX_MODES; i++)
+	{
+		iModeChoices[i] = i;
+		bModeOffered[i] = false;
+	}
 	bInAutoMode = false;
 	iAutoDebugMode = 0;
-	bReceivedCommandResponse = false;
-	ReceivedCommand = COMMAND_UNKNOWN;
+	iBranchCount = 0;
+	uNextSequence = 0;
+	bInBlock = false;
+	bBlockFailed = false;
+	bRaceBlock = false;
+	bPauseAutoMode = false;
+	memset(&Message, 0, sizeof(Message));
+
+	// JOIN sleeps until a branch completes, the timer wheel keeps time for delays and timeouts
+
+	RobotClock::InitCondition(&branchCond);
+	pthread_mutex_init(&branchMutex, NULL);
 
 	pTask = new Task(AUTONOMOUS_TASKNAME, (FUNCPTR) &Autonomous::StartTask,
 		AUTONOMOUS_PRIORITY, AUTONOMOUS_STACKSIZE);
 	wpi_assert(pTask);
-	pTask->Start((int)this);
+	pTask->Start((intptr_t)this);
 
 	pScript = new Task(AUTOEXEC_TASKNAME, (FUNCPTR) &Autonomous::StartScript,
 			AUTOEXEC_PRIORITY, AUTOEXEC_STACKSIZE);
 	wpi_assert(pScript);
-	pScript->Start((int)this);
+	pScript->Start((intptr_t)this);
 }
 
 Autonomous::~Autonomous()	//Destructor
 {
+	TimerWheel::GetInstance()->CancelOwner(this);
 	delete(pTask);
 	delete(pScript);
+	delete(pModeChooser);
+	pthread_cond_destroy(&branchCond);
+	pthread_mutex_destroy(&branchMutex);
+
+	if(iScriptWatch >= 0)
+	{
+		close(iScriptWatch);
+	}
 }
 
 void Autonomous::Init()	//Initializes the autonomous component
@@ -50,19 +87,27 @@ void Autonomous::OnStateChange()	//Handles state changes
 	// to handle unexpected state changes before the auto script finishes (like in OKC last year)
 	// we will leave the script running
 
+	// delays and timeouts stand still while we are paused
+
 	if(localMessage.command == COMMAND_ROBOT_STATE_AUTONOMOUS)
 	{
 		bPauseAutoMode = false;
 		bInAutoMode = true;
 		pDebugTimer->Reset();
+		PauseBranches(false);
+		profiler.Pause(false);
 	}
 	else if(localMessage.command == COMMAND_ROBOT_STATE_TELEOPERATED)
 	{
 		bPauseAutoMode = true;
+		PauseBranches(true);
+		profiler.Pause(true);
 	}
 	else if(localMessage.command == COMMAND_ROBOT_STATE_DISABLED)
 	{
 		bPauseAutoMode = true;
+		PauseBranches(true);
+		profiler.Pause(true);
 	}
 }
 
@@ -74,18 +119,15 @@ void Autonomous::Run()
 			break;
 
 		case COMMAND_CHECKLIST_RUN:
+			CheckList::GetInstance()->RunCheckList();
 			break;
 
 		case COMMAND_AUTONOMOUS_RESPONSE_OK:
-			uResponseCount++;
-			bReceivedCommandResponse = true;
-			ReceivedCommand = COMMAND_AUTONOMOUS_RESPONSE_OK;
+			CompleteBranch(localMessage.uSequence, true);
 			break;
 
 		case COMMAND_AUTONOMOUS_RESPONSE_ERROR:
-			uResponseCount++;
-			bReceivedCommandResponse = true;
-			ReceivedCommand = COMMAND_AUTONOMOUS_RESPONSE_ERROR;
+			CompleteBranch(localMessage.uSequence, false);
 			break;
 
 		default:
@@ -93,6 +135,7 @@ void Autonomous::Run()
 	}
 }
 
+///Compiles the script into the spare program and swaps it in if it is good
 bool Autonomous::LoadScriptFile()
 {
 	bool bReturn = true;
@@ -100,19 +143,31 @@ bool Autonomous::LoadScriptFile()
 	ifstream scriptStream;
 	scriptStream.open(AUTONOMOUS_SCRIPT_FILEPATH);
 	
-	if(scriptStream.is_open())//not working
+	if(scriptStream.is_open())
 	{
-		for(int i = 0; i < AUTONOMOUS_SCRIPT_LINES; ++i)
+		// compile now so mistakes show up before autonomous, not during it
+
+		if(pSpareProgram->Compile(scriptStream))
 		{
-			if(!scriptStream.eof())
-			{
-				getline(scriptStream, script[i]);
-				//cout << script[i] << endl;
-			}
-			else
+			AutoProgram *pCompiled = pSpareProgram;
+
+			pSpareProgram = pProgram;
+			pProgram = pCompiled;
+			PlanPaths();
+		}
+		else
+		{
+			const vector<string> &errors = pSpareProgram->GetErrors();
+
+			for(unsigned i = 0; i < errors.size(); i++)
 			{
-				script[i].clear();
+				printf("%s %s\n", AUTONOMOUS_SCRIPT_FILEPATH, errors[i].c_str());
 			}
+
+			// keep running the last script that compiled, but make sure somebody notices
+
+			SmartDashboard::PutString("Auto Status", errors[0].c_str());
+			bReturn = false;
 		}
 
 		//printf("Autonomous script loaded\n");
@@ -121,76 +176,268 @@ bool Autonomous::LoadScriptFile()
 	else
 	{
 		//printf("No auto file found\n");
+		pProgram->Clear();
+		bScriptLoaded = false;
 		bReturn = false;
 	}
 
+	if(bReturn)
+	{
+		bScriptLoaded = true;
+	}
+
 	return(bReturn);
 }
 
+///Asks the kernel to tell us when the script directory changes
+void Autonomous::WatchScriptFile()
+{
+	iScriptWatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if(iScriptWatch < 0)
+	{
+		printf("Autonomous: inotify unavailable, polling %s\n", AUTONOMOUS_SCRIPT_FILEPATH);
+		return;
+	}
+
+	// watch the directory, editors and deploy tools replace the file rather than rewrite it
+
+	if(inotify_add_watch(iScriptWatch, AUTONOMOUS_SCRIPT_DIR,
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0)
+	{
+		printf("Autonomous: cannot watch %s, polling\n", AUTONOMOUS_SCRIPT_DIR);
+		close(iScriptWatch);
+		iScriptWatch = -1;
+	}
+}
+
+///Waits up to fTimeout seconds, returns true if the script file may have changed
+bool Autonomous::WaitForScriptChange(float fTimeout)
+{
+	char events[1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	bool bChanged = false;
+	ssize_t iLength;
+
+	if(iScriptWatch < 0)
+	{
+		// without inotify all we can do is look again every so often
+
+		RobotClock::Delay(bScriptLoaded ? fTimeout : AUTONOMOUS_POLL_WAIT);
+		return(!bScriptLoaded);
+	}
+
+	if(!RobotClock::GetInstance()->WaitReadable(iScriptWatch, RobotClock::GetTime() + fTimeout))
+	{
+		return(false);
+	}
+
+	while((iLength = read(iScriptWatch, events, sizeof(events))) > 0)
+	{
+		for(char *pEvent = events; pEvent < events + iLength; )
+		{
+			struct inotify_event *pNotify = (struct inotify_event *)pEvent;
+
+			if((pNotify->mask & IN_Q_OVERFLOW) ||
+					((pNotify->len > 0) && !strcmp(pNotify->name, AUTONOMOUS_SCRIPT_NAME)))
+			{
+				bChanged = true;
+			}
+
+			pEvent += sizeof(struct inotify_event) + pNotify->len;
+		}
+	}
+
+	return(bChanged);
+}
+
+///Hands every PATH in the script to the planner so the trajectories are ready before auto
+void Autonomous::PlanPaths()
+{
+	for(unsigned i = 0; i < pProgram->GetPathCount(); i++)
+	{
+		const AutoPath &path = pProgram->GetPath(i);
+
+		if(!path.fileName.empty())
+		{
+			PathPlanner::GetInstance()->RequestFile(path.fileName.c_str());
+		}
+		else
+		{
+			PathPlanner::GetInstance()->Request(&path.waypoints[0], path.waypoints.size(), path.limits);
+		}
+	}
+}
+
+///Adds any new MODE blocks in the script to the dashboard chooser
+void Autonomous::OfferModes()
+{
+	SendableChooser *pOldChooser = pModeChooser;
+	bool bFirst = true;
+	bool bChanged = false;
+	char szName[16];
+
+	for(int i = 0; i < AUTO_MAX_MODES; i++)
+	{
+		if(pProgram->HasMode(i) != bModeOffered[i])
+		{
+			bChanged = true;
+		}
+	}
+
+	if(!bChanged)
+	{
+		return;
+	}
+
+	// a chooser can only grow, so modes that left the script take a new one to get rid of
+
+	pModeChooser = new SendableChooser();
+
+	for(int i = 0; i < AUTO_MAX_MODES; i++)
+	{
+		bModeOffered[i] = pProgram->HasMode(i);
+
+		if(!bModeOffered[i])
+		{
+			continue;
+		}
+
+		snprintf(szName, sizeof(szName), "Mode %d", i);
+
+		if(bFirst)
+		{
+			pModeChooser->AddDefault(szName, &iModeChoices[i]);
+			bFirst = false;
+		}
+		else
+		{
+			pModeChooser->AddObject(szName, &iModeChoices[i]);
+		}
+	}
+
+	SmartDashboard::PutData("Auto Mode", pModeChooser);
+	delete(pOldChooser);
+}
+
+void Autonomous::ReadModeSelection()
+{
+	int *pChoice = (int *)pModeChooser->GetSelected();
+
+	if(pChoice && (*pChoice != (int)uSelectedMode))
+	{
+		uSelectedMode = *pChoice;
+		SmartDashboard::PutNumber("Selected Auto Mode", uSelectedMode);
+	}
+}
+
+void Autonomous::RunScript()
+{
+	// if there is a script we will execute it some heck or high water!
+
+	while (bInAutoMode)
+	{
+		SmartDashboard::PutNumber("Script Line Number", lineNumber);
+
+		if (!bPauseAutoMode)
+		{
+			if (lineNumber < pProgram->GetSize())
+			{
+				// handle pausing in the Execute method
+
+				const AutoInstruction &instruction = pProgram->GetInstruction(lineNumber);
+				AutoProgress progress = { true, uSelectedMode, lineNumber };
+
+				Blackboard::GetInstance()->autonomous.Write(progress);
+
+				SmartDashboard::PutString("Script Line", pProgram->GetSource(instruction));
+
+				profiler.Begin(lineNumber);
+
+				if (Execute(instruction))
+				{
+					profiler.End();
+					SmartDashboard::PutString("Script Line", "<NOT RUNNING>");
+					break;
+				}
+
+				profiler.End();
+
+				lineNumber++;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+}
+
 void Autonomous::DoScript()
 {
+	bool bReload = true;
+
 	//int loadAttemptTally = 0; //for debugging
 	SmartDashboard::PutString("Script Line", "DoScript started");
 	SmartDashboard::PutString("Auto Status", "Ready to go");
 	SmartDashboard::PutBoolean("Script File Loaded", false);
 	//printf("DoScript\n");
+
+	WatchScriptFile();
 	
 	while(true)
 	{
-		lineNumber = 0;
-		SmartDashboard::PutNumber("Script Line Number", lineNumber);
+		// the file is only read when it changes, while idle we just wait on the watch
 
-		//TODO: LoadScriptFile is called every stinking time we want to check load status! Does this eat time?
-		//We want to load the file while disabled - this allows us to load new scripts
-		if(LoadScriptFile() == false)
+		if(bReload)
 		{
-			// wait a little and try again, really only useful if when practicing
-
-			SmartDashboard::PutBoolean("Script File Loaded", false);
-			Wait(1.0);
+			LoadScriptFile();
+			SmartDashboard::PutBoolean("Script File Loaded", bScriptLoaded);
+			OfferModes();
+			ReadModeSelection();
 		}
-		else
-		{
-			SmartDashboard::PutBoolean("Script File Loaded", true);
 
-			// if there is a script we will execute it some heck or high water!
+		if(bInAutoMode && bScriptLoaded)
+		{
+			// a mode that is not in a script with modes is not run, starting at the top would be a
+			// surprise, a script without MODE lines is one routine and runs from the top
 
-			while (bInAutoMode)
+			if(pProgram->HasModes() && !pProgram->HasMode(uSelectedMode))
 			{
-				SmartDashboard::PutNumber("Script Line Number", lineNumber);
+				char szStatus[32];
 
-				if (!bPauseAutoMode)
-				{
-					if (lineNumber < AUTONOMOUS_SCRIPT_LINES)
-					{
-						// can we have empty lines?  at the end I guess
-
-						if (script[lineNumber].empty() == false)
-						{
-							// handle pausing in the Evaluate method
-
-							SmartDashboard::PutString("Script Line",
-									script[lineNumber].c_str());
-
-							if (Evaluate(script[lineNumber]))
-							{
-								SmartDashboard::PutString("Script Line", "<NOT RUNNING>");
-								break;
-							}
-						}
-
-						lineNumber++;
-					}
-					else
-					{
-						break;
-					}
-				}
+				snprintf(szStatus, sizeof(szStatus), "no MODE %u in script", uSelectedMode);
+				printf("Autonomous: %s, not running\n", szStatus);
+				SmartDashboard::PutString("Auto Status", szStatus);
+				bInAutoMode = false;
+				bReload = WaitForScriptChange(AUTONOMOUS_IDLE_WAIT);
+				continue;
 			}
 
+			// every mode was compiled and indexed at load time, starting one is just a lookup
+
+			lineNumber = pProgram->GetModeEntry(uSelectedMode);
+			uEntryLine = lineNumber;
+			bInBlock = false;
+			bBlockFailed = false;
+			SmartDashboard::PutNumber("Script Line Number", lineNumber);
+
+			profiler.Start();
+			RunScript();
+
+			// the run is over, now it is safe to spend time on the report
+			profiler.Report(AUTONOMOUS_PROFILE_FILEPATH, *pProgram);
 			bInAutoMode = false;
-			Wait(0.1);
+
+			AutoProgress progress = { false, uSelectedMode, lineNumber };
+
+			Blackboard::GetInstance()->autonomous.Write(progress);
 		}
+		else
+		{
+			ReadModeSelection();
+		}
+
+		bReload = WaitForScriptChange(AUTONOMOUS_IDLE_WAIT);
 	}
 
 	bInAutoMode = false;
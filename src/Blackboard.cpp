@@ -0,0 +1,17 @@
+/** \file
+ * Latest value of the robot state that more than one task wants to know.
+ */
+
+#include "Blackboard.h"
+
+/** The one blackboard.
+ *
+ * It is a static rather than made with new, which only promises the slots their cache line
+ * alignment from C++17 on.  The compiler makes sure only the first caller constructs it.
+ */
+Blackboard *Blackboard::GetInstance()
+{
+	static Blackboard blackboard;
+
+	return(&blackboard);
+}
@@ -0,0 +1,96 @@
+/** \file
+ * Latest value of the robot state that more than one task wants to know.
+ *
+ * Each slot is a Snapshot with exactly one owner, the task that writes it, and can be read
+ * from any task without locking or sending a message.  The first Write() claims a slot for the
+ * task that made it and a write from any other task is printed and dropped.  Slots are aligned
+ * to their own cache lines so a busy writer does not slow down the readers of its neighbours.
+ *
+ *	slot		owner						value
+ *	estimate	sensor task, StateEstimator	heading, rates and velocity
+ *	pose		sensor task, KiwiOdometry	where the robot is on the field
+ *	motors		Drivetrain					power last sent to each drive motor
+ *	mode		main loop, RhsRobotBase		disabled, autonomous, teleop or test
+ *	autonomous	script task, Autonomous		mode and line of the script being run
+ */
+
+#ifndef BLACKBOARD_H
+#define BLACKBOARD_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "KiwiOdometry.h"
+#include "RhsRobotBase.h"
+#include "Snapshot.h"
+#include "StateEstimator.h"
+
+const unsigned BLACKBOARD_CACHE_LINE = 64;		//bytes, for ARM Cortex-A9 and x86 alike
+
+///Power each drive motor was last set to, as sent to the CANTalon
+struct DriveMotors {
+	float left;
+	float right;
+	float bottom;
+};
+
+///What the autonomous script is doing
+struct AutoProgress {
+	bool bRunning;
+	unsigned uMode;				//!< the MODE being run
+	unsigned uLine;				//!< instruction being executed, counting from 0
+};
+
+template <typename T>
+class alignas(BLACKBOARD_CACHE_LINE) BlackboardSlot
+{
+public:
+	BlackboardSlot() { bOwned = false; };
+
+	///Only the task that first wrote the slot may write it again
+	void Write(const T &newValue)
+	{
+		if(!bOwned)
+		{
+			owner = pthread_self();
+			bOwned = true;
+		}
+
+		// checked in every build, a second writer would tear what the readers see
+		if(!pthread_equal(owner, pthread_self()))
+		{
+			printf("Blackboard: write from a task that does not own the slot, ignored\n");
+			return;
+		}
+
+		snapshot.Write(newValue);
+	}
+
+	///Returns false if nothing has been written yet
+	bool Read(T &copy) const { return(snapshot.Read(copy)); };
+
+	///Changes every time a new value is written
+	unsigned GetSequence() const { return(snapshot.GetSequence()); };
+
+private:
+	Snapshot<T> snapshot;
+	pthread_t owner;			//only the owner reads these two
+	bool bOwned;
+};
+
+class Blackboard
+{
+public:
+	static Blackboard *GetInstance();
+
+	BlackboardSlot<StateEstimate> estimate;
+	BlackboardSlot<RobotPose> pose;
+	BlackboardSlot<DriveMotors> motors;
+	BlackboardSlot<RobotOpMode> mode;
+	BlackboardSlot<AutoProgress> autonomous;
+
+private:
+	Blackboard() {};
+};
+
+#endif //BLACKBOARD_H
@@ -1,20 +1,341 @@
 /** \file
  * The CheckList class runs a prematch checklist
+ *
+ * An entry is idle, queued for a worker or running.  Only the worker that marked an entry
+ * running calls its check, and it does so without holding the lock, so one slow check never
+ * holds up the others.  A check that overruns the budget is reported as timed out right away;
+ * whatever it says when it does come back is thrown away and it is not queued again until then.
  */
 
-//Local
 #include "CheckList.h"
-#include "ComponentBase.h"			//For the ComponentBase class
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RobotClock.h"
 #include "RobotParams.h"
-class RhsRobot;			//For the pointer to the RhsRobot object
 
-//WPILib
-#include "WPILib.h"
+CheckList *CheckList::pInstance = NULL;
+
+CheckList *CheckList::GetInstance()
+{
+	if(pInstance == NULL)
+	{
+		pInstance = new CheckList();
+	}
+
+	return(pInstance);
+}
+
+CheckList::CheckList()
+{
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		checks[i].szName = NULL;
+		checks[i].state = CHECK_IDLE;
+		checks[i].result.status = CHECK_NOT_RUN;
+		checks[i].result.fTime = 0.0;
+		checks[i].result.szDetail[0] = '\0';
+	}
+
+	fDeadline = 0.0;
+	bRequested = false;
+	pthread_mutex_init(&checkMutex, NULL);
+	RobotClock::InitCondition(&checkCond);
+
+	for(int i = 0; i < CHECKLIST_WORKERS; i++)
+	{
+		pWorkers[i] = new Task(CHECKWORKER_TASKNAME, (FUNCPTR) &CheckList::StartWorker,
+				CHECKLIST_PRIORITY, CHECKLIST_STACKSIZE);
+		wpi_assert(pWorkers[i]);
+		pWorkers[i]->Start((intptr_t)this);
+	}
+
+	pTask = new Task(CHECKLIST_TASKNAME, (FUNCPTR) &CheckList::StartTask,
+			CHECKLIST_PRIORITY, CHECKLIST_STACKSIZE);
+	wpi_assert(pTask);
+	pTask->Start((intptr_t)this);
+}
+
+CheckList::~CheckList()
+{
+	delete(pTask);
+
+	for(int i = 0; i < CHECKLIST_WORKERS; i++)
+	{
+		delete(pWorkers[i]);
+	}
+
+	pthread_cond_destroy(&checkCond);
+	pthread_mutex_destroy(&checkMutex);
+}
+
+///Adds a check to every run from now on, returns its id or -1 if there is no room
+int CheckList::Register(const char *szName, CheckFunc pCheck, void *pThis, CheckPhase phase)
+{
+	wpi_assert(pCheck && (phase < CHECK_PHASES));
+
+	pthread_mutex_lock(&checkMutex);
+
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		if(checks[i].szName == NULL)
+		{
+			checks[i].szName = szName;
+			checks[i].pCheck = pCheck;
+			checks[i].pThis = pThis;
+			checks[i].phase = phase;
+			checks[i].state = CHECK_IDLE;
+			checks[i].result.status = CHECK_NOT_RUN;
+			checks[i].result.szDetail[0] = '\0';
+			pthread_mutex_unlock(&checkMutex);
+			return(i);
+		}
+	}
+
+	pthread_mutex_unlock(&checkMutex);
+	printf("CheckList: no room for %s\n", szName);
+	return(-1);
+}
+
+///Drops a check, waiting for it to finish if it is running so pThis can be deleted after
+void CheckList::Unregister(int iCheck)
+{
+	if((iCheck < 0) || (iCheck >= CHECKLIST_MAX_CHECKS))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&checkMutex);
+
+	while(checks[iCheck].state == CHECK_RUNNING)
+	{
+		RobotClock::GetInstance()->WaitCondition(&checkCond, &checkMutex, CLOCK_FOREVER);
+	}
+
+	checks[iCheck].szName = NULL;
+	checks[iCheck].state = CHECK_IDLE;
+	pthread_mutex_unlock(&checkMutex);
+}
+
+///Starts a run on the checklist task and returns right away, safe from any task
+void CheckList::RunCheckList()
+{
+	pthread_mutex_lock(&checkMutex);
+	bRequested = true;
+	RobotClock::Broadcast(&checkCond);
+	pthread_mutex_unlock(&checkMutex);
+}
+
+///The latest result of a check, false if there is no such check
+bool CheckList::GetResult(int iCheck, CheckResult &result)
+{
+	bool bFound = false;
+
+	pthread_mutex_lock(&checkMutex);
+
+	if((iCheck >= 0) && (iCheck < CHECKLIST_MAX_CHECKS) && (checks[iCheck].szName != NULL))
+	{
+		result = checks[iCheck].result;
+		bFound = true;
+	}
+
+	pthread_mutex_unlock(&checkMutex);
+	return(bFound);
+}
+
+///True once a check should give up, the run is out of time or the robot left test mode
+bool CheckList::Expired(double fDeadline)
+{
+	return((RobotClock::GetTime() >= fDeadline) || !ISENABLED || !ISTEST);
+}
+
+void CheckList::DoChecks()
+{
+	double fStart;
+
+	pthread_mutex_lock(&checkMutex);
+
+	while(true)
+	{
+		while(!bRequested)
+		{
+			RobotClock::GetInstance()->WaitCondition(&checkCond, &checkMutex, CLOCK_FOREVER);
+		}
+
+		bRequested = false;
+
+		// motors only turn when enabled and only test mode leaves them to us
+
+		if(!ISENABLED || !ISTEST)
+		{
+			printf("CheckList: the robot has to be enabled in test mode\n");
+			SmartDashboard::PutString("Checklist", "enable in test mode to run");
+			continue;
+		}
+
+		fStart = RobotClock::GetTime();
+		fDeadline = fStart + CHECKLIST_BUDGET;
+
+		for(int phase = 0; phase < CHECK_PHASES; phase++)
+		{
+			RunPhase((CheckPhase)phase);
+		}
+
+		Report(fStart);
+	}
+}
+
+///Queues the checks in a phase and waits for them, called with the lock held
+void CheckList::RunPhase(CheckPhase phase)
+{
+	double fNow = RobotClock::GetTime();
+	bool bWaiting = false;
+
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		CheckEntry &check = checks[i];
+
+		// a check still running from a run that timed out is left to finish
+
+		if((check.szName == NULL) || (check.phase != phase) || (check.state != CHECK_IDLE))
+		{
+			continue;
+		}
+
+		if((check.result.status == CHECK_PASSED) && (fNow - check.result.fTime < CHECKLIST_CACHE_TIME))
+		{
+			continue;
+		}
+
+		check.state = CHECK_QUEUED;
+		check.result.status = CHECK_PENDING;
+		bWaiting = true;
+	}
+
+	RobotClock::Broadcast(&checkCond);
+
+	while(bWaiting && (RobotClock::GetTime() < fDeadline))
+	{
+		RobotClock::GetInstance()->WaitCondition(&checkCond, &checkMutex, fDeadline);
+		bWaiting = false;
+
+		for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+		{
+			if((checks[i].szName != NULL) && (checks[i].phase == phase) &&
+					(checks[i].result.status == CHECK_PENDING))
+			{
+				bWaiting = true;
+			}
+		}
+	}
+
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		CheckEntry &check = checks[i];
+
+		if((check.szName != NULL) && (check.phase == phase) && (check.result.status == CHECK_PENDING))
+		{
+			snprintf(check.result.szDetail, CHECKLIST_DETAIL_SIZE, "%s",
+					(check.state == CHECK_QUEUED) ? "never started" : "still running");
+			check.result.status = CHECK_TIMED_OUT;
+			check.result.fTime = RobotClock::GetTime();
+
+			if(check.state == CHECK_QUEUED)
+			{
+				check.state = CHECK_IDLE;
+			}
+		}
+	}
+}
+
+void CheckList::DoWorker()
+{
+	CheckFunc pCheck;
+	void *pThis;
+	double fCheckDeadline;
+	char szDetail[CHECKLIST_DETAIL_SIZE];
+	bool bPassed;
+	int iCheck;
+
+	pthread_mutex_lock(&checkMutex);
+
+	while(true)
+	{
+		iCheck = -1;
+
+		for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+		{
+			if((checks[i].szName != NULL) && (checks[i].state == CHECK_QUEUED))
+			{
+				iCheck = i;
+				break;
+			}
+		}
+
+		if(iCheck < 0)
+		{
+			RobotClock::GetInstance()->WaitCondition(&checkCond, &checkMutex, CLOCK_FOREVER);
+			continue;
+		}
+
+		checks[iCheck].state = CHECK_RUNNING;
+		pCheck = checks[iCheck].pCheck;
+		pThis = checks[iCheck].pThis;
+		fCheckDeadline = fDeadline;
+		pthread_mutex_unlock(&checkMutex);
+
+		szDetail[0] = '\0';
+		bPassed = pCheck(pThis, fCheckDeadline, szDetail);
+
+		pthread_mutex_lock(&checkMutex);
+
+		// too late counts for nothing, the run already reported it as timed out
+
+		if(checks[iCheck].result.status == CHECK_PENDING)
+		{
+			checks[iCheck].result.status = bPassed ? CHECK_PASSED : CHECK_FAILED;
+			checks[iCheck].result.fTime = RobotClock::GetTime();
+			memcpy(checks[iCheck].result.szDetail, szDetail, CHECKLIST_DETAIL_SIZE);
+			checks[iCheck].result.szDetail[CHECKLIST_DETAIL_SIZE - 1] = '\0';
+		}
+
+		checks[iCheck].state = CHECK_IDLE;
+		RobotClock::Broadcast(&checkCond);
+	}
+}
+
+///One summary of every check, called with the lock held
+void CheckList::Report(double fStart)
+{
+	const char *szStatus[] = { "-", "?", "PASS", "FAIL", "TIMEOUT" };
+	char szSummary[64];
+	int iChecks = 0;
+	int iPassed = 0;
+
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		if(checks[i].szName != NULL)
+		{
+			iChecks++;
+			iPassed += (checks[i].result.status == CHECK_PASSED) ? 1 : 0;
+		}
+	}
 
-CheckList::CheckList(RhsRobot* robot){
-};
+	printf("CheckList: %d of %d passed in %0.2f s\n", iPassed, iChecks, RobotClock::GetTime() - fStart);
 
-CheckList::~CheckList(){
-};
+	for(int i = 0; i < CHECKLIST_MAX_CHECKS; i++)
+	{
+		const CheckResult &result = checks[i].result;
 
+		if(checks[i].szName != NULL)
+		{
+			printf("  %-8s%-20s%s%s\n", szStatus[result.status], checks[i].szName, result.szDetail,
+					(result.fTime < fStart) ? " (earlier run)" : "");
+		}
+	}
 
+	snprintf(szSummary, sizeof(szSummary), "%d of %d passed", iPassed, iChecks);
+	SmartDashboard::PutString("Checklist", szSummary);
+	SmartDashboard::PutBoolean("Checklist Passed", iPassed == iChecks);
+}
@@ -1,27 +1,118 @@
 /** \file
  * The CheckList class runs a prematch checklist
+ *
+ * Components register the checks a pit crew would otherwise walk through by hand: is every
+ * CAN device on the bus, does each motor draw current when pulsed, is the gyro quiet and is
+ * its SPI link clean.  A run starts when the robot is enabled in test mode or when
+ * COMMAND_CHECKLIST_RUN comes in.  The checks are handed to a few worker tasks so they run at
+ * the same time, first the ones that need the robot sitting still and then the ones that move
+ * it, all inside CHECKLIST_BUDGET.  A check still going when the budget runs out is reported
+ * as timed out.  Results are kept, a check that passed less than CHECKLIST_CACHE_TIME ago is
+ * not run again, and every run ends with one summary on the console and the dashboard.
  */
 
 #ifndef CHECKLIST_H
 #define CHECKLIST_H
 
-//Robot
-#include "ComponentBase.h"
-#include "Drivetrain.h"
-class RhsRobot;
+#include <pthread.h>
 
 //WPILib
 #include <WPILib.h>
 
+const int CHECKLIST_MAX_CHECKS = 16;
+const int CHECKLIST_WORKERS = 4;				//checks that can run at once
+const double CHECKLIST_BUDGET = 5.0;			//seconds for a whole run
+const double CHECKLIST_CACHE_TIME = 300.0;		//seconds a pass is good for
+const unsigned CHECKLIST_DETAIL_SIZE = 64;			//fits the longest detail a check writes
+
+///Checks in the same phase run together, the phases one after the other
+typedef enum CheckPhase
+{
+	CHECK_STILL,			//!< needs the robot not moving, gyro noise for example
+	CHECK_MOVES,			//!< moves the robot, a motor pulse for example
+	CHECK_PHASES
+} CheckPhase;
+
+typedef enum CheckStatus
+{
+	CHECK_NOT_RUN,
+	CHECK_PENDING,			//!< queued or running in this run
+	CHECK_PASSED,
+	CHECK_FAILED,
+	CHECK_TIMED_OUT
+} CheckStatus;
+
+struct CheckResult {
+	CheckStatus status;
+	double fTime;							//!< robot clock when it finished
+	char szDetail[CHECKLIST_DETAIL_SIZE];	//!< what was measured, for the summary
+};
+
+/** Runs one check from a worker task and returns true if it passed.
+ *
+ * Poll CheckList::Expired(fDeadline) while waiting and give up when it says so, the robot may
+ * have been disabled.  Whatever was measured goes in szDetail.
+ */
+typedef bool (*CheckFunc)(void *pThis, double fDeadline, char *szDetail);
+
 class CheckList
-{	
+{
 public:
-	CheckList(RhsRobot* robot);
-	~CheckList();
+	static CheckList *GetInstance();
+
+	int Register(const char *szName, CheckFunc pCheck, void *pThis, CheckPhase phase);
+	void Unregister(int iCheck);
 	void RunCheckList();
+	bool GetResult(int iCheck, CheckResult &result);
+
+	static bool Expired(double fDeadline);
+
+	static void *StartTask(void *pThis)
+	{
+		((CheckList *)pThis)->DoChecks();
+		return(NULL);
+	}
+
+	static void *StartWorker(void *pThis)
+	{
+		((CheckList *)pThis)->DoWorker();
+		return(NULL);
+	}
+
+private:
+	typedef enum CheckState
+	{
+		CHECK_IDLE,
+		CHECK_QUEUED,
+		CHECK_RUNNING
+	} CheckState;
+
+	struct CheckEntry {
+		const char *szName;				//NULL when the entry is free
+		CheckFunc pCheck;
+		void *pThis;
+		CheckPhase phase;
+		CheckState state;
+		CheckResult result;
+	};
+
+	static CheckList *pInstance;
+
+	Task *pTask;
+	Task *pWorkers[CHECKLIST_WORKERS];
+	pthread_mutex_t checkMutex;
+	pthread_cond_t checkCond;
+	CheckEntry checks[CHECKLIST_MAX_CHECKS];
+	double fDeadline;				//robot clock, when the run in progress has to be done
+	bool bRequested;
+
+	CheckList();
+	~CheckList();
 
-private:	
-	RobotMessage localMessage;
+	void DoChecks();
+	void DoWorker();
+	void RunPhase(CheckPhase phase);
+	void Report(double fStart);
 };
 
 #endif
@@ -22,7 +22,7 @@ Component::Component()
 	pTask = new Task(COMPONENT_TASKNAME, (FUNCPTR) &Component::StartTask,
 			COMPONENT_PRIORITY, COMPONENT_STACKSIZE);
 	wpi_assert(pTask);
-	pTask->Start((int)this);
+	pTask->Start((intptr_t)this);
 };
 
 Component::~Component()
@@ -12,7 +12,6 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <sys/select.h>
 #include <sys/types.h>
 
 //Local
@@ -21,27 +20,36 @@
 class RhsRobot;
 #include "RobotMessage.h"
 
+const double COMPONENT_MESSAGE_WAIT = 0.04;
+
 ComponentBase::ComponentBase(const char* componentName, const char *queueName, int priority)
 {	
 	iLoop = 0;
 	iPipeRcv = -1;
 	iPipeXmt = -1;
 	pTask = NULL;
+	fControlPeriod = 0.0;
+	fNextControl = 0.0;
 
-	pRemoteUpdateTimer = new Timer();
+	pRemoteUpdateTimer = new RobotTimer();
 	pRemoteUpdateTimer->Start();
 
-	pAutoTimer = new Timer();
+	pAutoTimer = new RobotTimer();
 	pAutoTimer->Start();
 
-	pDebugTimer = new Timer();
+	pDebugTimer = new RobotTimer();
 	pDebugTimer->Start();
 
-	pSafetyTimer = new Timer();
+	pSafetyTimer = new RobotTimer();
 	pSafetyTimer->Start();
 
 	mkfifo(queueName, 0666);
 	queueLocal = queueName;
+
+	// open our end right away, until it is open a sender blocks in open() and not on the clock
+
+	iPipeRcv = open(queueName, O_RDONLY | O_NONBLOCK);
+	fcntl(iPipeRcv, F_SETFL, 0);
 }
 
 void ComponentBase::SendMessage(RobotMessage* robotMessage)
@@ -60,8 +68,8 @@ void ComponentBase::SendMessage(RobotMessage* robotMessage)
 
 void ComponentBase::ReceiveMessage()			//Receives a message and copies it into localMessage
 {
-	fd_set selectSet;
-	struct timeval timeout;
+	RobotClock *pClock = RobotClock::GetInstance();
+	double fDeadline;
 
 	if(iPipeRcv < 0)
 	{
@@ -69,13 +77,16 @@ void ComponentBase::ReceiveMessage()			//Receives a message and copies it into l
 		assert(iPipeRcv > 0);
 	}
 
-	FD_ZERO(&selectSet);
-	FD_SET(iPipeRcv, &selectSet);
+	fDeadline = pClock->Now() + COMPONENT_MESSAGE_WAIT;
 
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 40000;
+	// never sleep through the next control period
 
-	if(select(iPipeRcv + 1, &selectSet, NULL, NULL, &timeout) == 0)
+	if((fControlPeriod > 0.0) && (fNextControl < fDeadline))
+	{
+		fDeadline = fNextControl;
+	}
+
+	if(!pClock->WaitReadable(iPipeRcv, fDeadline))
 	{
 		localMessage.command = COMMAND_SYSTEM_MSGTIMEOUT;
 	}
@@ -121,6 +132,24 @@ void ComponentBase::DoWork()
 		}
 
 		Run();			//Component logic
+
+		// closed loops run on a fixed period no matter how many messages arrive
+
+		if(fControlPeriod > 0.0)
+		{
+			double fNow = RobotClock::GetTime();
+
+			if(fNow >= fNextControl)
+			{
+				Control();
+				fNextControl += fControlPeriod;
+
+				if(fNow - fNextControl > fControlPeriod)
+				{
+					fNextControl = fNow + fControlPeriod;
+				}
+			}
+		}
 		//
 		//if(ISAUTO) { AutoBehavior(); } //TODO should we add AutoBehavior?
 		//AutoBehavior is where the actual auto stuff is called - it should be periodic rather than stop up the thread
@@ -135,13 +164,26 @@ void ComponentBase::DoWork()
 	}
 }
 void ComponentBase::SendCommandResponse(MessageCommand command)
+{
+	SendCommandResponse(command, localMessage);
+}
+
+void ComponentBase::SendCommandResponse(MessageCommand command, const RobotMessage &request)
 {
 	RobotMessage replyMessage;
 		replyMessage.command = command;
+		replyMessage.uSequence = request.uSequence;
 		//Send a message back to auto to tell it that code is done.
-		int iPipeXmt = open(localMessage.replyQ, O_WRONLY);
+		int iPipeXmt = open(request.replyQ, O_WRONLY);
 		assert(iPipeXmt > 0);
 
 		write(iPipeXmt, (char*) &replyMessage, sizeof(RobotMessage));
 		close(iPipeXmt);
 }
+
+///Starts calling Control() every fSeconds, 0 stops it
+void ComponentBase::SetControlPeriod(float fSeconds)
+{
+	fControlPeriod = fSeconds;
+	fNextControl = RobotClock::GetTime() + fSeconds;
+}
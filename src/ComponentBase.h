@@ -25,6 +25,7 @@ using namespace std;
 
 //Robot
 #include "RobotMessage.h"			//For the RobotMessage struct
+#include "RobotClock.h"			//For the timers
 
 class ComponentBase
 {
@@ -40,10 +41,10 @@ public:
 	int GetLoop() { return(iLoop); };
 
 protected:
-	Timer *pSafetyTimer;
-	Timer *pAutoTimer;
-	Timer *pDebugTimer;
-	Timer *pRemoteUpdateTimer;
+	RobotTimer *pSafetyTimer;
+	RobotTimer *pAutoTimer;
+	RobotTimer *pDebugTimer;
+	RobotTimer *pRemoteUpdateTimer;
 	Task *pTask;
 	RobotMessage localMessage;
 	MessageCommand lastCommand;//used to detect changes in commands sent
@@ -51,14 +52,21 @@ protected:
 
 	virtual void OnStateChange() = 0;
 	virtual void Run() = 0;
+	///called every control period once SetControlPeriod() has been called
+	virtual void Control() {};
 	//virtual void AutoBehavior() = 0;
 	//virtual void SmartDashboardUpdate() = 0;
 
 	///used to send a message back to autonomous or whatever to notify completion of a function
 	void SendCommandResponse(MessageCommand);
+	///the same for a request we kept, when the function finishes long after it was asked for
+	void SendCommandResponse(MessageCommand, const RobotMessage &request);
+	void SetControlPeriod(float fSeconds);
 
 private:
 	const float fUpdateDelay = .15;
+	double fControlPeriod;		//seconds, 0 if the component has no control loop
+	double fNextControl;		//robot clock time the next Control() is due
 	char* componentName;
 	string queueLocal;
 	int iPipeRcv;
@@ -18,6 +18,7 @@
 
 #include <math.h>
 #include <assert.h>
+#include <string.h>
 
 #include <string>
 #include <iostream>
@@ -25,6 +26,9 @@
 
 #include "ComponentBase.h"
 #include "RobotParams.h"
+#include "PathPlanner.h"
+#include "LatencyProbe.h"
+#include "Blackboard.h"
 using namespace std;
 
 Drivetrain::Drivetrain() :
@@ -43,6 +47,12 @@ Drivetrain::Drivetrain() :
 	leftMotor->SetVoltageRampRate(120.0);
 	rightMotor->SetVoltageRampRate(120.0);
 	bottomMotor->SetVoltageRampRate(120.0);
+	leftMotor->SetFeedbackDevice(CANTalon::QuadEncoder);
+	rightMotor->SetFeedbackDevice(CANTalon::QuadEncoder);
+	bottomMotor->SetFeedbackDevice(CANTalon::QuadEncoder);
+	leftMotor->ConfigEncoderCodesPerRev(DRIVETRAIN_ENCODER_CPR);
+	rightMotor->ConfigEncoderCodesPerRev(DRIVETRAIN_ENCODER_CPR);
+	bottomMotor->ConfigEncoderCodesPerRev(DRIVETRAIN_ENCODER_CPR);
 	//leftMotor->SetSafetyEnabled(true);
 	//rightMotor->SetSafetyEnabled(true);
 	//bottomMotor->SetSafetyEnabled(true);
@@ -56,71 +66,275 @@ Drivetrain::Drivetrain() :
 	wpi_assert(gyro);
 	gyro->Start();
 
+	iAccelSensor = SensorSampler::GetInstance()->Register("BuiltInAccelerometer",
+			&Drivetrain::SampleAccelerometer, this, ACCEL_SAMPLE_RATE);
+	iCurrentSensor = SensorSampler::GetInstance()->Register("DriveCurrent",
+			&Drivetrain::SampleCurrent, this, DRIVE_CURRENT_RATE);
+
+	// everything that steers reads the estimate rather than the raw sensors
+
+	estimator = new StateEstimator(gyro, iAccelSensor, leftMotor, rightMotor, bottomMotor);
+	wpi_assert(estimator);
+
+	odometry = new KiwiOdometry(estimator, leftMotor, rightMotor, bottomMotor);
+	wpi_assert(odometry);
+
+	// the checks that only need the robot sitting still go first, then the motor pulses
+
+	CheckList *checklist = CheckList::GetInstance();
+
+	iChecks[0] = checklist->Register("Gyro noise", &Drivetrain::CheckGyroNoise, this, CHECK_STILL);
+	iChecks[1] = checklist->Register("Gyro SPI", &Drivetrain::CheckGyroSPI, gyro, CHECK_STILL);
+	iChecks[2] = checklist->Register("Left Talon", &Drivetrain::CheckMotor, leftMotor, CHECK_MOVES);
+	iChecks[3] = checklist->Register("Right Talon", &Drivetrain::CheckMotor, rightMotor, CHECK_MOVES);
+	iChecks[4] = checklist->Register("Bottom Talon", &Drivetrain::CheckMotor, bottomMotor, CHECK_MOVES);
+
+	memset(&motionRequest, 0, sizeof(motionRequest));
+	memset(&motionStart, 0, sizeof(motionStart));
+	SetControlPeriod(1.0 / DRIVETRAIN_CONTROL_RATE);
+
 	pTask = new Task(DRIVETRAIN_TASKNAME, (FUNCPTR) &Drivetrain::StartTask,
 			DRIVETRAIN_PRIORITY, DRIVETRAIN_STACKSIZE);
 	wpi_assert(pTask);
-	pTask->Start((int) this);
+	pTask->Start((intptr_t) this);
 }
 
 Drivetrain::~Drivetrain()			//Destructor
 {
+	for(int i = 0; i < DRIVETRAIN_CHECKS; i++) {
+		CheckList::GetInstance()->Unregister(iChecks[i]);
+	}
+
+	SensorSampler::GetInstance()->Enable(iAccelSensor, false);
+	SensorSampler::GetInstance()->Enable(iCurrentSensor, false);
+	gyro->Stop();
+	delete odometry;
+	delete estimator;
 	delete (pTask);
 	delete leftMotor;
 	delete rightMotor;
 	delete bottomMotor;
 	delete gyro;
-	//delete encoder;
 }
 
 void Drivetrain::OnStateChange()			//Handles state changes
 {
+	bDriving = (localMessage.command == COMMAND_ROBOT_STATE_TELEOPERATED);
+
+	// Control() drives these every tick, so nothing from before the change may be left in them
+	fDriveX = 0.0f;
+	fDriveY = 0.0f;
+	fDriveR = 0.0f;
+
 	switch(localMessage.command) {
 	case COMMAND_ROBOT_STATE_AUTONOMOUS:
 		//restore motor values
 		leftMotor->Set(left);
 		rightMotor->Set(right);
 		bottomMotor->Set(bottom);
+
+		StopTeaching();
+
+		// a motion paused by a disable picks up where it left off, heading and all
+		if(bMotionPaused) {
+			PauseMotion(false);
+			break;
+		}
+
 		targetRot = 0;
-		gyro->Zero();
-		//encoder->Reset();
+		ZeroHeading();
+		odometry->Reset();
 		//gyro should be reset by a message from autonomous
 		break;
 
 	case COMMAND_ROBOT_STATE_TEST:
+		StopTeaching();
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		leftMotor->Set(0.0);
 		rightMotor->Set(0.0);
 		break;
 
 	case COMMAND_ROBOT_STATE_TELEOPERATED:
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		leftMotor->Set(0.0);
 		rightMotor->Set(0.0);
-		gyro->Zero();
+		ZeroHeading();
 		targetRot = 0;
+
+		// the sticks may already be pushed, start from where they are now
+		fDriveX = InputAxis(ACTION_DRIVE_X, fInputAxes);
+		fDriveY = InputAxis(ACTION_DRIVE_Y, fInputAxes);
+		fDriveR = InputAxis(ACTION_DRIVE_ROTATE, fInputAxes);
 		break;
 
 	case COMMAND_ROBOT_STATE_DISABLED:
+		StopTeaching();
 		leftMotor->Set(0.0);
 		rightMotor->Set(0.0);
-		gyro->Zero();
+
+		// keep the heading, autonomous may resume the motion
+		if(motion != DRIVETRAIN_MOTION_NONE) {
+			PauseMotion(true);
+			break;
+		}
+
+		ZeroHeading();
 		targetRot = 0;
 		break;
 
 	case COMMAND_ROBOT_STATE_UNKNOWN:
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		leftMotor->Set(0.0);
 		rightMotor->Set(0.0);
-		gyro->Zero();
+		ZeroHeading();
 		targetRot = 0;
 		break;
 
 	default:
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		leftMotor->Set(0.0);
 		rightMotor->Set(0.0);
-		gyro->Zero();
+		ZeroHeading();
 		targetRot = 0;
 		break;
 	}
 }
 
+///zero the gyro, let the estimator know its velocity is stale and keep the pose in the new frame
+void Drivetrain::ZeroHeading() {
+	float fRemoved = gyro->GetAngle();
+
+	gyro->Zero();
+	estimator->Reset();
+	odometry->Rebase(fRemoved);
+}
+
+///the estimated heading, 0 until the sensor task has run once
+float Drivetrain::GetGyroAngle() {
+	StateEstimate state;
+
+	if(Blackboard::GetInstance()->estimate.Read(state)) {
+		return state.fHeading;
+	}
+
+	return 0.0;
+}
+
+///called from the sensor task
+bool Drivetrain::SampleAccelerometer(void *pThis, SensorSample &sample) {
+	Drivetrain *drivetrain = (Drivetrain *)pThis;
+
+	sample.fValue[0] = drivetrain->accelerometer.GetX();
+	sample.fValue[1] = drivetrain->accelerometer.GetY();
+	sample.fValue[2] = drivetrain->accelerometer.GetZ();
+	return true;
+}
+
+bool Drivetrain::SampleCurrent(void *pThis, SensorSample &sample) {
+	Drivetrain *drivetrain = (Drivetrain *)pThis;
+
+	sample.fValue[0] = drivetrain->leftMotor->GetOutputCurrent();
+	sample.fValue[1] = drivetrain->rightMotor->GetOutputCurrent();
+	sample.fValue[2] = drivetrain->bottomMotor->GetOutputCurrent();
+	sample.fValue[3] = max(sample.fValue[0], max(sample.fValue[1], sample.fValue[2]));
+	return true;
+}
+
+///prematch, called from a CheckList worker: on the bus and drawing current when pulsed
+bool Drivetrain::CheckMotor(void *pTalon, double fDeadline, char *szDetail) {
+	CANTalon *motor = (CANTalon *)pTalon;
+	double fEnd = RobotClock::GetTime() + DRIVETRAIN_CHECK_PULSE;
+	float fPeak = 0.0;
+
+	if(!motor->IsAlive()) {
+		snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "not on the CAN bus");
+		return false;
+	}
+
+	motor->Set(DRIVETRAIN_CHECK_POWER);
+
+	while((RobotClock::GetTime() < fEnd) && !CheckList::Expired(fDeadline)) {
+		RobotClock::Delay(DRIVETRAIN_CHECK_POLL);
+		fPeak = max(fPeak, (float)motor->GetOutputCurrent());
+	}
+
+	motor->Set(0.0);
+
+	if(RobotClock::GetTime() < fEnd) {
+		snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "stopped early, %.3g A peak", fPeak);
+		return false;
+	}
+
+	snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "%.3g A peak at %.3g%% power",
+			fPeak, 100.0 * DRIVETRAIN_CHECK_POWER);
+	return fPeak >= DRIVETRAIN_CHECK_CURRENT;
+}
+
+///prematch: sitting still the gyro rate should be small and steady
+bool Drivetrain::CheckGyroNoise(void *pThis, double fDeadline, char *szDetail) {
+	Drivetrain *drivetrain = (Drivetrain *)pThis;
+	const SensorRing *ring = SensorSampler::GetInstance()->GetRing(drivetrain->gyro->GetSensor());
+	SensorSample samples[SENSOR_RING_SIZE];
+	double fLast = RobotClock::GetTime();
+	double fEnd = fLast + DRIVETRAIN_CHECK_GYRO_TIME;
+	double fSum = 0.0;
+	double fSumSquares = 0.0;
+	unsigned uSamples = 0;
+	float fMean;
+	float fNoise;
+
+	while((RobotClock::GetTime() < fEnd) && !CheckList::Expired(fDeadline)) {
+		RobotClock::Delay(DRIVETRAIN_CHECK_POLL);
+
+		// the ring only ever holds the last few, take the ones newer than we have seen
+		unsigned uCopied = ring ? ring->GetSamples(ring->GetCount() - (SENSOR_RING_SIZE - 1),
+				samples, SENSOR_RING_SIZE) : 0;
+
+		for(unsigned i = 0; i < uCopied; i++) {
+			if(samples[i].fTime > fLast) {
+				fSum += samples[i].fValue[0];
+				fSumSquares += samples[i].fValue[0] * samples[i].fValue[0];
+				fLast = samples[i].fTime;
+				uSamples++;
+			}
+		}
+	}
+
+	if(RobotClock::GetTime() < fEnd) {
+		snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "stopped early after %u samples", uSamples);
+		return false;
+	}
+
+	if(uSamples < 2) {
+		snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "no samples, still calibrating?");
+		return false;
+	}
+
+	fMean = fSum / uSamples;
+	fNoise = sqrt(max(0.0, fSumSquares / uSamples - fMean * fMean));
+	snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "%.3g deg/s noise, %.3g drift, %u samples",
+			fNoise, fMean, uSamples);
+	return (fNoise <= DRIVETRAIN_CHECK_GYRO_NOISE) && (fabs(fMean) <= DRIVETRAIN_CHECK_GYRO_DRIFT);
+}
+
+///prematch: every gyro response since power up had good parity, watched for a while to be sure
+bool Drivetrain::CheckGyroSPI(void *pGyro, double fDeadline, char *szDetail) {
+	ADXRS453Z *gyro = (ADXRS453Z *)pGyro;
+	double fEnd = RobotClock::GetTime() + DRIVETRAIN_CHECK_GYRO_TIME;
+
+	while((RobotClock::GetTime() < fEnd) && !CheckList::Expired(fDeadline) && (gyro->GetParityErrors() == 0)) {
+		RobotClock::Delay(DRIVETRAIN_CHECK_POLL);
+	}
+
+	if((gyro->GetParityErrors() == 0) && (RobotClock::GetTime() < fEnd)) {
+		snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "stopped early");
+		return false;
+	}
+
+	snprintf(szDetail, CHECKLIST_DETAIL_SIZE, "%u parity errors", gyro->GetParityErrors());
+	return gyro->GetParityErrors() == 0;
+}
+
 ///left + , right -
 void Drivetrain::Run() {
 	switch(localMessage.command) {
@@ -132,42 +346,119 @@ void Drivetrain::Run() {
 		right = 0;
 		bottom = 0;
 		pAutoTimer->Reset();
-		gyro->Zero();
+		ZeroHeading();
 		break;
 
 	case COMMAND_AUTONOMOUS_COMPLETE:
 		//SmartDashboard::PutString("Drivetrain CMD", "AUTONOMOUS_COMPLETE");
 		//reset all auto variables
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		left = 0;
 		right = 0;
 		bottom = 0;
 		leftMotor->Set(left);
 		rightMotor->Set(right);
 		bottomMotor->Set(bottom);
-		gyro->Zero();
+		ZeroHeading();
 	break;
 
 	case COMMAND_DRIVETRAIN_STOP:
 		//SmartDashboard::PutString("Drivetrain CMD", "DRIVETRAIN_STOP");
 		//reset all auto variables
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
 		left = 0.0;
 		right = 0.0;
 		bottom = 0.0;
 		leftMotor->Set(left);
 		rightMotor->Set(right);
 		bottomMotor->Set(bottom);
-		gyro->Zero();
+		ZeroHeading();
 		break;
 
 	case COMMAND_SYSTEM_MSGTIMEOUT:
 		//SmartDashboard::PutString("Drivetrain CMD", "SYSTEM_MSGTIMEOUT");
 		break;
 	case COMMAND_DRIVETRAIN_DRIVE_KIWI:
-		KiwiDrive(
-				localMessage.params.kiwiDrive.x,
-				localMessage.params.kiwiDrive.y,
-				localMessage.params.kiwiDrive.r);
+		// must not undo a paused motion
+		if(motion == DRIVETRAIN_MOTION_NONE) {
+			fDriveX = localMessage.params.kiwiDrive.x;
+			fDriveY = localMessage.params.kiwiDrive.y;
+			fDriveR = localMessage.params.kiwiDrive.r;
+			KiwiDrive(fDriveX, fDriveY, fDriveR);
+		}
+		break;
+
+	case COMMAND_INPUT_AXES_MOVED:
+		// the sticks are heard in every mode so they are current when teleop starts
+		if(localMessage.params.input.uController >= INPUT_CONTROLLERS) {
+			break;
+		}
+
+		memcpy(fInputAxes[localMessage.params.input.uController], localMessage.params.input.axes,
+				sizeof(fInputAxes[0]));
+
+		if(bDriving && (motion == DRIVETRAIN_MOTION_NONE)) {
+			double fReceived = RobotClock::GetTime();
+
+			fDriveX = InputAxis(ACTION_DRIVE_X, fInputAxes);
+			fDriveY = InputAxis(ACTION_DRIVE_Y, fInputAxes);
+			fDriveR = InputAxis(ACTION_DRIVE_ROTATE, fInputAxes);
+			KiwiDrive(fDriveX, fDriveY, fDriveR);
+			LatencyProbe::GetInstance()->Trace(localMessage.params.input.stamp, fReceived);
+		}
+		break;
+
+	case COMMAND_INPUT_BUTTON_PRESSED:
+		if(bDriving && InputIsBound(ACTION_TEACH_TOGGLE, localMessage.params.input.uController,
+				localMessage.params.input.uInput)) {
+			if(teach.IsRecording()) {
+				StopTeaching();
+			} else {
+				printf("Drivetrain: recording\n");
+				teach.Start();
+			}
+		}
+		break;
+
+	case COMMAND_DRIVETRAIN_TEACH_START:
+		printf("Drivetrain: recording\n");
+		teach.Start();
+		break;
+
+	case COMMAND_DRIVETRAIN_TEACH_STOP:
+		StopTeaching();
+		break;
+
+	case COMMAND_DRIVETRAIN_DRIVE_DISTANCE:
+		StartMotion(DRIVETRAIN_MOTION_DISTANCE,
+				localMessage.params.autonomous.driveSpeed,
+				localMessage.params.autonomous.driveDistance);
+		break;
+
+	case COMMAND_DRIVETRAIN_TURN_ANGLE:
+		StartMotion(DRIVETRAIN_MOTION_TURN,
+				localMessage.params.autonomous.driveSpeed,
+				localMessage.params.autonomous.turnAngle);
+		break;
+
+	case COMMAND_DRIVETRAIN_DRIVE_TIME:
+		StartMotion(DRIVETRAIN_MOTION_TIME,
+				localMessage.params.autonomous.driveSpeed,
+				localMessage.params.autonomous.driveTime);
 		break;
+
+	case COMMAND_DRIVETRAIN_FOLLOW_PATH:
+		StartMotion(DRIVETRAIN_MOTION_FOLLOW, maxPower, 0.0);
+		break;
+
+	case COMMAND_AUTONOMOUS_CANCEL:
+		// autonomous has given up on this motion and is not waiting for an answer
+		if((motion != DRIVETRAIN_MOTION_NONE) && (localMessage.uSequence == motionRequest.uSequence)) {
+			motionRequest.replyQ = NULL;
+			FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -178,7 +469,23 @@ void Drivetrain::Run() {
 		pRemoteUpdateTimer->Reset();
 		//SmartDashboard::PutBoolean("Tote Detector", toteSensor->Get());
 		//gyro reading is truncated for the sake of the CSV file.
-		SmartDashboard::PutNumber("Gyro Angle", TRUNC_THOU(gyro->GetAngle()));
+		StateEstimate state;
+
+		if (estimator->GetEstimate(state))
+		{
+			SmartDashboard::PutNumber("Gyro Angle", TRUNC_THOU(state.fHeading));
+			SmartDashboard::PutNumber("Velocity X", TRUNC_HUND(state.fVelocityX));
+			SmartDashboard::PutNumber("Velocity Y", TRUNC_HUND(state.fVelocityY));
+			SmartDashboard::PutBoolean("Wheel Slip", state.bSlipping);
+		}
+
+		RobotPose pose;
+
+		if (odometry->GetPose(pose))
+		{
+			SmartDashboard::PutNumber("Pose X", TRUNC_HUND(pose.x));
+			SmartDashboard::PutNumber("Pose Y", TRUNC_HUND(pose.y));
+		}
 	}
 }
 void Drivetrain::KiwiDrive(float x, float y, float rot){
@@ -188,12 +495,10 @@ void Drivetrain::KiwiDrive(float x, float y, float rot){
 	// and that sin and cos are in radians
 
 
-	float gangle = gyro->GetAngle();
+	float gangle = estimator->GetHeading();
 	float grangle = gangle/180*3.1415926535;
 
-	if (abs(rot)<.1){// DEADZONE
-		rot = 0;
-	}else{
+	if (rot != 0){// the deadzone is taken out when the triggers are read, see RobotParams.h
 		targetRot = grangle+rot*rotationGain;
 	}
 	float rotationAmount = (targetRot-grangle)*rotationPower;
@@ -271,3 +576,277 @@ void Drivetrain::KiwiDrive(float x, float y, float rot){
 	SmartDashboard::PutNumber("Bottom motor", bottom);
 
 }
+
+/** Starts a closed loop motion for autonomous.
+ *
+ * The request is kept so Control() can answer it when the motion finishes.  Starting a motion
+ * while another is running ends the old one with an error.
+ */
+void Drivetrain::StartMotion(DrivetrainMotion newMotion, float fSpeed, float fTarget) {
+	FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+
+	// distance comes from the wheels, without them we cannot tell when to stop
+	if(!odometry->GetPose(motionStart) ||
+			((newMotion == DRIVETRAIN_MOTION_DISTANCE) && !DRIVETRAIN_USE_ENCODERS)) {
+		if(newMotion == DRIVETRAIN_MOTION_FOLLOW) {
+			PathPlanner::GetInstance()->Release(localMessage.params.autonomous.trajectory);
+		}
+
+		if(localMessage.replyQ) {
+			SendCommandResponse(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+		}
+		return;
+	}
+
+	motionRequest = localMessage;
+	motion = newMotion;
+	bMotionPaused = false;
+	fMotionSpeed = min((float)fabs(fSpeed), maxPower);
+	fMotionTarget = fTarget;
+	fMotionHeading = estimator->GetHeading();
+
+	if(motion == DRIVETRAIN_MOTION_TURN) {
+		fMotionHeading += fTarget;
+	}
+
+	fMotionStartTime = SensorSampler::GetTime();
+	fMotionMovedTime = fMotionStartTime;
+}
+
+///Stops the motors and answers the motion in progress, if there is one
+void Drivetrain::FinishMotion(MessageCommand response) {
+	if(motion == DRIVETRAIN_MOTION_NONE) {
+		return;
+	}
+
+	SetMotion(0.0, 0.0, 0.0);
+
+	if(motion == DRIVETRAIN_MOTION_FOLLOW) {
+		PathPlanner::GetInstance()->Release(motionRequest.params.autonomous.trajectory);
+	}
+
+	motion = DRIVETRAIN_MOTION_NONE;
+	bMotionPaused = false;
+
+	if(motionRequest.replyQ) {
+		SendCommandResponse(response, motionRequest);
+	}
+}
+
+///While disabled the motion holds still, time spent disabled does not count against it
+void Drivetrain::PauseMotion(bool bPause) {
+	double fNow = SensorSampler::GetTime();
+
+	if(motion == DRIVETRAIN_MOTION_NONE) {
+		return;
+	}
+
+	if(bPause && !bMotionPaused) {
+		bMotionPaused = true;
+		fMotionPauseTime = fNow;
+	}
+	else if(!bPause && bMotionPaused) {
+		bMotionPaused = false;
+		fMotionStartTime += fNow - fMotionPauseTime;
+		fMotionMovedTime = fNow;
+	}
+}
+
+///Runs the motion in progress, called every control period
+void Drivetrain::Control() {
+	double fNow = SensorSampler::GetTime();
+	StateEstimate state;
+	RobotPose pose;
+	float fHeadingError;
+	float fTurn;
+	float fDrive;
+	float fLeft;
+	MessageCommand response;
+	DriveMotors motors;
+
+	// publish what the motors were last told, whichever message or motion told them
+	motors.left = leftMotor->Get();
+	motors.right = rightMotor->Get();
+	motors.bottom = bottomMotor->Get();
+	Blackboard::GetInstance()->motors.Write(motors);
+
+	if(teach.IsRecording() && odometry->GetPose(pose)) {
+		teach.Add(fNow, pose, fDriveX, fDriveY, fDriveR);
+	}
+
+	// between stick events the last command is driven again, which keeps the heading held
+	if(bDriving && (motion == DRIVETRAIN_MOTION_NONE)) {
+		KiwiDrive(fDriveX, fDriveY, fDriveR);
+		return;
+	}
+
+	if((motion == DRIVETRAIN_MOTION_NONE) || bMotionPaused) {
+		return;
+	}
+
+	if(!estimator->GetEstimate(state) || !odometry->GetPose(pose)) {
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+		return;
+	}
+
+	// every motion holds a heading, a turn just moves it first
+
+	fHeadingError = fMotionHeading - state.fHeading;
+	fTurn = DRIVETRAIN_HEADING_GAIN * fHeadingError;
+	ABLIMIT(fTurn, fMotionSpeed);
+
+	switch(motion) {
+	case DRIVETRAIN_MOTION_DISTANCE:
+		fLeft = fabs(fMotionTarget) - hypot(pose.x - motionStart.x, pose.y - motionStart.y);
+
+		if(fLeft <= DRIVETRAIN_DISTANCE_TOLERANCE) {
+			FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_OK);
+			return;
+		}
+
+		// slow down over the last few inches but never so much that we stop short
+		fDrive = max(DRIVETRAIN_MIN_POWER, min(fMotionSpeed, DRIVETRAIN_DISTANCE_GAIN * fLeft));
+		SetMotion(0.0, (fMotionTarget < 0.0) ? -fDrive : fDrive, fTurn);
+
+		if(hypot(state.fVelocityX, state.fVelocityY) > DRIVETRAIN_STALL_SPEED) {
+			fMotionMovedTime = fNow;
+		}
+		break;
+
+	case DRIVETRAIN_MOTION_TURN:
+		if((fabs(fHeadingError) < DRIVETRAIN_TURN_TOLERANCE) &&
+				(fabs(state.fAngularRate) < DRIVETRAIN_TURN_SETTLED_RATE)) {
+			FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_OK);
+			return;
+		}
+
+		if(fabs(fHeadingError) >= DRIVETRAIN_TURN_TOLERANCE) {
+			fTurn = copysignf(max((float)fabs(fTurn), DRIVETRAIN_MIN_POWER), fHeadingError);
+		}
+
+		SetMotion(0.0, 0.0, fTurn);
+
+		if((fabs(state.fAngularRate) > DRIVETRAIN_STALL_RATE) ||
+				(fabs(fHeadingError) < DRIVETRAIN_TURN_TOLERANCE)) {
+			fMotionMovedTime = fNow;
+		}
+		break;
+
+	case DRIVETRAIN_MOTION_TIME:
+		if(fNow - fMotionStartTime >= fMotionTarget) {
+			FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_OK);
+			return;
+		}
+
+		// a timed drive is allowed to push against something, it never stalls out
+		SetMotion(0.0, copysignf(fMotionSpeed, motionRequest.params.autonomous.driveSpeed), fTurn);
+		fMotionMovedTime = fNow;
+		break;
+
+	case DRIVETRAIN_MOTION_FOLLOW:
+		// falling behind the trajectory takes the place of stall detection
+		fMotionMovedTime = fNow;
+
+		response = Follow(fNow, state, pose);
+
+		if(response != COMMAND_UNKNOWN) {
+			FinishMotion(response);
+			return;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if(fNow - fMotionMovedTime > DRIVETRAIN_STALL_TIME) {
+		printf("Drivetrain: motion stalled\n");
+		FinishMotion(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+	}
+}
+
+///Saves the recording, if there is one, where TRAJECTORY can find it
+void Drivetrain::StopTeaching() {
+	char szFileName[128];
+
+	if(!teach.IsRecording()) {
+		return;
+	}
+
+	snprintf(szFileName, sizeof(szFileName), "%s/%s", PATH_CACHE_DIR, TEACH_FILE_NAME);
+
+	if(teach.Stop(szFileName)) {
+		PathPlanner::GetInstance()->Reload(TEACH_FILE_NAME);
+	}
+}
+
+/** One control tick of following a trajectory.
+ *
+ * The sample for this tick gives the feedforward, wheel speed and acceleration turned into
+ * power, and the pose error on top of that pulls the robot back onto the path.  Returns the
+ * response once the motion is over, COMMAND_UNKNOWN while it is still going.
+ */
+MessageCommand Drivetrain::Follow(double fNow, const StateEstimate &state, const RobotPose &pose) {
+	const Trajectory *pTrajectory = motionRequest.params.autonomous.trajectory;
+	double fElapsed = fNow - fMotionStartTime;
+	unsigned uLast = pTrajectory->GetSize() - 1;
+	unsigned uIndex = min((unsigned)(fElapsed / TRAJECTORY_PERIOD + 0.5), uLast);
+	const TrajectorySample &sample = pTrajectory->GetSample(uIndex);
+	float fErrorX = sample.x - pose.x;
+	float fErrorY = sample.y - pose.y;
+	float fError = hypot(fErrorX, fErrorY);
+	float fHeadingError = sample.fHeading - state.fHeading;
+	float x;
+	float y;
+	float r;
+
+	if(uIndex == uLast) {
+		if((fError < DRIVETRAIN_FOLLOW_TOLERANCE) && (fabs(fHeadingError) < DRIVETRAIN_TURN_TOLERANCE)) {
+			return(COMMAND_AUTONOMOUS_RESPONSE_OK);
+		}
+
+		if(fElapsed > pTrajectory->GetDuration() + DRIVETRAIN_FOLLOW_SETTLE_TIME) {
+			printf("Drivetrain: trajectory ended %0.1f inches short\n", fError);
+			return(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+		}
+	}
+
+	if(fError > DRIVETRAIN_FOLLOW_MAX_ERROR) {
+		printf("Drivetrain: %0.1f inches off the trajectory\n", fError);
+		return(COMMAND_AUTONOMOUS_RESPONSE_ERROR);
+	}
+
+	// field frame power, then turned into the robot frame the way KiwiDrive does it
+
+	x = DRIVETRAIN_FOLLOW_KV * sample.vx + DRIVETRAIN_FOLLOW_KA * sample.ax + DRIVETRAIN_FOLLOW_GAIN * fErrorX;
+	y = DRIVETRAIN_FOLLOW_KV * sample.vy + DRIVETRAIN_FOLLOW_KA * sample.ay + DRIVETRAIN_FOLLOW_GAIN * fErrorY;
+	r = DRIVETRAIN_BASE_RADIUS * KIWI_DEG_TO_RAD *
+			(DRIVETRAIN_FOLLOW_KV * sample.fRate + DRIVETRAIN_FOLLOW_KA * sample.fAngularAccel) +
+			DRIVETRAIN_HEADING_GAIN * fHeadingError;
+
+	KiwiFieldToRobot(state.fHeading * KIWI_DEG_TO_RAD, x, y);
+	SetMotion(x, y, r);
+	return(COMMAND_UNKNOWN);
+}
+
+///Robot frame motor powers, y is forward and positive r turns toward a larger gyro angle
+void Drivetrain::SetMotion(float x, float y, float r) {
+	KiwiMotion power = { x, y, r };
+	KiwiWheels wheels = KiwiInverse(power, 1.0);
+	float fLargest = max((float)fabs(wheels.left), max((float)fabs(wheels.right), (float)fabs(wheels.bottom)));
+
+	// scale rather than clip so the robot still moves in the direction we asked for
+	if(fLargest > maxPower) {
+		wheels.left *= maxPower / fLargest;
+		wheels.right *= maxPower / fLargest;
+		wheels.bottom *= maxPower / fLargest;
+	}
+
+	left = wheels.left;
+	right = wheels.right;
+	bottom = wheels.bottom;
+
+	leftMotor->Set(-left);
+	rightMotor->Set(-right);
+	bottomMotor->Set(-bottom);
+}
@@ -16,6 +16,54 @@
 
 #include "ComponentBase.h"			//For ComponentBase class
 #include "ADXRS453Z.h"
+#include "CheckList.h"
+#include "InputBindings.h"
+#include "SensorSampler.h"
+#include "StateEstimator.h"
+#include "KiwiOdometry.h"
+#include "TeachRecorder.h"
+
+//Autonomous motions - closed loop commands run at this rate, distances in inches, angles in degrees
+const float DRIVETRAIN_CONTROL_RATE		= 100.0;
+const float DRIVETRAIN_DISTANCE_GAIN	= 0.04;		//power per inch left to go
+const float DRIVETRAIN_DISTANCE_TOLERANCE = 1.0;
+const float DRIVETRAIN_HEADING_GAIN		= 0.02;		//power per degree of heading error
+const float DRIVETRAIN_TURN_TOLERANCE	= 2.0;
+const float DRIVETRAIN_TURN_SETTLED_RATE = 10.0;	//degrees/s, slower than this counts as stopped
+const float DRIVETRAIN_MIN_POWER		= 0.08;		//least power that still moves the robot
+const float DRIVETRAIN_STALL_TIME		= 0.5;		//seconds without motion before we give up
+const float DRIVETRAIN_STALL_SPEED		= 2.0;		//inches/s
+const float DRIVETRAIN_STALL_RATE		= 5.0;		//degrees/s
+const float DRIVETRAIN_FOLLOW_KV		= 0.008;	//power per inch/s of wheel speed
+const float DRIVETRAIN_FOLLOW_KA		= 0.001;	//power per inch/s/s
+const float DRIVETRAIN_FOLLOW_GAIN		= 0.05;		//power per inch behind the trajectory
+const float DRIVETRAIN_FOLLOW_TOLERANCE	= 2.0;		//inches from the end that counts as there
+const float DRIVETRAIN_FOLLOW_SETTLE_TIME = 1.0;	//seconds past the end we wait to get there
+const float DRIVETRAIN_FOLLOW_MAX_ERROR	= 18.0;		//inches off the trajectory before we give up
+
+//Prematch checks - run by the CheckList in test mode
+const int DRIVETRAIN_CHECKS				= 5;
+const float DRIVETRAIN_CHECK_POWER		= 0.3;		//power each motor is pulsed with
+const float DRIVETRAIN_CHECK_PULSE		= 0.25;		//seconds
+const float DRIVETRAIN_CHECK_CURRENT	= 2.0;		//amps, least a pulsed motor should draw
+const float DRIVETRAIN_CHECK_GYRO_TIME	= 1.0;		//seconds of gyro rate looked at
+const float DRIVETRAIN_CHECK_GYRO_NOISE	= 0.5;		//degrees/s, standard deviation sitting still
+const float DRIVETRAIN_CHECK_GYRO_DRIFT	= 1.0;		//degrees/s, average sitting still after calibration
+const float DRIVETRAIN_CHECK_POLL		= 0.01;		//seconds between looks while checking
+
+//What the drivetrain is sent from the controllers
+constexpr uint32_t DRIVETRAIN_INPUT_ACTIONS = InputActionBit(ACTION_DRIVE_X) | InputActionBit(ACTION_DRIVE_Y) |
+		InputActionBit(ACTION_DRIVE_ROTATE) | InputActionBit(ACTION_TEACH_TOGGLE);
+
+///Closed loop motion the drivetrain is running for autonomous
+typedef enum DrivetrainMotion
+{
+	DRIVETRAIN_MOTION_NONE,
+	DRIVETRAIN_MOTION_DISTANCE,
+	DRIVETRAIN_MOTION_TURN,
+	DRIVETRAIN_MOTION_TIME,
+	DRIVETRAIN_MOTION_FOLLOW
+} DrivetrainMotion;
 
 class Drivetrain : public ComponentBase
 {
@@ -28,14 +76,17 @@ public:
 		return(NULL);
 	}
 
-	bool GetGyroAngle();
+	float GetGyroAngle();		//degrees, from the blackboard so any task may ask
 private:
+	friend struct RobotBench;	//the benchmarks time KiwiDrive directly
 
 	CANTalon* leftMotor;
 	CANTalon* rightMotor;
 	CANTalon* bottomMotor;
 	ADXRS453Z *gyro;
 	BuiltInAccelerometer accelerometer;
+	StateEstimator *estimator;
+	KiwiOdometry *odometry;
 	//Timer *pAutoTimer; //watches autonomous time and disables it if needed.IN COMPONENT BASE
 	//stores motor values during autonomous
 
@@ -52,12 +103,49 @@ private:
 	float rotationPriority = 0.5f; // Percentage of the power used for turning
 	bool goingAngle = false;
 	bool enableBB = false;
-	//diameter*pi/encoder_resolution : 1.875 * 3.14 / 256
+	int iAccelSensor = -1; // sampler id, samples hold x, y, z in g
+	int iCurrentSensor = -1; // sampler id, samples hold left, right, bottom and the highest current in amps
+	int iChecks[DRIVETRAIN_CHECKS]; // CheckList ids
+
+	// the autonomous motion in progress, answered when it finishes
+	DrivetrainMotion motion = DRIVETRAIN_MOTION_NONE;
+	RobotMessage motionRequest;
+	bool bMotionPaused = false;
+	float fMotionSpeed = 0.0f;
+	float fMotionTarget = 0.0f; // inches, degrees or seconds, the trajectory is in motionRequest
+	float fMotionHeading = 0.0f; // heading held while driving, where a turn ends
+	RobotPose motionStart;
+	double fMotionStartTime = 0.0;
+	double fMotionPauseTime = 0.0;
+	double fMotionMovedTime = 0.0; // last time we saw the robot move, for stall detection
+
+	// teleop, the sticks are only sent when they move so the heading is held from Control()
+	bool bDriving = false;
+	float fInputAxes[INPUT_CONTROLLERS][JOYSTICK_AXIS_COUNT] = {}; // each controller's last COMMAND_INPUT_AXES_MOVED
+
+	// teach and repeat, the joystick command is recorded along with the pose it produced
+	TeachRecorder teach;
+	float fDriveX = 0.0f;
+	float fDriveY = 0.0f;
+	float fDriveR = 0.0f;
 
 	void OnStateChange();
 	void Run();
 	void Put();//for SmartDashboard
 	void KiwiDrive(float x, float y, float rot);
+	void Control();
+	void StartMotion(DrivetrainMotion newMotion, float fSpeed, float fTarget);
+	void FinishMotion(MessageCommand response);
+	void PauseMotion(bool bPause);
+	void SetMotion(float x, float y, float r);
+	MessageCommand Follow(double fNow, const StateEstimate &state, const RobotPose &pose);
+	void StopTeaching();
+	void ZeroHeading();
+	static bool SampleAccelerometer(void *pThis, SensorSample &sample);
+	static bool SampleCurrent(void *pThis, SensorSample &sample);
+	static bool CheckMotor(void *pTalon, double fDeadline, char *szDetail);
+	static bool CheckGyroNoise(void *pThis, double fDeadline, char *szDetail);
+	static bool CheckGyroSPI(void *pGyro, double fDeadline, char *szDetail);
 
 };
 
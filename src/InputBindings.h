@@ -0,0 +1,150 @@
+/** \file
+ * Which controller input does what.
+ *
+ * INPUT_BINDINGS maps each logical action to an axis or a button on one of the controllers in
+ * INPUT_CONTROLLER_PORTS, numbered from the layouts in JoystickLayouts.h.  An action bound
+ * more than once adds up its axes, each times its scale, which is how the two triggers make
+ * one rotation.  The table is constexpr, so the masks components subscribe with are worked out
+ * by the compiler and reading an action is a few loads it can unroll, with no virtual calls.
+ *
+ * Adding an operator controller is a port for it and entries in the table, EXAMPLE:
+ *	{ ACTION_ARM_LIFT, INPUT_CONTROLLER_2, INPUT_AXIS, L310_THUMBSTICK_LEFT_Y, -1.0, DRIVE_STICK_SHAPE },
+ * JoystickMonitor picks up the shapes and RhsRobot subscribes components to what they use.
+ */
+
+#ifndef INPUT_BINDINGS_H
+#define INPUT_BINDINGS_H
+
+#include <stdint.h>
+
+#include "InputShaper.h"
+#include "JoystickLayouts.h"
+#include "RobotParams.h"
+
+///What the robot can be told to do from a controller, at most 32
+enum InputAction {
+	ACTION_DRIVE_X,				//!< strafe, field centric
+	ACTION_DRIVE_Y,				//!< forward
+	ACTION_DRIVE_ROTATE,		//!< turn toward a larger gyro angle
+	ACTION_TEACH_TOGGLE,		//!< start or stop recording a path for autonomous to play back
+	ACTION_COUNT
+};
+
+enum InputController {
+	INPUT_CONTROLLER_1,			//!< the driver
+	INPUT_CONTROLLER_2,			//!< the operator
+	INPUT_CONTROLLERS
+};
+
+enum InputKind {
+	INPUT_AXIS,
+	INPUT_BUTTON
+};
+
+struct InputBinding {
+	InputAction action;
+	unsigned uController;		//!< InputController
+	InputKind kind;
+	unsigned uInput;			//!< axes are numbered from 0, buttons from 1
+	float fScale;				//!< axes only, -1 for an axis that reads inverted
+	AxisShape shape;			//!< axes only, see InputShaper.h
+};
+
+constexpr unsigned INPUT_CONTROLLER_PORTS[INPUT_CONTROLLERS] = { CONTROLLER_1_PORT, CONTROLLER_2_PORT };
+
+constexpr AxisShape DRIVE_STICK_SHAPE = { DRIVE_STICK_DEADZONE, DRIVE_STICK_EXPO, DRIVE_STICK_SLEW };
+constexpr AxisShape DRIVE_TRIGGER_SHAPE = { DRIVE_TRIGGER_DEADZONE, DRIVE_TRIGGER_EXPO, DRIVE_TRIGGER_SLEW };
+constexpr AxisShape NO_SHAPE = { 0.0, 0.0, 0.0 };
+
+constexpr InputBinding INPUT_BINDINGS[] = {
+	// driver, Logitech 310
+	{ ACTION_DRIVE_X,		INPUT_CONTROLLER_1, INPUT_AXIS,		L310_THUMBSTICK_LEFT_X,	 1.0, DRIVE_STICK_SHAPE },
+	{ ACTION_DRIVE_Y,		INPUT_CONTROLLER_1, INPUT_AXIS,		L310_THUMBSTICK_LEFT_Y,	-1.0, DRIVE_STICK_SHAPE },
+	{ ACTION_DRIVE_ROTATE,	INPUT_CONTROLLER_1, INPUT_AXIS,		L310_TRIGGER_RIGHT,		 1.0, DRIVE_TRIGGER_SHAPE },
+	{ ACTION_DRIVE_ROTATE,	INPUT_CONTROLLER_1, INPUT_AXIS,		L310_TRIGGER_LEFT,		-1.0, DRIVE_TRIGGER_SHAPE },
+	{ ACTION_TEACH_TOGGLE,	INPUT_CONTROLLER_1, INPUT_BUTTON,	L310_BUTTON_START,		 0.0, NO_SHAPE },
+
+	// operator, Logitech 310, nothing to operate yet
+};
+
+constexpr unsigned INPUT_BINDING_COUNT = sizeof(INPUT_BINDINGS) / sizeof(INPUT_BINDINGS[0]);
+
+///Bit of an action in the masks the functions below take
+constexpr uint32_t InputActionBit(InputAction action)
+{
+	return(1u << action);
+}
+
+/** The inputs of one kind on a controller that the actions in uActions are bound to.
+ *
+ * Axis n is bit n and button n is bit n - 1, as JoystickMonitor::Subscribe() takes them.
+ */
+constexpr uint32_t InputMask(unsigned uController, InputKind kind, uint32_t uActions)
+{
+	uint32_t uMask = 0;
+
+	for(unsigned i = 0; i < INPUT_BINDING_COUNT; i++)
+	{
+		if((INPUT_BINDINGS[i].uController == uController) && (INPUT_BINDINGS[i].kind == kind) &&
+				(uActions & InputActionBit(INPUT_BINDINGS[i].action)))
+		{
+			uMask |= 1u << ((kind == INPUT_AXIS) ? INPUT_BINDINGS[i].uInput : INPUT_BINDINGS[i].uInput - 1);
+		}
+	}
+
+	return(uMask);
+}
+
+///True if the button on the controller is bound to the action
+constexpr bool InputIsBound(InputAction action, unsigned uController, unsigned uButton)
+{
+	for(unsigned i = 0; i < INPUT_BINDING_COUNT; i++)
+	{
+		if((INPUT_BINDINGS[i].action == action) && (INPUT_BINDINGS[i].uController == uController) &&
+				(INPUT_BINDINGS[i].kind == INPUT_BUTTON) && (INPUT_BINDINGS[i].uInput == uButton))
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+///An axis action from the controllers' axes, axes[controller][axis]
+inline float InputAxis(InputAction action, const float axes[][JOYSTICK_AXIS_COUNT])
+{
+	float fValue = 0.0;
+
+	for(unsigned i = 0; i < INPUT_BINDING_COUNT; i++)
+	{
+		if((INPUT_BINDINGS[i].action == action) && (INPUT_BINDINGS[i].kind == INPUT_AXIS))
+		{
+			fValue += INPUT_BINDINGS[i].fScale * axes[INPUT_BINDINGS[i].uController][INPUT_BINDINGS[i].uInput];
+		}
+	}
+
+	return(fValue);
+}
+
+///Every entry names an input the monitors watch on a controller that exists
+constexpr bool InputBindingsValid()
+{
+	for(unsigned i = 0; i < INPUT_BINDING_COUNT; i++)
+	{
+		const InputBinding &binding = INPUT_BINDINGS[i];
+
+		if((binding.uController >= INPUT_CONTROLLERS) ||
+				((binding.kind == INPUT_AXIS) && (binding.uInput >= (unsigned)JOYSTICK_AXIS_COUNT)) ||
+				((binding.kind == INPUT_BUTTON) && ((binding.uInput < 1) || (binding.uInput > (unsigned)JOYSTICK_BUTTON_COUNT))))
+		{
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+static_assert(ACTION_COUNT <= 32, "input actions are kept in a 32 bit mask");
+static_assert(InputBindingsValid(), "an input binding is out of range, see JOYSTICK_AXIS_COUNT and JOYSTICK_BUTTON_COUNT");
+
+#endif //INPUT_BINDINGS_H
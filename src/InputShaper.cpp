@@ -0,0 +1,62 @@
+/** \file
+ * Input shaping for a joystick axis: deadzone, expo curve and slew limit.
+ */
+
+#include "InputShaper.h"
+
+#include <math.h>
+
+///Starts out passing the axis straight through
+InputShaper::InputShaper()
+{
+	AxisShape linear = { 0.0, 0.0, 0.0 };
+
+	fOutput = 0.0;
+	fLastTime = -1.0;
+	SetShape(linear);
+}
+
+///Builds the table, the slew limit carries on from the last output
+void InputShaper::SetShape(const AxisShape &newShape)
+{
+	shape = newShape;
+	shape.fDeadzone = fminf(fmaxf(shape.fDeadzone, 0.0), 0.95);
+	shape.fExpo = fminf(fmaxf(shape.fExpo, 0.0), 1.0);
+	fScale = (INPUT_SHAPE_POINTS - 1) / (1.0 - shape.fDeadzone);
+
+	for(unsigned i = 0; i < INPUT_SHAPE_POINTS; i++)
+	{
+		float t = (float)i / (INPUT_SHAPE_POINTS - 1);
+
+		fTable[i] = (1.0 - shape.fExpo) * t + shape.fExpo * t * t * t;
+	}
+
+	fTable[INPUT_SHAPE_POINTS] = fTable[INPUT_SHAPE_POINTS - 1];
+}
+
+///Shapes one sample of the axis taken at fTime seconds
+float InputShaper::Shape(float fRaw, double fTime)
+{
+	float fTravel = fabsf(fRaw) - shape.fDeadzone;
+	float fTarget = 0.0;
+
+	if(fTravel > 0.0)
+	{
+		float fIndex = fminf(fTravel * fScale, INPUT_SHAPE_POINTS - 1);
+		unsigned i = (unsigned)fIndex;
+		float fValue = fTable[i] + (fIndex - i) * (fTable[i + 1] - fTable[i]);
+
+		fTarget = copysignf(fValue, fRaw);
+	}
+
+	if((shape.fSlewRate > 0.0) && (fLastTime >= 0.0))
+	{
+		float fStep = shape.fSlewRate * (fTime - fLastTime);
+
+		fTarget = fminf(fmaxf(fTarget, fOutput - fStep), fOutput + fStep);
+	}
+
+	fOutput = fTarget;
+	fLastTime = fTime;
+	return(fOutput);
+}
@@ -0,0 +1,40 @@
+/** \file
+ * Input shaping for a joystick axis: deadzone, expo curve and slew limit.
+ *
+ * The curve is worked out once, when the shape is set, into a table of INPUT_SHAPE_POINTS
+ * values over the travel past the deadzone.  Shaping a sample is then a lookup and a linear
+ * interpolation, with no pow() or anything like it per packet.  Curves are odd, so a stick
+ * pushed either way feels the same, and the deadzone is taken out before the curve so the
+ * output still starts from 0 and reaches full scale.
+ */
+
+#ifndef INPUT_SHAPER_H
+#define INPUT_SHAPER_H
+
+const unsigned INPUT_SHAPE_POINTS = 33;		//table entries from the edge of the deadzone to full travel
+
+///How an axis should feel, the robot's are in RobotParams.h
+struct AxisShape {
+	float fDeadzone;		//!< fraction of the travel either side of center that reads 0
+	float fExpo;			//!< 0 linear to 1 cubic, the higher the softer around center
+	float fSlewRate;		//!< most the output changes in a second, 0 for no limit
+};
+
+class InputShaper
+{
+public:
+	InputShaper();
+
+	void SetShape(const AxisShape &newShape);
+	const AxisShape &GetShape() const { return(shape); };
+	float Shape(float fRaw, double fTime);
+
+private:
+	AxisShape shape;
+	float fScale;							//table entries per unit of travel past the deadzone
+	float fTable[INPUT_SHAPE_POINTS + 1];	//the extra copy of the last lets full travel interpolate
+	float fOutput;							//the last shaped value, where the slew limit starts from
+	double fLastTime;						//seconds, negative before the first sample
+};
+
+#endif //INPUT_SHAPER_H
@@ -1,71 +1,148 @@
 #include "JoystickMonitor.h"
+#include "LatencyProbe.h"
+#include "RobotClock.h"
 #include "RobotParams.h"
 #include "WPILib.h"
 
 #include <cmath>
+#include <cstring>
 
-JoystickMonitor::JoystickMonitor(Joystick *j) {
-	stick = j;
+///controller is one of the InputControllers of InputBindings.h
+JoystickMonitor::JoystickMonitor(unsigned c) {
+	controller = c;
+	port = INPUT_CONTROLLER_PORTS[c];
+	buttonsDown = 0;
+	buttonsPressed = 0;
+	buttonsReleased = 0;
+	axesMoved = 0;
+	pov = POV_STILL;
 	axisTolerance = .0001;
 
-	for (int i = 0; i < JOYSTICK_BUTTON_COUNT; i++)
+	for (int i = 0; i < JOYSTICK_AXIS_COUNT; i++)
 	{
-		buttonsDown.push_back(stick->GetRawButton(i + 1));
+		axisReported[i] = 0.0;
 	}
-	for (int i = 0; i < JOYSTICK_AXIS_COUNT; i++)
+
+	axisValues[JOYSTICK_AXIS_COUNT] = 0.0;
+
+	for (unsigned int i = 0; i < INPUT_BINDING_COUNT; i++)
 	{
-		//the ID is 1 greater than the location in the vector
-		axisValues.push_back(stick->GetRawAxis(i + 1));
+		if ((INPUT_BINDINGS[i].uController == controller) && (INPUT_BINDINGS[i].kind == INPUT_AXIS))
+		{
+			SetAxisShape(1u << INPUT_BINDINGS[i].uInput, INPUT_BINDINGS[i].shape);
+		}
 	}
+
+	// start from what the stick shows now, so nothing already held counts as pressed
+	Update();
+	buttonsPressed = 0;
+	axesMoved = 0;
 }
 JoystickMonitor::~JoystickMonitor() {
 
 }
 
 /**
- * Updates the stored "previous" values of each button and axis.
- * Be sure to call this at the END of the run function so that you have these values during the next cycle.
+ * Takes the snapshot the queries answer from.
+ * Call this once per driver station packet, BEFORE anything asks about the stick.
  */
-void JoystickMonitor::FinalUpdate() {
-	for (unsigned int i = 0; i < buttonsDown.size(); i++)
+void JoystickMonitor::Update() {
+	DriverStation *ds = DriverStation::GetInstance();
+	double now = RobotClock::GetTime();
+	uint32_t buttons = ds->GetStickButtons(port) & ((1u << JOYSTICK_BUTTON_COUNT) - 1);
+	uint32_t changed = buttons ^ buttonsDown;
+
+	buttonsPressed = changed & buttons;
+	buttonsReleased = changed & buttonsDown;
+	buttonsDown = buttons;
+
+	// an axis is compared with where it last moved, not the last packet, so a slow push still counts
+	axesMoved = 0;
+
+	for (int i = 0; i < JOYSTICK_AXIS_COUNT; i++)
 	{
-		buttonsDown[i] = stick->GetRawButton(i + 1);
+		axisValues[i] = shapers[i].Shape(ds->GetStickAxis(port, i), now);
+
+		if ((std::abs(axisValues[i] - axisReported[i]) > axisTolerance)
+				|| ((axisValues[i] == 0.0) && (axisReported[i] != 0.0)))
+		{
+			axesMoved |= 1u << i;
+			axisReported[i] = axisValues[i];
+		}
 	}
-	for (unsigned int i = 0; i < axisValues.size(); i++)
+
+	pov = ds->GetStickPOV(port, 0);
+}
+
+/**
+ * Sends a component events for the buttons (bit n - 1 for button n) and axes (bit n for axis n)
+ * in the masks.  Subscribing again replaces the masks.
+ */
+void JoystickMonitor::Subscribe(ComponentBase *component, uint32_t buttons, uint32_t axes) {
+	for (unsigned int i = 0; i < subscribers.size(); i++)
 	{
-		axisValues[i] = stick->GetRawAxis(i + 1);
+		if (subscribers[i].component == component)
+		{
+			subscribers[i].buttons = buttons;
+			subscribers[i].axes = axes;
+			return;
+		}
 	}
+
+	Subscriber subscriber = { component, buttons, axes };
+	subscribers.push_back(subscriber);
 }
 
-///Returns true if the target button was up in the previous cycle but is down in the current cycle.
-bool JoystickMonitor::ButtonPressed(unsigned int button) {
-	if (button > 0 && button <= buttonsDown.size()
-			&& stick->GetRawButton(button) && !buttonsDown[button - 1])
+/**
+ * Sends the subscribers what changed in the last Update(), time is when the packet was seen.
+ */
+void JoystickMonitor::Publish(double time) {
+	RobotMessage message;
+
+	if (!(buttonsPressed | buttonsReleased | axesMoved))
 	{
-		return true;
+		return;
+	}
+
+	memset(&message, 0, sizeof(message));
+	message.command = COMMAND_INPUT_AXES_MOVED;
+	message.params.input.uController = controller;
+	memcpy(message.params.input.axes, axisValues, sizeof(message.params.input.axes));
+
+	if (axesMoved)
+	{
+		LatencyProbe::GetInstance()->Stamp(message.params.input.stamp, time);
 	}
-	return false;
-}
 
-///Returns true if the target button was down in the previous cycle but is up in the current cycle.
-bool JoystickMonitor::ButtonReleased(unsigned int button) {
-	if (button > 0 && button <= buttonsDown.size()
-			&& !stick->GetRawButton(button) && buttonsDown[button - 1])
+	for (unsigned int i = 0; i < subscribers.size(); i++)
 	{
-		return true;
+		SendButtons(subscribers[i].component, COMMAND_INPUT_BUTTON_PRESSED,
+				buttonsPressed & subscribers[i].buttons);
+		SendButtons(subscribers[i].component, COMMAND_INPUT_BUTTON_RELEASED,
+				buttonsReleased & subscribers[i].buttons);
+
+		if (axesMoved & subscribers[i].axes)
+		{
+			message.params.input.uInput = axesMoved & subscribers[i].axes;
+			subscribers[i].component->SendMessage(&message);
+		}
 	}
-	return false;
 }
 
-///Returns true if given axis moved at least the tolerated distance between the cycles.
-bool JoystickMonitor::AxisMoved(unsigned int axis) {
-	if (axis > 0 && axis <= axisValues.size()
-			&& std::abs(stick->GetRawAxis(axis) - axisValues[axis - 1])
-					> axisTolerance)
+///One message per button in the mask, lowest first.
+void JoystickMonitor::SendButtons(ComponentBase *component, MessageCommand command, uint32_t buttons) {
+	RobotMessage message;
+
+	memset(&message, 0, sizeof(message));
+	message.command = command;
+	message.params.input.uController = controller;
+
+	while (buttons)
 	{
-		return true;
+		message.params.input.uInput = __builtin_ctz(buttons) + 1;
+		buttons &= buttons - 1;
+		component->SendMessage(&message);
 	}
-	return false;
 }
 
 void JoystickMonitor::SetAxisTolerance(float tolerance) {
@@ -75,3 +152,14 @@ void JoystickMonitor::SetAxisTolerance(float tolerance) {
 float JoystickMonitor::GetAxisTolerance() {
 	return axisTolerance;
 }
+
+///Shapes each axis in the mask, bit n for axis n.
+void JoystickMonitor::SetAxisShape(uint32_t axes, const AxisShape &shape) {
+	for (int i = 0; i < JOYSTICK_AXIS_COUNT; i++)
+	{
+		if (axes & (1u << i))
+		{
+			shapers[i].SetShape(shape);
+		}
+	}
+}
@@ -2,29 +2,90 @@
  * The JoystickMonitor class monitors the inputs of a joystick
  * and can be used to register when a button was pressed or released.
  *
- * the input's ID is 1 greater than its representative location in
- * the vector, which is accounted for in the code.
+ * Update() takes one snapshot of every button, axis and the POV each time a
+ * driver station packet comes in.  Everything else only reads the snapshot, so
+ * asking about an input takes no lock and costs a shift and a mask.
+ *
+ * Buttons are numbered from 1 like GetRawButton(), and button n is bit n - 1 of
+ * the masks.  Axes are numbered from 0 like GetRawAxis().  Asking about an input
+ * the monitor does not watch gives up, released and 0.
+ *
+ * Components can subscribe to the inputs they use instead of being sent the
+ * stick every packet.  Publish() then sends each one a COMMAND_INPUT_BUTTON_PRESSED
+ * or _RELEASED per button edge and one COMMAND_INPUT_AXES_MOVED carrying every axis
+ * when any of its axes moved, and nothing at all while the driver holds steady.
+ * Publish() runs on the main loop, the only task that touches the monitor.
+ *
+ * Axes are shaped as they are read, with the shapes their entries in
+ * INPUT_BINDINGS give them, see InputShaper.h.  Everything from
+ * GetAxis() to the events sees the shaped value.  An axis coming back to rest at 0
+ * always counts as moved, however little it moved, so nothing is left creeping.
  */
 
 #ifndef JOYSTICKMONITOR_H_
 #define JOYSTICKMONITOR_H_
 
+#include <vector>
+
 #include "WPILib.h"
+#include "ComponentBase.h"
+#include "InputBindings.h"
+#include "InputShaper.h"
+#include "RobotParams.h"
+
 class JoystickMonitor {
 public:
-	JoystickMonitor(Joystick*);
+	JoystickMonitor(unsigned controller);
 	~JoystickMonitor();
-	void FinalUpdate();
-	bool ButtonPressed(unsigned int);
-	bool ButtonReleased(unsigned int);
-	bool AxisMoved(unsigned int);
+	void Update();
+	void Subscribe(ComponentBase *component, uint32_t buttons, uint32_t axes);
+	void Publish(double time);
+
+	///Returns true if the target button is down in this snapshot.
+	bool ButtonDown(unsigned int button) const { return (buttonsDown & ButtonBit(button)) != 0; }
+	///Returns true if the target button was up in the previous snapshot but is down in this one.
+	bool ButtonPressed(unsigned int button) const { return (buttonsPressed & ButtonBit(button)) != 0; }
+	///Returns true if the target button was down in the previous snapshot but is up in this one.
+	bool ButtonReleased(unsigned int button) const { return (buttonsReleased & ButtonBit(button)) != 0; }
+	///Returns true if the axis has moved more than the tolerance since it last did.
+	bool AxisMoved(unsigned int axis) const { return (axesMoved >> AxisIndex(axis)) & 1; }
+	float GetAxis(unsigned int axis) const { return axisValues[AxisIndex(axis)]; }
+	int GetPOV() const { return pov; }
+
 	void SetAxisTolerance(float);
 	float GetAxisTolerance();
+	void SetAxisShape(uint32_t axes, const AxisShape &shape);
+
 private:
-	Joystick *stick;
-	std::vector<bool> buttonsDown;
-	std::vector<float> axisValues;
+	///A component and the masks of the buttons and axes it is sent
+	struct Subscriber {
+		ComponentBase *component;
+		uint32_t buttons;
+		uint32_t axes;
+	};
+
+	unsigned controller;
+	uint32_t port;
+	uint32_t buttonsDown;
+	uint32_t buttonsPressed;
+	uint32_t buttonsReleased;
+	uint32_t axesMoved;
+	float axisValues[JOYSTICK_AXIS_COUNT + 1];		//the extra one is always 0, for bad axis numbers
+	float axisReported[JOYSTICK_AXIS_COUNT];			//each axis where it last counted as moved
+	InputShaper shapers[JOYSTICK_AXIS_COUNT];
+	int pov;
 	float axisTolerance;
+	std::vector<Subscriber> subscribers;
+
+	void SendButtons(ComponentBase *component, MessageCommand command, uint32_t buttons);
+
+	static uint32_t ButtonBit(unsigned int button) {
+		return (button - 1 < (unsigned int)JOYSTICK_BUTTON_COUNT) ? 1u << (button - 1) : 0;
+	}
+
+	static unsigned int AxisIndex(unsigned int axis) {
+		return (axis < (unsigned int)JOYSTICK_AXIS_COUNT) ? axis : JOYSTICK_AXIS_COUNT;
+	}
 };
 
 #endif /* JOYSTICKMONITOR_H_ */
@@ -0,0 +1,66 @@
+/** \file
+ * Kiwi drive kinematics shared by the drive code and the estimators.
+ *
+ * Wheel speeds use the sign convention of the left, right and bottom values KiwiDrive
+ * computes before they are sent to the motors.  A positive common mode turns the robot toward
+ * a larger gyro angle.  Field and robot frames are related by the same rotation KiwiDrive uses
+ * to make driving field-centric.
+ */
+
+#ifndef KIWI_KINEMATICS_H
+#define KIWI_KINEMATICS_H
+
+#include <math.h>
+
+const float KIWI_SIN60 = 0.86602540f;
+const float KIWI_DEG_TO_RAD = 3.1415926535f / 180.0f;
+
+///Surface speed of each wheel
+struct KiwiWheels {
+	float left, right, bottom;
+};
+
+///Robot frame velocity, r is radians/s about the center
+struct KiwiMotion {
+	float x, y, r;
+};
+
+///Wheel speeds to robot motion, fWheelRadius is the distance from the center to each wheel
+inline KiwiMotion KiwiForward(const KiwiWheels &wheels, float fWheelRadius)
+{
+	KiwiMotion motion;
+
+	motion.x = (2.0f / 3.0f) * (wheels.bottom - 0.5f * (wheels.left + wheels.right));
+	motion.y = (wheels.right - wheels.left) / (2.0f * KIWI_SIN60);
+	motion.r = (wheels.left + wheels.right + wheels.bottom) / (3.0f * fWheelRadius);
+	return(motion);
+}
+
+///Robot motion to wheel speeds, the same mix KiwiDrive uses for motor power
+inline KiwiWheels KiwiInverse(const KiwiMotion &motion, float fWheelRadius)
+{
+	KiwiWheels wheels;
+	float fSpin = motion.r * fWheelRadius;
+
+	wheels.left = -0.5f * motion.x - KIWI_SIN60 * motion.y + fSpin;
+	wheels.right = -0.5f * motion.x + KIWI_SIN60 * motion.y + fSpin;
+	wheels.bottom = motion.x + fSpin;
+	return(wheels);
+}
+
+inline void KiwiFieldToRobot(float fHeadingRad, float &x, float &y)
+{
+	float c = cosf(fHeadingRad);
+	float s = sinf(fHeadingRad);
+	float fx = x;
+
+	x = fx * c - y * s;
+	y = fx * s + y * c;
+}
+
+inline void KiwiRobotToField(float fHeadingRad, float &x, float &y)
+{
+	KiwiFieldToRobot(-fHeadingRad, x, y);
+}
+
+#endif //KIWI_KINEMATICS_H
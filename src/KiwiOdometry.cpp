@@ -0,0 +1,138 @@
+/** \file
+ * Wheel encoder and gyro odometry for the kiwi base.
+ *
+ * The gyro is trusted for heading, the wheels only for translation.  A reset is requested
+ * from any task and takes effect on the next sensor tick so the pose only ever has one
+ * writer.
+ */
+
+#include "KiwiOdometry.h"
+#include "Blackboard.h"
+
+#include <string.h>
+
+KiwiOdometry *KiwiOdometry::pInstance = NULL;
+
+KiwiOdometry::KiwiOdometry(StateEstimator *estimator,
+		CANTalon *leftMotor, CANTalon *rightMotor, CANTalon *bottomMotor)
+{
+	this->estimator = estimator;
+	this->leftMotor = leftMotor;
+	this->rightMotor = rightMotor;
+	this->bottomMotor = bottomMotor;
+
+	memset(&pose, 0, sizeof(pose));
+	bResetRequested.store(false);
+	fResetX.store(0.0);
+	fResetY.store(0.0);
+	bRebaseRequested.store(false);
+	fRebaseHeading.store(0.0);
+	bHavePrevious = false;
+	iLastLeft = 0;
+	iLastRight = 0;
+	iLastBottom = 0;
+
+	// register after the estimator so we use this tick's heading
+
+	iSensor = SensorSampler::GetInstance()->Register("KiwiOdometry",
+			&KiwiOdometry::Sample, this, ODOMETRY_RATE);
+	pInstance = this;
+}
+
+KiwiOdometry::~KiwiOdometry()
+{
+	SensorSampler::GetInstance()->Enable(iSensor, false);
+
+	if(pInstance == this)
+	{
+		pInstance = NULL;
+	}
+}
+
+///The latest pose, from the blackboard; false before the first tick
+bool KiwiOdometry::GetPose(RobotPose &pose) const
+{
+	return(Blackboard::GetInstance()->pose.Read(pose));
+}
+
+///Moves the robot to (x, y) on the next tick, safe from any task
+void KiwiOdometry::Reset(float x, float y)
+{
+	fResetX.store(x);
+	fResetY.store(y);
+	bResetRequested.store(true);
+}
+
+/** Keeps the pose in the gyro's frame after fRemoved degrees were taken off the gyro.
+ *
+ * The position is turned with the frame on the next tick, safe from any task.
+ */
+void KiwiOdometry::Rebase(float fRemoved)
+{
+	float fHeading = fRebaseHeading.load();
+
+	while(!fRebaseHeading.compare_exchange_weak(fHeading, fHeading + fRemoved));
+	bRebaseRequested.store(true);
+}
+
+bool KiwiOdometry::Sample(void *pThis, SensorSample &sample)
+{
+	((KiwiOdometry *)pThis)->Update(sample);
+	return(true);
+}
+
+void KiwiOdometry::Update(SensorSample &sample)
+{
+	int iLeft = leftMotor->GetEncPosition();
+	int iRight = rightMotor->GetEncPosition();
+	int iBottom = bottomMotor->GetEncPosition();
+	float fHeading = estimator->GetHeading();
+
+	// a zeroed gyro turns the field frame, turn the pose with it before anything new goes in
+
+	if(bRebaseRequested.exchange(false))
+	{
+		float fRemoved = fRebaseHeading.exchange(0.0);
+
+		KiwiRobotToField(-fRemoved * KIWI_DEG_TO_RAD, pose.x, pose.y);
+		pose.fHeading -= fRemoved;
+		bHavePrevious = false;
+	}
+
+	if(bResetRequested.exchange(false))
+	{
+		pose.x = fResetX.load();
+		pose.y = fResetY.load();
+		bHavePrevious = false;
+	}
+
+	if(bHavePrevious)
+	{
+		KiwiWheels wheels;
+		KiwiMotion motion;
+
+		wheels.left = (iLeft - iLastLeft) * DRIVETRAIN_INCHES_PER_COUNT;
+		wheels.right = (iRight - iLastRight) * DRIVETRAIN_INCHES_PER_COUNT;
+		wheels.bottom = (iBottom - iLastBottom) * DRIVETRAIN_INCHES_PER_COUNT;
+		motion = KiwiForward(wheels, DRIVETRAIN_BASE_RADIUS);
+
+		// the robot turned during the tick, so use the heading half way through it
+
+		KiwiRobotToField(0.5 * (pose.fHeading + fHeading) * KIWI_DEG_TO_RAD, motion.x, motion.y);
+		pose.x += motion.x;
+		pose.y += motion.y;
+	}
+
+	iLastLeft = iLeft;
+	iLastRight = iRight;
+	iLastBottom = iBottom;
+	bHavePrevious = true;
+
+	pose.fTime = sample.fTime;
+	pose.fHeading = fHeading;
+	Blackboard::GetInstance()->pose.Write(pose);
+
+	sample.fValue[0] = pose.x;
+	sample.fValue[1] = pose.y;
+	sample.fValue[2] = pose.fHeading;
+}
@@ -0,0 +1,68 @@
+/** \file
+ * Wheel encoder and gyro odometry for the kiwi base.
+ *
+ * Runs on the sensor task at the control rate.  Each tick the change in the three wheel
+ * encoders goes through the kiwi forward kinematics to get how far the robot moved in its own
+ * frame, which is rotated into the field frame using the gyro heading halfway through the
+ * tick and added to the pose.
+ */
+
+#ifndef KIWI_ODOMETRY_H
+#define KIWI_ODOMETRY_H
+
+#include <atomic>
+
+#include "WPILib.h"
+
+#include "SensorSampler.h"
+#include "StateEstimator.h"
+#include "KiwiKinematics.h"
+#include "RobotParams.h"
+
+///Where the robot is on the field
+struct RobotPose {
+	double fTime;			//!< sampler clock, seconds
+	float x;				//!< inches, field frame
+	float y;				//!< inches, field frame
+	float fHeading;			//!< degrees, same sense as the gyro
+};
+
+class KiwiOdometry
+{
+public:
+	KiwiOdometry(StateEstimator *estimator,
+			CANTalon *leftMotor, CANTalon *rightMotor, CANTalon *bottomMotor);
+	~KiwiOdometry();
+
+	static KiwiOdometry *GetInstance() { return(pInstance); };
+
+	bool GetPose(RobotPose &pose) const;
+	int GetSensor() const { return(iSensor); };	//sampler id, samples hold x, y and heading
+	void Reset(float x = 0.0, float y = 0.0);
+	void Rebase(float fRemoved);
+
+private:
+	static KiwiOdometry *pInstance;
+
+	StateEstimator *estimator;
+	CANTalon *leftMotor;
+	CANTalon *rightMotor;
+	CANTalon *bottomMotor;
+
+	RobotPose pose;
+	std::atomic<bool> bResetRequested;
+	std::atomic<float> fResetX;
+	std::atomic<float> fResetY;
+	std::atomic<bool> bRebaseRequested;
+	std::atomic<float> fRebaseHeading;	//degrees taken off the gyro since the last tick
+	bool bHavePrevious;
+	int iLastLeft;
+	int iLastRight;
+	int iLastBottom;
+	int iSensor;
+
+	static bool Sample(void *pThis, SensorSample &sample);
+	void Update(SensorSample &sample);
+};
+
+#endif //KIWI_ODOMETRY_H
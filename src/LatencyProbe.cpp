@@ -0,0 +1,211 @@
+/** \file
+ * Joystick to motor latency, to find out where a robot that feels laggy loses its time.
+ *
+ * Tracing a command is a few stores while the probe is on and one test of a flag while it is
+ * off.  Samples go into a fixed table for each stage, and the percentiles are only worked out
+ * by sorting a copy when Report() is called.
+ */
+
+#include "LatencyProbe.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "RobotClock.h"
+
+LatencyProbe *LatencyProbe::pInstance = NULL;
+
+static const char *szStageNames[LATENCY_STAGES] = { "input", "main loop", "queue", "drive", "total" };
+
+LatencyProbe *LatencyProbe::GetInstance()
+{
+	static pthread_mutex_t instanceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+	pthread_mutex_lock(&instanceMutex);
+
+	if(pInstance == NULL)
+	{
+		pInstance = new LatencyProbe();
+	}
+
+	pthread_mutex_unlock(&instanceMutex);
+	return(pInstance);
+}
+
+LatencyProbe::LatencyProbe()
+{
+	pthread_mutex_init(&probeMutex, NULL);
+	bEnabled = false;
+	bPending = false;
+	fPendingInput = 0.0;
+	memset(uSamples, 0, sizeof(uSamples));
+	uDropped = 0;
+}
+
+///Turning it on forgets the last report's samples
+void LatencyProbe::Enable(bool bEnable)
+{
+	pthread_mutex_lock(&probeMutex);
+
+	if(bEnable && !bEnabled)
+	{
+		memset(uSamples, 0, sizeof(uSamples));
+		uDropped = 0;
+		bPending = false;
+	}
+
+	bEnabled = bEnable;
+	pthread_mutex_unlock(&probeMutex);
+}
+
+///An axis was just moved at fTime, the next command that changes is timed from here
+void LatencyProbe::MarkInput(double fTime)
+{
+	pthread_mutex_lock(&probeMutex);
+	bPending = true;
+	fPendingInput = fTime;
+	pthread_mutex_unlock(&probeMutex);
+}
+
+/** Called by the main loop just before it sends an axes event, fLoop is when it saw the packet.
+ *
+ * Only axes that moved past the monitor's tolerance make an event, so every one is traced.
+ */
+void LatencyProbe::Stamp(LatencyStamp &stamp, double fLoop)
+{
+	stamp.bTraced = false;
+
+	if(!bEnabled)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&probeMutex);
+	stamp.bTraced = true;
+	stamp.bInput = bPending && (fPendingInput <= fLoop);
+	stamp.fInput = stamp.bInput ? fPendingInput : fLoop;
+	stamp.fLoop = fLoop;
+	stamp.fSent = RobotClock::GetTime();
+	bPending = false;
+	pthread_mutex_unlock(&probeMutex);
+}
+
+///Called by the drivetrain once the motors are set, fReceived is when Run() got the command
+void LatencyProbe::Trace(const LatencyStamp &stamp, double fReceived)
+{
+	double fDone = RobotClock::GetTime();
+	double fStage[LATENCY_STAGES];
+
+	if(!stamp.bTraced || !bEnabled)
+	{
+		return;
+	}
+
+	fStage[LATENCY_STAGE_INPUT] = stamp.fLoop - stamp.fInput;
+	fStage[LATENCY_STAGE_LOOP] = stamp.fSent - stamp.fLoop;
+	fStage[LATENCY_STAGE_QUEUE] = fReceived - stamp.fSent;
+	fStage[LATENCY_STAGE_DRIVE] = fDone - fReceived;
+	fStage[LATENCY_STAGE_TOTAL] = fDone - stamp.fInput;
+
+	pthread_mutex_lock(&probeMutex);
+
+	if(uSamples[LATENCY_STAGE_TOTAL] >= LATENCY_MAX_SAMPLES)
+	{
+		uDropped++;
+	}
+	else
+	{
+		for(int i = 0; i < LATENCY_STAGES; i++)
+		{
+			// without a marked input there is nothing to say about the first stage
+
+			if((i != LATENCY_STAGE_INPUT) || stamp.bInput)
+			{
+				fSamples[i][uSamples[i]++] = fStage[i];
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&probeMutex);
+}
+
+/** Prints p50, p99 and the worst of each stage in ms and writes the same to szFileName.
+ *
+ * Returns false if there was nothing to report.
+ */
+bool LatencyProbe::Report(const char *szFileName)
+{
+	static float fSorted[LATENCY_MAX_SAMPLES];		//only the main loop reports
+	unsigned uCount[LATENCY_STAGES];
+	double fPercentile[LATENCY_STAGES][3];
+	unsigned uDrop;
+	FILE *pFile;
+
+	pthread_mutex_lock(&probeMutex);
+	memcpy(uCount, uSamples, sizeof(uCount));
+	uDrop = uDropped;
+
+	if(uCount[LATENCY_STAGE_TOTAL] == 0)
+	{
+		pthread_mutex_unlock(&probeMutex);
+		return(false);
+	}
+
+	for(int i = 0; i < LATENCY_STAGES; i++)
+	{
+		unsigned n = uCount[i];
+
+		memcpy(fSorted, fSamples[i], n * sizeof(float));
+		std::sort(fSorted, fSorted + n);
+
+		// nearest rank, so p99 of a short run is a sample that really happened
+
+		fPercentile[i][0] = n ? fSorted[(n + 1) / 2 - 1] : 0.0;
+		fPercentile[i][1] = n ? fSorted[(unsigned)ceil(0.99 * n) - 1] : 0.0;
+		fPercentile[i][2] = n ? fSorted[n - 1] : 0.0;
+	}
+
+	pthread_mutex_unlock(&probeMutex);
+
+	pFile = fopen(szFileName, "w");
+
+	if(pFile != NULL)
+	{
+		fprintf(pFile, "stage,samples,p50_ms,p99_ms,max_ms\n");
+	}
+
+	printf("Latency: %u drive commands, ms p50 / p99 / max, in %s\n", uCount[LATENCY_STAGE_TOTAL], szFileName);
+
+	for(int i = 0; i < LATENCY_STAGES; i++)
+	{
+		if(uCount[i] == 0)
+		{
+			printf("  %-10s not measured, nothing marked the input\n", szStageNames[i]);
+			continue;
+		}
+
+		printf("  %-10s %7.2f %7.2f %7.2f\n", szStageNames[i], fPercentile[i][0] * 1000.0,
+				fPercentile[i][1] * 1000.0, fPercentile[i][2] * 1000.0);
+
+		if(pFile != NULL)
+		{
+			fprintf(pFile, "%s,%u,%0.3f,%0.3f,%0.3f\n", szStageNames[i], uCount[i],
+					fPercentile[i][0] * 1000.0, fPercentile[i][1] * 1000.0, fPercentile[i][2] * 1000.0);
+		}
+	}
+
+	if(uDrop > 0)
+	{
+		printf("Latency: %u more commands were not kept\n", uDrop);
+	}
+
+	if(pFile != NULL)
+	{
+		fclose(pFile);
+	}
+
+	return(true);
+}
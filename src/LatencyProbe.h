@@ -0,0 +1,62 @@
+/** \file
+ * Joystick to motor latency, to find out where a robot that feels laggy loses its time.
+ *
+ * An axes event from the JoystickMonitor carries a LatencyStamp from the main loop to the
+ * drivetrain, which hands it back here once its motors have been set.  The first stage, from the axis
+ * changing to the main loop seeing the packet, is only known when whatever moved the axis said
+ * when with MarkInput(), as the simulation does.  On the robot the trace starts at the main
+ * loop.
+ *
+ * The probe is off unless the "Latency Probe" dashboard flag is set when teleop starts, and
+ * the report is printed and written when teleop ends.  All times are on the robot clock.
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <pthread.h>
+
+#include "RobotMessage.h"
+#include "RobotParams.h"
+
+const unsigned LATENCY_MAX_SAMPLES = 4096;		//commands kept per teleop, the rest are counted
+const char* const LATENCY_ENABLE_KEY = "Latency Probe";
+const char* const LATENCY_REPORT_FILEPATH = ROBOT_HOME "/Latency.csv";	//rewritten after every teleop
+
+typedef enum LatencyStage
+{
+	LATENCY_STAGE_INPUT,			//!< axis change to the main loop seeing the packet
+	LATENCY_STAGE_LOOP,				//!< main loop to the command going into the drivetrain queue
+	LATENCY_STAGE_QUEUE,			//!< waiting in the queue until Drivetrain::Run() gets it
+	LATENCY_STAGE_DRIVE,			//!< KiwiDrive() through the last CANTalon::Set()
+	LATENCY_STAGE_TOTAL,			//!< first stamp to the motors
+	LATENCY_STAGES
+} LatencyStage;
+
+class LatencyProbe
+{
+public:
+	static LatencyProbe *GetInstance();
+
+	void Enable(bool bEnable);
+	bool IsEnabled() { return(bEnabled); };
+	void MarkInput(double fTime);
+	void Stamp(LatencyStamp &stamp, double fLoop);
+	void Trace(const LatencyStamp &stamp, double fReceived);
+	bool Report(const char *szFileName);
+
+private:
+	static LatencyProbe *pInstance;
+
+	pthread_mutex_t probeMutex;			//stamps and traces come from different tasks
+	volatile bool bEnabled;
+	bool bPending;						//MarkInput() has not been claimed by a command yet
+	double fPendingInput;
+	float fSamples[LATENCY_STAGES][LATENCY_MAX_SAMPLES];	//seconds
+	unsigned uSamples[LATENCY_STAGES];
+	unsigned uDropped;
+
+	LatencyProbe();
+};
+
+#endif //LATENCY_PROBE_H
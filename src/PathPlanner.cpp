@@ -0,0 +1,344 @@
+/** \file
+ * Background trajectory generation.
+ *
+ * Entries move from queued to working to ready (or failed).  Only the task that marked an
+ * entry working touches its trajectory until it is ready, so generation happens without
+ * holding the lock.  Generating only while disabled keeps the planner from competing with the
+ * control loops.  A path needed early is built by whoever asks for it, but only while still
+ * disabled, an enabled robot fails the PATH rather than stall its script.
+ */
+
+#include "PathPlanner.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "RobotClock.h"
+#include "RobotParams.h"
+#include "TimerWheel.h"
+#include "TeachRecorder.h"
+
+PathPlanner *PathPlanner::pInstance = NULL;
+
+PathPlanner *PathPlanner::GetInstance()
+{
+	if(pInstance == NULL)
+	{
+		pInstance = new PathPlanner();
+	}
+
+	return(pInstance);
+}
+
+PathPlanner::PathPlanner()
+{
+	for(int i = 0; i < PATH_MAX_PATHS; i++)
+	{
+		paths[i].uKey = 0;
+		paths[i].state = PATH_EMPTY;
+		paths[i].uAge = 0;
+		paths[i].uUsers = 0;
+	}
+
+	uRequests = 0;
+	pthread_mutex_init(&planMutex, NULL);
+	RobotClock::InitCondition(&planCond);
+	mkdir(PATH_CACHE_DIR, 0777);
+
+	pTask = new Task(PATHPLAN_TASKNAME, (FUNCPTR) &PathPlanner::StartTask,
+			PATHPLAN_PRIORITY, PATHPLAN_STACKSIZE);
+	wpi_assert(pTask);
+	pTask->Start((intptr_t)this);
+}
+
+PathPlanner::~PathPlanner()
+{
+	delete(pTask);
+	pthread_cond_destroy(&planCond);
+	pthread_mutex_destroy(&planMutex);
+}
+
+///Called with the lock held
+int PathPlanner::Find(uint64_t uKey)
+{
+	for(int i = 0; i < PATH_MAX_PATHS; i++)
+	{
+		if((paths[i].state != PATH_EMPTY) && (paths[i].uKey == uKey))
+		{
+			return(i);
+		}
+	}
+
+	return(-1);
+}
+
+///Finds an entry for a new key, dropping the one asked for longest ago, called with the lock held
+int PathPlanner::Allocate(uint64_t uKey)
+{
+	int iEntry = -1;
+
+	for(int i = 0; i < PATH_MAX_PATHS; i++)
+	{
+		if((paths[i].state == PATH_WORKING) || (paths[i].uUsers > 0))
+		{
+			continue;
+		}
+
+		if((iEntry < 0) || (paths[i].state == PATH_EMPTY) ||
+				((paths[iEntry].state != PATH_EMPTY) && (paths[i].uAge < paths[iEntry].uAge)))
+		{
+			iEntry = i;
+		}
+	}
+
+	if(iEntry >= 0)
+	{
+		paths[iEntry].uKey = uKey;
+		paths[iEntry].state = PATH_QUEUED;
+		paths[iEntry].fileName.clear();
+		paths[iEntry].waypoints.clear();
+	}
+
+	return(iEntry);
+}
+
+/** Queues a path to be generated and returns the key to Get() it with.
+ *
+ * Asking for a path we already have costs nothing.  When the table is full the path asked
+ * for longest ago is dropped.
+ */
+uint64_t PathPlanner::Request(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+		const TrajectoryLimits &limits)
+{
+	uint64_t uKey = Trajectory::MakeKey(pWaypoints, uWaypoints, limits);
+	int iEntry;
+
+	pthread_mutex_lock(&planMutex);
+
+	iEntry = Find(uKey);
+
+	if(iEntry < 0)
+	{
+		iEntry = Allocate(uKey);
+
+		if(iEntry < 0)
+		{
+			pthread_mutex_unlock(&planMutex);
+			return(uKey);
+		}
+
+		paths[iEntry].waypoints.assign(pWaypoints, pWaypoints + uWaypoints);
+		paths[iEntry].limits = limits;
+		RobotClock::Broadcast(&planCond);
+	}
+
+	paths[iEntry].uAge = ++uRequests;
+	pthread_mutex_unlock(&planMutex);
+	return(uKey);
+}
+
+///Queues a trajectory file from the cache directory to be mapped, returns the key to Get() it with
+uint64_t PathPlanner::RequestFile(const char *szName)
+{
+	uint64_t uKey = Trajectory::MakeKey(szName);
+	int iEntry;
+
+	pthread_mutex_lock(&planMutex);
+
+	iEntry = Find(uKey);
+
+	if(iEntry < 0)
+	{
+		iEntry = Allocate(uKey);
+
+		if(iEntry < 0)
+		{
+			pthread_mutex_unlock(&planMutex);
+			return(uKey);
+		}
+
+		paths[iEntry].fileName = szName;
+		RobotClock::Broadcast(&planCond);
+	}
+
+	paths[iEntry].uAge = ++uRequests;
+	pthread_mutex_unlock(&planMutex);
+	return(uKey);
+}
+
+///Reads a file from RequestFile() again, unless it is being followed right now
+void PathPlanner::Reload(const char *szName)
+{
+	int iEntry;
+
+	pthread_mutex_lock(&planMutex);
+
+	iEntry = Find(Trajectory::MakeKey(szName));
+
+	if((iEntry >= 0) && (paths[iEntry].state != PATH_WORKING) && (paths[iEntry].uUsers == 0))
+	{
+		paths[iEntry].state = PATH_QUEUED;
+		RobotClock::Broadcast(&planCond);
+	}
+
+	pthread_mutex_unlock(&planMutex);
+}
+
+/** Returns the trajectory for uKey, or NULL if it was never requested or cannot be built.
+ *
+ * If the planner has not got to it yet it is built now while the robot is disabled, and
+ * NULL is returned for a PATH once it is enabled.  The trajectory stays put until it is given back with
+ * Release().
+ */
+const Trajectory *PathPlanner::Get(uint64_t uKey)
+{
+	const Trajectory *pTrajectory = NULL;
+	int iEntry;
+
+	pthread_mutex_lock(&planMutex);
+
+	iEntry = Find(uKey);
+
+	// generating takes far longer than a control loop has, so once enabled a path not yet
+	// planned is not there at all, reading a file is quick enough to still do here
+
+	if((iEntry >= 0) && (paths[iEntry].state == PATH_QUEUED) && paths[iEntry].fileName.empty() &&
+			!DriverStation::GetInstance()->IsDisabled())
+	{
+		printf("PathPlanner: %016llx was not planned before the robot was enabled\n",
+				(unsigned long long)uKey);
+		pthread_mutex_unlock(&planMutex);
+		return(NULL);
+	}
+
+	if((iEntry >= 0) && (paths[iEntry].state == PATH_QUEUED))
+	{
+		printf("PathPlanner: %016llx was not ready\n", (unsigned long long)uKey);
+		paths[iEntry].state = PATH_WORKING;
+		pthread_mutex_unlock(&planMutex);
+
+		PathState state = Build(paths[iEntry]);
+
+		pthread_mutex_lock(&planMutex);
+		paths[iEntry].state = state;
+		RobotClock::Broadcast(&planCond);
+	}
+
+	while((iEntry >= 0) && (paths[iEntry].state == PATH_WORKING))
+	{
+		RobotClock::GetInstance()->WaitCondition(&planCond, &planMutex, CLOCK_FOREVER);
+	}
+
+	if((iEntry >= 0) && (paths[iEntry].state == PATH_READY) && (paths[iEntry].uKey == uKey))
+	{
+		pTrajectory = &paths[iEntry].trajectory;
+		paths[iEntry].uUsers++;
+	}
+
+	pthread_mutex_unlock(&planMutex);
+	return(pTrajectory);
+}
+
+///Gives back a trajectory from Get(), NULL is ignored
+void PathPlanner::Release(const Trajectory *pTrajectory)
+{
+	pthread_mutex_lock(&planMutex);
+
+	for(int i = 0; i < PATH_MAX_PATHS; i++)
+	{
+		if((&paths[i].trajectory == pTrajectory) && (paths[i].uUsers > 0))
+		{
+			paths[i].uUsers--;
+		}
+	}
+
+	pthread_mutex_unlock(&planMutex);
+}
+
+///Reads the trajectory from the cache or generates and saves it, the entry must be ours
+PathPlanner::PathState PathPlanner::Build(PathEntry &entry)
+{
+	char szFileName[128];
+	double fStart = TimerWheel::GetTime();
+	bool bOk;
+
+	if(!entry.fileName.empty())
+	{
+		snprintf(szFileName, sizeof(szFileName), "%s/%s", PATH_CACHE_DIR, entry.fileName.c_str());
+
+		if(entry.trajectory.Load(szFileName, TRAJECTORY_ANY_KEY) ||
+				TeachRecorder::Load(szFileName, entry.trajectory))
+		{
+			return(PATH_READY);
+		}
+
+		printf("PathPlanner: cannot load %s\n", szFileName);
+		return(PATH_FAILED);
+	}
+
+	snprintf(szFileName, sizeof(szFileName), "%s/%016llx.traj", PATH_CACHE_DIR,
+			(unsigned long long)entry.uKey);
+
+	if(entry.trajectory.Load(szFileName, entry.uKey))
+	{
+		return(PATH_READY);
+	}
+
+	bOk = entry.trajectory.Generate(&entry.waypoints[0], entry.waypoints.size(), entry.limits);
+
+	printf("PathPlanner: %016llx %s in %0.1f ms, %u samples, %0.2f s\n", (unsigned long long)entry.uKey,
+			bOk ? "generated" : "failed", (TimerWheel::GetTime() - fStart) * 1000.0,
+			entry.trajectory.GetSize(), entry.trajectory.GetDuration());
+
+	if(bOk && !entry.trajectory.Save(szFileName))
+	{
+		printf("PathPlanner: cannot save %s\n", szFileName);
+	}
+
+	return(bOk ? PATH_READY : PATH_FAILED);
+}
+
+void PathPlanner::DoPlanning()
+{
+	while(true)
+	{
+		int iEntry = -1;
+
+		pthread_mutex_lock(&planMutex);
+
+		while(iEntry < 0)
+		{
+			for(int i = 0; i < PATH_MAX_PATHS; i++)
+			{
+				if((paths[i].state == PATH_QUEUED) && ((iEntry < 0) || (paths[i].uAge < paths[iEntry].uAge)))
+				{
+					iEntry = i;
+				}
+			}
+
+			if(iEntry < 0)
+			{
+				RobotClock::GetInstance()->WaitCondition(&planCond, &planMutex, CLOCK_FOREVER);
+			}
+		}
+
+		// leave the processor to the control loops while the robot is moving
+
+		if(!DriverStation::GetInstance()->IsDisabled())
+		{
+			pthread_mutex_unlock(&planMutex);
+			RobotClock::Delay(PATH_ENABLED_WAIT);
+			continue;
+		}
+
+		paths[iEntry].state = PATH_WORKING;
+		pthread_mutex_unlock(&planMutex);
+
+		PathState state = Build(paths[iEntry]);
+
+		pthread_mutex_lock(&planMutex);
+		paths[iEntry].state = state;
+		RobotClock::Broadcast(&planCond);
+		pthread_mutex_unlock(&planMutex);
+	}
+}
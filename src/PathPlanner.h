@@ -0,0 +1,88 @@
+/** \file
+ * Background trajectory generation.
+ *
+ * When a script is loaded every PATH in it is handed to the planner, which generates the
+ * trajectories on a low priority task while the robot is disabled.  Each one is looked for in
+ * the cache directory first and saved there after it is generated, so a path that has not
+ * changed since the last boot is only read back from disk.  If a trajectory is needed before
+ * the planner got to it, Get() builds it on the spot while disabled and fails once enabled.
+ *
+ * A trajectory made off the robot, or a TeachRecorder recording, is asked for by file name
+ * instead and only read.  Reload() makes the planner read a file again after it changes.  Get()
+ * pins the trajectory it returns so a later request cannot reuse its entry while the
+ * drivetrain is following it; whoever ends up holding it calls Release().
+ */
+
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "WPILib.h"
+
+#include "RobotParams.h"
+#include "Trajectory.h"
+
+const char* const PATH_CACHE_DIR = ROBOT_HOME "/paths";
+const int PATH_MAX_PATHS = 16;
+const float PATH_ENABLED_WAIT = 0.1;	//seconds between checks while the robot is enabled
+
+class PathPlanner
+{
+public:
+	static PathPlanner *GetInstance();
+
+	uint64_t Request(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+			const TrajectoryLimits &limits);
+	uint64_t RequestFile(const char *szName);
+	void Reload(const char *szName);
+	const Trajectory *Get(uint64_t uKey);
+	void Release(const Trajectory *pTrajectory);
+
+	static void *StartTask(void *pThis)
+	{
+		((PathPlanner *)pThis)->DoPlanning();
+		return(NULL);
+	}
+
+private:
+	typedef enum PathState
+	{
+		PATH_EMPTY,
+		PATH_QUEUED,
+		PATH_WORKING,
+		PATH_READY,
+		PATH_FAILED
+	} PathState;
+
+	struct PathEntry {
+		uint64_t uKey;
+		PathState state;
+		unsigned uAge;						//when it was requested, the oldest goes first when we are full
+		unsigned uUsers;					//Get() calls not yet released, the entry cannot be reused
+		std::string fileName;				//set for a trajectory made off the robot
+		std::vector<TrajectoryWaypoint> waypoints;
+		TrajectoryLimits limits;
+		Trajectory trajectory;
+	};
+
+	static PathPlanner *pInstance;
+
+	Task *pTask;
+	pthread_mutex_t planMutex;
+	pthread_cond_t planCond;
+	PathEntry paths[PATH_MAX_PATHS];
+	unsigned uRequests;
+
+	PathPlanner();
+	~PathPlanner();
+
+	int Find(uint64_t uKey);
+	int Allocate(uint64_t uKey);
+	PathState Build(PathEntry &entry);
+	void DoPlanning();
+};
+
+#endif //PATH_PLANNER_H
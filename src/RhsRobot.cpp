@@ -10,12 +10,17 @@
 #include "WPILib.h"
 
 //Robot
+#include "CheckList.h"
 #include "ComponentBase.h"
+#include "LatencyProbe.h"
 #include "RobotParams.h"
 
 RhsRobot::RhsRobot() {
-	Controller_1 = NULL;
-	Monitor_1 = NULL;
+	for(int i = 0; i < INPUT_CONTROLLERS; i++)
+	{
+		Monitors[i] = NULL;
+	}
+
 	drivetrain = NULL;
 	autonomous = NULL;
 
@@ -30,8 +35,10 @@ RhsRobot::~RhsRobot() {
 		delete (*nextComponent);
 	}
 
-	delete Controller_1;
-	delete Monitor_1;
+	for(int i = 0; i < INPUT_CONTROLLERS; i++)
+	{
+		delete Monitors[i];
+	}
 }
 
 void RhsRobot::Init() {
@@ -40,17 +47,29 @@ void RhsRobot::Init() {
 	 * EXAMPLE:	drivetrain = NULL; (in constructor)
 	 * 			drivetrain = new Drivetrain(); (in RhsRobot::Init())
 	 */
-	Controller_1 = new Joystick(0);
-	Monitor_1 = new JoystickMonitor(Controller_1);
-	Monitor_1->SetAxisTolerance(.05);
+	for(int i = 0; i < INPUT_CONTROLLERS; i++)
+	{
+		Monitors[i] = new JoystickMonitor(i);
+		Monitors[i]->SetAxisTolerance(JOYSTICK_AXIS_TOLERANCE);
+	}
+
 	drivetrain = new Drivetrain();
 	autonomous = new Autonomous();
 
+	// publish the latency flag so it can be set from the dashboard, keeping a value already there
+	SmartDashboard::PutBoolean(LATENCY_ENABLE_KEY, SmartDashboard::GetBoolean(LATENCY_ENABLE_KEY, false));
+
 	std::vector<ComponentBase *>::iterator nextComponent = ComponentSet.begin();
 
 	if(drivetrain)
 	{
 		nextComponent = ComponentSet.insert(nextComponent, drivetrain);
+
+		for(int i = 0; i < INPUT_CONTROLLERS; i++)
+		{
+			Monitors[i]->Subscribe(drivetrain, InputMask(i, INPUT_BUTTON, DRIVETRAIN_INPUT_ACTIONS),
+					InputMask(i, INPUT_AXIS, DRIVETRAIN_INPUT_ACTIONS));
+		}
 	}
 
 	if(autonomous)
@@ -62,45 +81,48 @@ void RhsRobot::Init() {
 void RhsRobot::OnStateChange() {
 	std::vector<ComponentBase *>::iterator nextComponent;
 
+	// the latency probe covers one teleop period, reporting is done before anything else runs
+
+	if(robotMessage.command == COMMAND_ROBOT_STATE_TELEOPERATED)
+	{
+		LatencyProbe::GetInstance()->Enable(SmartDashboard::GetBoolean(LATENCY_ENABLE_KEY, false));
+	}
+	else if(LatencyProbe::GetInstance()->IsEnabled())
+	{
+		LatencyProbe::GetInstance()->Enable(false);
+		LatencyProbe::GetInstance()->Report(LATENCY_REPORT_FILEPATH);
+	}
+
 	for(nextComponent = ComponentSet.begin();
 			nextComponent != ComponentSet.end(); ++nextComponent)
 	{
 		(*nextComponent)->SendMessage(&robotMessage);
 	}
+
+	// enabling in test mode in the pits runs the prematch checklist
+
+	if(robotMessage.command == COMMAND_ROBOT_STATE_TEST)
+	{
+		CheckList::GetInstance()->RunCheckList();
+	}
 }
 
 void RhsRobot::Run() {
-	/* Poll for control data and send messages to each subsystem. Surround blocks with if(component) so entire components can be disabled
-	 * by commenting out their construction.
-	 * EXAMPLE: if(drivetrain) 
-	 * 			{ 
-	 * 				//Check joysticks and send messages 
-	 * 			}
+	/* Poll for control data and send messages to each subsystem. Components subscribe to the
+	 * joystick inputs they use in Init(), surround anything else with if(component) so entire
+	 * components can be disabled by commenting out their construction.
 	 */
 
-	if(autonomous)
-	{
-		if(GetCurrentRobotState() == ROBOT_STATE_AUTONOMOUS)
-		{
-			// all messages to components will come from the autonomous task
-			return;
-		}
-	}
+	// one look at each controller per packet, and the components that use it hear only what
+	// changed; they get it in every mode so nothing is stale when teleop starts, and ignore it
+	// outside teleop
 
-	if (drivetrain)
+	for(int i = 0; i < INPUT_CONTROLLERS; i++)
 	{
-		//for keepalign tests: comment out everything to the sendMessage
-		//also comment out the if (ISAUTO) at the bottom of Drivetrain::Run()
-		//robotMessage.command = COMMAND_DRIVETRAIN_START_KEEPALIGN;
-
-		robotMessage.command = COMMAND_DRIVETRAIN_DRIVE_KIWI;
-		robotMessage.params.kiwiDrive.x = KIWI_DRIVE_X;
-		robotMessage.params.kiwiDrive.y = KIWI_DRIVE_Y;
-		robotMessage.params.kiwiDrive.r = KIWI_DRIVE_R;
-		drivetrain->SendMessage(&robotMessage);
+		Monitors[i]->Update();
+		Monitors[i]->Publish(GetControlTime());
 	}
 
-	Monitor_1->FinalUpdate();
 	iLoop++;
 }
 
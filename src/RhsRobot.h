@@ -23,8 +23,7 @@ public:
 private:
 	const float fDriveMax = 1;
 
-	Joystick* Controller_1;
-	JoystickMonitor* Monitor_1;
+	JoystickMonitor* Monitors[INPUT_CONTROLLERS];	//one per controller in InputBindings.h
 	Drivetrain* drivetrain;
 	Autonomous* autonomous;
 
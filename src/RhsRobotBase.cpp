@@ -17,6 +17,8 @@
 //Local
 #include "RobotParams.h"			//For various robot parameters
 #include "Autonomous.h"
+#include "RobotClock.h"
+#include "Blackboard.h"
 
 RhsRobotBase::RhsRobotBase()			//Constructor
 {
@@ -40,6 +42,7 @@ RhsRobotBase::RhsRobotBase()			//Constructor
 	currentRobotState = ROBOT_STATE_UNKNOWN;
 	SmartDashboard::init();
 	loop = 0;			//Initializes the loop counter
+	fControlTime = 0.0;
 }
 
 RhsRobotBase::~RhsRobotBase()			//Destructor
@@ -76,10 +79,12 @@ void RhsRobotBase::StartCompetition()			//Robot's main function
 	{
 		if(!pDS->IsNewControlData())
 		{
-			Wait(0.002);
+			RobotClock::Delay(0.002);
 			continue;
 		}
 
+		fControlTime = RobotClock::GetTime();
+
 		//Checks the current state of the robot
 		if(IsDisabled())
 		{
@@ -133,6 +138,7 @@ void RhsRobotBase::StartCompetition()			//Robot's main function
 				break;
 			}
 
+			Blackboard::GetInstance()->mode.Write(currentRobotState);
 			OnStateChange();			//Handles the state change
 		}
 
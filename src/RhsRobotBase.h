@@ -33,6 +33,7 @@ public:
 	bool HasStateChanged();			//Returns if the robot state has just changed
 
 	int GetLoop();			//Returns the loop number
+	double GetControlTime() { return(fControlTime); };			//Robot clock time the current control packet was noticed
 
 protected:
 	RobotMessage robotMessage;			//Message to be written and sent to components
@@ -46,6 +47,7 @@ private:
 	RobotOpMode previousRobotState;			//Previous robot state
 
 	int loop;			//Loop counter
+	double fControlTime;			//When the main loop saw the current control packet
 
 	void StartCompetition();			//Robot's main function
 };
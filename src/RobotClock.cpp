@@ -0,0 +1,473 @@
+/** \file
+ * The one clock every task reads and sleeps on.
+ *
+ * The real and scaled clocks turn a deadline on the robot clock into a monotonic deadline and
+ * let the kernel do the waiting.  The stepped clock keeps the tasks waiting on it in a line and
+ * wakes them itself, one at a time.  A task counts as running from the moment it leaves a wait
+ * until it waits again.  Files are polled by Step() instead of the tasks reading them, and a
+ * stepped wait on a condition variable never touches the condition, Signal() and Broadcast()
+ * mark the waiters in line instead.  A wait that is already over returns without giving up the
+ * run.
+ */
+
+#include "RobotClock.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <time.h>
+
+RobotClock *RobotClock::pInstance = NULL;
+
+static double GetMonotonic()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return(now.tv_sec + now.tv_nsec * 1.0e-9);
+}
+
+static struct timespec ToTimespec(double fTime)
+{
+	struct timespec time;
+
+	fTime = fmax(fTime, 0.0);
+	time.tv_sec = (time_t)fTime;
+	time.tv_nsec = (long)((fTime - time.tv_sec) * 1.0e9);
+
+	if(time.tv_nsec >= 1000000000)
+	{
+		time.tv_sec++;
+		time.tv_nsec -= 1000000000;
+	}
+
+	return(time);
+}
+
+RobotClock *RobotClock::GetInstance()
+{
+	static pthread_mutex_t instanceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+	if(pInstance == NULL)
+	{
+		pthread_mutex_lock(&instanceMutex);
+
+		if(pInstance == NULL)
+		{
+			pInstance = new RealClock();
+		}
+
+		pthread_mutex_unlock(&instanceMutex);
+	}
+
+	return(pInstance);
+}
+
+///Only before the first task starts, everything keeps the clock it first saw
+void RobotClock::Set(RobotClock *pClock)
+{
+	pInstance = pClock;
+}
+
+///Makes a condition variable WaitCondition() can time out on
+void RobotClock::InitCondition(pthread_cond_t *pCond)
+{
+	pthread_condattr_t condAttr;
+
+	// sleep against the monotonic clock so setting the date cannot move a deadline
+
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(pCond, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+}
+
+ScaledClock::ScaledClock(double fScale)
+{
+	this->fScale = fScale;
+	fRealStart = GetMonotonic();
+	fStart = 0.0;
+}
+
+double ScaledClock::Now()
+{
+	return(fStart + (GetMonotonic() - fRealStart) * fScale);
+}
+
+///The monotonic time robot time reaches fDeadline
+double ScaledClock::ToReal(double fDeadline)
+{
+	return(fRealStart + (fDeadline - fStart) / fScale);
+}
+
+void ScaledClock::SleepUntil(double fDeadline)
+{
+	struct timespec wake = ToTimespec(ToReal(fDeadline));
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+	{
+		// intentionally empty
+	}
+}
+
+bool ScaledClock::WaitReadable(int iFile, double fDeadline)
+{
+	fd_set selectSet;
+	struct timeval timeout;
+	double fTimeout;
+
+	FD_ZERO(&selectSet);
+	FD_SET(iFile, &selectSet);
+
+	if(fDeadline < 0.0)
+	{
+		return(select(iFile + 1, &selectSet, NULL, NULL, NULL) > 0);
+	}
+
+	fTimeout = fmax(ToReal(fDeadline) - GetMonotonic(), 0.0);
+	timeout.tv_sec = (long)fTimeout;
+	timeout.tv_usec = (long)((fTimeout - timeout.tv_sec) * 1000000.0);
+
+	return(select(iFile + 1, &selectSet, NULL, NULL, &timeout) > 0);
+}
+
+void ScaledClock::WaitCondition(pthread_cond_t *pCond, pthread_mutex_t *pMutex, double fDeadline)
+{
+	struct timespec wake;
+
+	if(fDeadline < 0.0)
+	{
+		pthread_cond_wait(pCond, pMutex);
+		return;
+	}
+
+	wake = ToTimespec(ToReal(fDeadline));
+	pthread_cond_timedwait(pCond, pMutex, &wake);
+}
+
+void ScaledClock::Wake(pthread_cond_t *pCond, bool bAll)
+{
+	if(bAll)
+	{
+		pthread_cond_broadcast(pCond);
+	}
+	else
+	{
+		pthread_cond_signal(pCond);
+	}
+}
+
+RealClock::RealClock() : ScaledClock(1.0)
+{
+	fRealStart = 0.0;
+	fStart = 0.0;
+}
+
+// whether this thread left a stepped wait and is counted in uRunning
+static thread_local bool bCounted = false;
+
+SteppedClock::SteppedClock(double fStart)
+{
+	pthread_mutex_init(&stepMutex, NULL);
+	RobotClock::InitCondition(&settleCond);
+	fNow = fStart;
+	uRunning = 0;
+	uTasks = 0;
+	uJoined = 0;
+	pWaiters = NULL;
+	bWarned = false;
+}
+
+SteppedClock::~SteppedClock()
+{
+	pthread_cond_destroy(&settleCond);
+	pthread_mutex_destroy(&stepMutex);
+}
+
+double SteppedClock::Now()
+{
+	double fTime;
+
+	pthread_mutex_lock(&stepMutex);
+	fTime = fNow;
+	pthread_mutex_unlock(&stepMutex);
+	return(fTime);
+}
+
+///Called with stepMutex held as a task starts waiting, it goes to the back of the line
+void SteppedClock::Enter(Waiter &waiter)
+{
+	Waiter **ppLast = &pWaiters;
+
+	if(bCounted)
+	{
+		bCounted = false;
+
+		if((uRunning > 0) && (--uRunning == 0))
+		{
+			pthread_cond_broadcast(&settleCond);
+		}
+	}
+
+	while(*ppLast != NULL)
+	{
+		ppLast = &(*ppLast)->pNext;
+	}
+
+	waiter.bSignalled = false;
+	waiter.bReleased = false;
+	waiter.pNext = NULL;
+	pthread_cond_init(&waiter.wake, NULL);
+	*ppLast = &waiter;
+}
+
+///Called with stepMutex held, sleeps until Step() releases the task and takes it out of line
+void SteppedClock::Park(Waiter &waiter)
+{
+	while(!waiter.bReleased)
+	{
+		pthread_cond_wait(&waiter.wake, &stepMutex);
+	}
+
+	for(Waiter **ppWaiter = &pWaiters; *ppWaiter != NULL; ppWaiter = &(*ppWaiter)->pNext)
+	{
+		if(*ppWaiter == &waiter)
+		{
+			*ppWaiter = waiter.pNext;
+			break;
+		}
+	}
+
+	pthread_cond_destroy(&waiter.wake);
+	bCounted = true;
+}
+
+///Whether a waiting task has something to do, called with stepMutex held
+bool SteppedClock::IsRunnable(const Waiter &waiter)
+{
+	struct pollfd file;
+
+	if(waiter.bSignalled || ((waiter.fDeadline >= 0.0) && (waiter.fDeadline <= fNow)))
+	{
+		return(true);
+	}
+
+	if(waiter.iFile < 0)
+	{
+		return(false);
+	}
+
+	file.fd = waiter.iFile;
+	file.events = POLLIN;
+	file.revents = 0;
+	return(poll(&file, 1, 0) > 0);
+}
+
+void SteppedClock::SleepUntil(double fDeadline)
+{
+	Waiter waiter;
+
+	waiter.fDeadline = fDeadline;
+	waiter.iFile = -1;
+	waiter.pCond = NULL;
+
+	pthread_mutex_lock(&stepMutex);
+
+	// a deadline already gone by keeps the run, like a sleep of nothing would
+
+	if((fDeadline < 0.0) || (fNow < fDeadline))
+	{
+		Enter(waiter);
+		Park(waiter);
+	}
+
+	pthread_mutex_unlock(&stepMutex);
+}
+
+bool SteppedClock::WaitReadable(int iFile, double fDeadline)
+{
+	Waiter waiter;
+	struct pollfd file;
+
+	waiter.fDeadline = fDeadline;
+	waiter.iFile = iFile;
+	waiter.pCond = NULL;
+	file.fd = iFile;
+	file.events = POLLIN;
+	file.revents = 0;
+
+	pthread_mutex_lock(&stepMutex);
+
+	if((poll(&file, 1, 0) <= 0) && ((fDeadline < 0.0) || (fNow < fDeadline)))
+	{
+		Enter(waiter);
+		Park(waiter);
+		file.revents = 0;
+		poll(&file, 1, 0);
+	}
+
+	pthread_mutex_unlock(&stepMutex);
+	return((file.revents & POLLIN) != 0);
+}
+
+void SteppedClock::WaitCondition(pthread_cond_t *pCond, pthread_mutex_t *pMutex, double fDeadline)
+{
+	Waiter waiter;
+
+	waiter.fDeadline = fDeadline;
+	waiter.iFile = -1;
+	waiter.pCond = pCond;
+
+	pthread_mutex_lock(&stepMutex);
+
+	if((fDeadline >= 0.0) && (fNow >= fDeadline))
+	{
+		pthread_mutex_unlock(&stepMutex);
+		return;
+	}
+
+	// nothing else runs while we wait, so pMutex can be let go of once we are in line
+
+	Enter(waiter);
+	pthread_mutex_unlock(pMutex);
+	Park(waiter);
+	pthread_mutex_unlock(&stepMutex);
+	pthread_mutex_lock(pMutex);
+}
+
+///Marks the first task in line waiting on pCond, or all of them, to be run
+void SteppedClock::Wake(pthread_cond_t *pCond, bool bAll)
+{
+	pthread_mutex_lock(&stepMutex);
+
+	for(Waiter *pWaiter = pWaiters; pWaiter != NULL; pWaiter = pWaiter->pNext)
+	{
+		if((pWaiter->pCond == pCond) && !pWaiter->bSignalled)
+		{
+			pWaiter->bSignalled = true;
+
+			if(!bAll)
+			{
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&stepMutex);
+}
+
+///Gets in line and waits for the first run, so the task starts at the same point every time
+void SteppedClock::BeginTask()
+{
+	Waiter waiter;
+
+	waiter.iFile = -1;
+	waiter.pCond = NULL;
+
+	pthread_mutex_lock(&stepMutex);
+	waiter.fDeadline = fNow;
+	Enter(waiter);
+	uJoined++;
+	pthread_cond_broadcast(&settleCond);
+	Park(waiter);
+	pthread_mutex_unlock(&stepMutex);
+}
+
+///Waits for a task just started to get in line, where it stands depends on when it does
+void SteppedClock::AddTask()
+{
+	pthread_mutex_lock(&stepMutex);
+	uTasks++;
+
+	while(uJoined < uTasks)
+	{
+		pthread_cond_wait(&settleCond, &stepMutex);
+	}
+
+	pthread_mutex_unlock(&stepMutex);
+}
+
+/** Moves time on by fSeconds and returns once the robot has caught up.
+ *
+ * The first runnable task in line gets the run, and once it is waiting again the line is
+ * looked at from the front, since what it did may have given an earlier task something to do.
+ */
+void SteppedClock::Step(double fSeconds)
+{
+	pthread_mutex_lock(&stepMutex);
+	fNow += fSeconds;
+
+	while(true)
+	{
+		Waiter *pWaiter = pWaiters;
+		struct timespec giveUp = ToTimespec(GetMonotonic() + CLOCK_SETTLE_LIMIT);
+
+		while((pWaiter != NULL) && (pWaiter->bReleased || !IsRunnable(*pWaiter)))
+		{
+			pWaiter = pWaiter->pNext;
+		}
+
+		if(pWaiter == NULL)
+		{
+			break;
+		}
+
+		pWaiter->bReleased = true;
+		uRunning++;
+		pthread_cond_signal(&pWaiter->wake);
+
+		while(uRunning > 0)
+		{
+			if(pthread_cond_timedwait(&settleCond, &stepMutex, &giveUp) == ETIMEDOUT)
+			{
+				if(!bWarned)
+				{
+					printf("SteppedClock: a task did not come back to the clock at %0.3f s\n", fNow);
+					bWarned = true;
+				}
+
+				uRunning = 0;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&stepMutex);
+}
+
+RobotTimer::RobotTimer()
+{
+	fStartTime = RobotClock::GetTime();
+	fAccumulated = 0.0;
+	bRunning = false;
+}
+
+void RobotTimer::Start()
+{
+	if(!bRunning)
+	{
+		fStartTime = RobotClock::GetTime();
+		bRunning = true;
+	}
+}
+
+void RobotTimer::Stop()
+{
+	if(bRunning)
+	{
+		fAccumulated += RobotClock::GetTime() - fStartTime;
+		bRunning = false;
+	}
+}
+
+void RobotTimer::Reset()
+{
+	fAccumulated = 0.0;
+	fStartTime = RobotClock::GetTime();
+}
+
+double RobotTimer::Get()
+{
+	return(fAccumulated + (bRunning ? RobotClock::GetTime() - fStartTime : 0.0));
+}
@@ -0,0 +1,157 @@
+/** \file
+ * The one clock every task reads and sleeps on.
+ *
+ * Time, sleeps, the timeouts on message and file waits and condition variable waits all go
+ * through RobotClock, so swapping the clock changes how time passes for the whole robot at
+ * once.  On the robot it is the monotonic clock.  A ScaledClock runs the same code faster or
+ * slower than real time, and a SteppedClock only moves when Step() is called, which makes a
+ * simulated run repeat exactly and finish as fast as the tasks can keep up.
+ *
+ * The clock is chosen with Set() before any task starts and never changes after that.
+ * Condition variables waited on through the clock must be made with InitCondition() and woken
+ * with Signal() or Broadcast().
+ */
+
+#ifndef ROBOT_CLOCK_H
+#define ROBOT_CLOCK_H
+
+#include <pthread.h>
+
+const double CLOCK_FOREVER = -1.0;			//deadline for a wait that only ends when signalled
+const double CLOCK_SETTLE_LIMIT = 1.0;		//real seconds Step() waits for a task before going on
+
+class RobotClock
+{
+public:
+	static RobotClock *GetInstance();
+	static void Set(RobotClock *pClock);
+	static void InitCondition(pthread_cond_t *pCond);
+
+	///pthread_cond_signal() for a condition waited on through the clock
+	static void Signal(pthread_cond_t *pCond) { GetInstance()->Wake(pCond, false); };
+	///pthread_cond_broadcast() for a condition waited on through the clock
+	static void Broadcast(pthread_cond_t *pCond) { GetInstance()->Wake(pCond, true); };
+
+	///Seconds on the robot's clock
+	static double GetTime() { return(GetInstance()->Now()); };
+	///Sleeps fSeconds of robot time
+	static void Delay(double fSeconds) { GetInstance()->SleepUntil(GetInstance()->Now() + fSeconds); };
+
+	virtual ~RobotClock() {};
+
+	virtual double Now() = 0;
+	virtual void SleepUntil(double fDeadline) = 0;
+	///Returns true when iFile can be read, false if fDeadline came first
+	virtual bool WaitReadable(int iFile, double fDeadline) = 0;
+	///pthread_cond_timedwait() on the robot clock, the caller holds pMutex and checks why it woke
+	virtual void WaitCondition(pthread_cond_t *pCond, pthread_mutex_t *pMutex, double fDeadline) = 0;
+	///Wakes one task waiting on pCond, or every one with bAll
+	virtual void Wake(pthread_cond_t *pCond, bool bAll) = 0;
+
+	///Called by a new task before it does anything else
+	virtual void BeginTask() {};
+	///Called by whoever started a task, returns once the task has called BeginTask()
+	virtual void AddTask() {};
+
+private:
+	static RobotClock *pInstance;
+};
+
+///Robot time is real time multiplied by fScale, starting from the moment it was made
+class ScaledClock : public RobotClock
+{
+public:
+	explicit ScaledClock(double fScale);
+
+	double Now();
+	void SleepUntil(double fDeadline);
+	bool WaitReadable(int iFile, double fDeadline);
+	void WaitCondition(pthread_cond_t *pCond, pthread_mutex_t *pMutex, double fDeadline);
+	void Wake(pthread_cond_t *pCond, bool bAll);
+
+protected:
+	double fScale;
+	double fRealStart;			//monotonic time robot time fStart was read
+	double fStart;
+
+	double ToReal(double fDeadline);
+};
+
+///CLOCK_MONOTONIC as it is, what the robot runs on
+class RealClock : public ScaledClock
+{
+public:
+	RealClock();
+};
+
+/** Time that only moves when Step() is called, and only one task at a time.
+ *
+ * Every task but the one running waits on the clock.  Step() hands the run to the first task
+ * in line whose deadline came, whose file can be read or whose condition was signalled, waits
+ * for it to wait again and goes on to the next, until nothing is left to run.  A task goes to
+ * the back of the line each time it waits, and new tasks join it through BeginTask(), so the
+ * order only depends on what the tasks did and two runs come out the same.  A task that blocks
+ * somewhere other than the clock cannot be seen; Step() gives up on it after
+ * CLOCK_SETTLE_LIMIT, says so, and the run is no longer exact.
+ */
+class SteppedClock : public RobotClock
+{
+public:
+	explicit SteppedClock(double fStart = 0.0);
+	~SteppedClock();
+
+	double Now();
+	void SleepUntil(double fDeadline);
+	bool WaitReadable(int iFile, double fDeadline);
+	void WaitCondition(pthread_cond_t *pCond, pthread_mutex_t *pMutex, double fDeadline);
+	void Wake(pthread_cond_t *pCond, bool bAll);
+
+	void BeginTask();
+	void AddTask();
+
+	void Step(double fSeconds);
+
+private:
+	///A task waiting on the clock, it lives on the waiting task's stack
+	struct Waiter {
+		double fDeadline;
+		int iFile;				//-1 unless the task waits for a file to be readable
+		pthread_cond_t *pCond;	//NULL unless the task waits for a signal
+		bool bSignalled;
+		bool bReleased;			//Step() gave it the run
+		pthread_cond_t wake;	//the task sleeps here until it is released
+		Waiter *pNext;
+	};
+
+	pthread_mutex_t stepMutex;
+	pthread_cond_t settleCond;	//Step() and AddTask() sleep here
+	double fNow;
+	unsigned uRunning;			//tasks that left the clock and have not come back
+	unsigned uTasks;			//tasks AddTask() was told about
+	unsigned uJoined;			//tasks that called BeginTask()
+	Waiter *pWaiters;			//in the order they are run
+	bool bWarned;
+
+	void Enter(Waiter &waiter);
+	void Park(Waiter &waiter);
+	bool IsRunnable(const Waiter &waiter);
+};
+
+///A stopwatch on the robot clock, with the Start/Stop/Reset/Get of WPILib's Timer
+class RobotTimer
+{
+public:
+	RobotTimer();
+
+	void Start();
+	void Stop();
+	void Reset();
+	double Get();
+
+private:
+	double fStartTime;
+	double fAccumulated;
+	bool bRunning;
+};
+
+#endif //ROBOT_CLOCK_H
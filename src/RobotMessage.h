@@ -12,6 +12,9 @@
 #ifndef ROBOT_MESSAGE_H
 #define ROBOT_MESSAGE_H
 
+#include "RobotParams.h"			//For JOYSTICK_AXIS_COUNT
+
+class Trajectory;
 
 enum MessageCommand {
 	COMMAND_UNKNOWN,					//!< COMMAND_UNKNOWN
@@ -29,21 +32,49 @@ enum MessageCommand {
 	COMMAND_AUTONOMOUS_COMPLETE,		//!< Tells all components that Autonomous is done running the script
 	COMMAND_AUTONOMOUS_RESPONSE_OK,		//!< Tells Autonomous that a command finished running successfully
 	COMMAND_AUTONOMOUS_RESPONSE_ERROR,	//!< Tells Autonomous that a command had a error while running
+	COMMAND_AUTONOMOUS_CANCEL,			//!< Tells a component to abandon the autonomous command it is running
 	COMMAND_CHECKLIST_RUN,				//!< Tells CheckList to run
 
+	COMMAND_INPUT_BUTTON_PRESSED,		//!< A button the component subscribed to went down, see JoystickMonitor
+	COMMAND_INPUT_BUTTON_RELEASED,		//!< A button the component subscribed to came up
+	COMMAND_INPUT_AXES_MOVED,			//!< Axes the component subscribed to moved past the tolerance
+
 	COMMAND_DRIVETRAIN_STOP,			//!< Tells Drivetrain to stop moving
 	COMMAND_DRIVETRAIN_DRIVE_KIWI,
+	COMMAND_DRIVETRAIN_DRIVE_DISTANCE,	//!< Drive straight ahead driveDistance inches, holding heading
+	COMMAND_DRIVETRAIN_TURN_ANGLE,		//!< Turn in place by turnAngle degrees
+	COMMAND_DRIVETRAIN_DRIVE_TIME,		//!< Drive straight ahead for driveTime seconds, holding heading
+	COMMAND_DRIVETRAIN_FOLLOW_PATH,		//!< Follow trajectory, which Drivetrain releases to the PathPlanner
+	COMMAND_DRIVETRAIN_TEACH_START,		//!< Start recording teleop driving
+	COMMAND_DRIVETRAIN_TEACH_STOP,		//!< Stop recording and save it for TRAJECTORY to play back
 
 
 	COMMAND_COMPONENT_TEST,				//!< COMMAND_COMPONENT_TEST
 
 	COMMAND_LAST                      //!< COMMAND_LAST 
 };
+///Times a joystick command on its way to the motors, see LatencyProbe
+struct LatencyStamp {
+	bool bTraced;			//!< the rest is only filled in while the probe is on and the command changed
+	bool bInput;			//!< fInput is when the axis changed, not just when the main loop saw it
+	double fInput;
+	double fLoop;			//!< the main loop noticed the control packet
+	double fSent;			//!< into the drivetrain queue
+};
+
 ///Used to deliver joystick readings to Drivetrain
 struct KiwiDriveParams {
 	float x,y,r;
 };
 
+///Used by JoystickMonitor to deliver input events
+struct InputParams {
+	unsigned uController;					//!< InputController, see InputBindings.h
+	unsigned uInput;						//!< the button, or for axes a bitmask of those that moved
+	float axes[JOYSTICK_AXIS_COUNT];		//!< every axis as of the event, numbered like GetRawAxis()
+	LatencyStamp stamp;						//!< axes events only
+};
+
 
 ///Used to deliver autonomous values to Drivetrain
 struct AutonomousParams {
@@ -55,15 +86,17 @@ struct AutonomousParams {
 	float timein;
 
 	///used by drivetrain for straight driving
-	float driveSpeed;
-	float driveDistance;
-	float turnAngle;
-	float driveTime;
+	float driveSpeed;		//!< motor power, 0 to 1
+	float driveDistance;	//!< inches, negative drives backward
+	float turnAngle;		//!< degrees, positive toward a larger gyro angle
+	float driveTime;		//!< seconds
+	const Trajectory *trajectory;	//!< from PathPlanner::Get()
 };
 
 ///Contains all the parameter structures contained in a message
 union MessageParams {
 	KiwiDriveParams kiwiDrive;
+	InputParams input;
 	AutonomousParams autonomous;
 };
 
@@ -71,6 +104,7 @@ union MessageParams {
 struct RobotMessage {
 	MessageCommand command;
 	const char* replyQ;
+	unsigned uSequence;				//!< copied into the response so Autonomous can tell which command finished
 	MessageParams params;
 };
 
@@ -16,6 +16,11 @@ const char* const ROBOT_NAME =		"TRICERATOPS";	//Formal name
 const char* const ROBOT_NICKNAME =   "Mr. Kiwi";		//Nickname
 const char* const ROBOT_VERSION =	"1.0";						//Version
 
+//Where scripts, trajectories and logs live, the simulation build points this into its build tree
+#ifndef ROBOT_HOME
+#define ROBOT_HOME			"/home/lvuser"
+#endif
+
 //Robot Mode Macros - used to tell what mode the robot is in
 #define ISAUTO			RobotBase::getInstance().IsAutonomous()
 #define ISTELEOPERATED	RobotBase::getInstance().IsOperatorControl()
@@ -37,6 +42,11 @@ const int DRIVETRAIN_PRIORITY 	= DEFAULT_PRIORITY;
 const int AUTONOMOUS_PRIORITY 	= DEFAULT_PRIORITY;
 const int AUTOEXEC_PRIORITY 	= DEFAULT_PRIORITY;
 const int AUTOPARSER_PRIORITY 	= DEFAULT_PRIORITY;
+const int SENSOR_PRIORITY 		= DEFAULT_PRIORITY - 10;
+const int SENSOR_RT_PRIORITY	= 40;			//SCHED_FIFO priority for the sampler thread
+const int TIMER_PRIORITY		= DEFAULT_PRIORITY - 5;
+const int PATHPLAN_PRIORITY		= DEFAULT_PRIORITY + 20;	//only works while disabled
+const int CHECKLIST_PRIORITY	= DEFAULT_PRIORITY;
 
 //Task Names - Used when you view the task list but used by the operating system
 //EXAMPLE: const char* DRIVETRAIN_TASKNAME = "tDrive";
@@ -45,12 +55,37 @@ const char* const DRIVETRAIN_TASKNAME	= "tDrive";
 const char* const AUTONOMOUS_TASKNAME	= "tAuto";
 const char* const AUTOEXEC_TASKNAME		= "tAutoEx";
 const char* const AUTOPARSER_TASKNAME	= "tParse";
+const char* const SENSOR_TASKNAME		= "tSensor";
+const char* const TIMER_TASKNAME		= "tTimer";
+const char* const PATHPLAN_TASKNAME		= "tPath";
+const char* const CHECKLIST_TASKNAME	= "tCheck";
+const char* const CHECKWORKER_TASKNAME	= "tCheckW";
 
 const int COMPONENT_STACKSIZE	= 0x10000;
 const int DRIVETRAIN_STACKSIZE	= 0x10000;
 const int AUTONOMOUS_STACKSIZE	= 0x10000;
 const int AUTOEXEC_STACKSIZE	= 0x10000;
 const int AUTOPARSER_STACKSIZE	= 0x10000;
+const int SENSOR_STACKSIZE		= 0x10000;
+const int TIMER_STACKSIZE		= 0x10000;
+const int PATHPLAN_STACKSIZE	= 0x10000;
+const int CHECKLIST_STACKSIZE	= 0x10000;
+
+//Sensor Rates - How often the sensor task reads each sensor, in Hz
+const float GYRO_SAMPLE_RATE	= 200.0;
+const float ACCEL_SAMPLE_RATE	= 100.0;
+const float ESTIMATOR_RATE		= GYRO_SAMPLE_RATE;
+const float ODOMETRY_RATE		= 200.0;
+const float DRIVE_CURRENT_RATE	= 50.0;
+
+//Drivetrain Geometry - Used to turn encoder counts into robot motion, lengths are in inches
+const float DRIVETRAIN_WHEEL_DIAMETER	= 1.875;
+const float DRIVETRAIN_BASE_RADIUS		= 12.0;		//center of the robot to the center of each wheel
+const int DRIVETRAIN_ENCODER_CPR		= 256;		//codes per revolution, the Talon counts 4 edges per code
+const float DRIVETRAIN_ENCODER_SIGN		= -1.0;		//motors are driven with the negated KiwiDrive values
+const bool DRIVETRAIN_USE_ENCODERS		= true;
+const float DRIVETRAIN_INCHES_PER_COUNT	= DRIVETRAIN_ENCODER_SIGN * 3.1415926535 * DRIVETRAIN_WHEEL_DIAMETER
+		/ (4 * DRIVETRAIN_ENCODER_CPR);
 
 //TODO change these variables throughout the code to PIPE or whatever instead  of QUEUE
 //Queue Names - Used when you want to open the message queue for any task
@@ -88,43 +123,28 @@ const int CAN_DRIVETRAIN_BOTTOM_MOTOR = 1;
 //EXAMPLE: const int AIO_BATTERY = 8;
 
 //Joystick Input Device Counts - used by the listener to watch buttons and axis
-const int JOYSTICK_BUTTON_COUNT = 10;
-const int JOYSTICK_AXIS_COUNT = 5;
+const int JOYSTICK_BUTTON_COUNT = 10;		//at most 32, they are kept in a bitmask
+const int JOYSTICK_AXIS_COUNT = 6;
+
+//Driver Station Ports - where each controller is plugged in, what they do is in InputBindings.h
+const unsigned CONTROLLER_1_PORT = 0;
+const unsigned CONTROLLER_2_PORT = 1;
+
+//Input Shaping - see InputShaper.h, deadzone is a fraction of the travel, expo is 0 linear to
+//1 cubic and slew is the most an axis changes in a second, 0 for no limit; constexpr since the
+//binding table is built from them
+const float JOYSTICK_AXIS_TOLERANCE = 0.05;		//shaped change that is sent on as an axis moving
+constexpr float DRIVE_STICK_DEADZONE = 0.05;
+constexpr float DRIVE_STICK_EXPO = 0.0;
+constexpr float DRIVE_STICK_SLEW = 0.0;
+constexpr float DRIVE_TRIGGER_DEADZONE = 0.1;	//below this the drivetrain holds its heading
+constexpr float DRIVE_TRIGGER_EXPO = 0.0;
+constexpr float DRIVE_TRIGGER_SLEW = 0.0;
 
 //POV IDs - Assign names to the 9 POV positions: -1 to 7
 //EXAMPLE: const int POV_STILL = -1;
 const int POV_STILL = -1;
 
-//Primary Controller Mapping - Assigns action to buttons or axes on the first joystick
-#undef	USE_X3D_FOR_CONTROLLER_1
-#undef	USE_XBOX_FOR_CONTROLLER_1
-#define	USE_L310_FOR_CONTROLLER_1
-
-//Secondary Controller Mapping - Assigns action to buttons or axes on the second joystick
-#undef	USE_X3D_FOR_CONTROLLER_2
-#undef 	USE_XBOX_FOR_CONTROLLER_2
-#define USE_L310_FOR_CONTROLLER_2
-
-#ifdef USE_XBOX_FOR_CONTROLLER_1
-#endif
-
-#ifdef USE_L310_FOR_CONTROLLER_1
-//ID numbers for various buttons and axis
-
-#define KIWI_DRIVE_X				Controller_1->GetRawAxis(L310_THUMBSTICK_LEFT_X)
-#define KIWI_DRIVE_Y				-Controller_1->GetRawAxis(L310_THUMBSTICK_LEFT_Y)
-#define KIWI_DRIVE_R				Controller_1->GetRawAxis(L310_TRIGGER_RIGHT)-Controller_1->GetRawAxis(L310_TRIGGER_LEFT);
-#endif // USE_L310_FOR_CONTROLLER_1
-
-#ifdef USE_X3D_FOR_CONTROLLER_2
-#endif // USE_X3D_FOR_CONTROLLER_2
-
-#ifdef USE_XBOX_FOR_CONTROLLER_2
-#endif // USE_XBOX_FOR_CONTROLLER_2
-
-#ifdef USE_L310_FOR_CONTROLLER_2
-//ID numbers for various buttons and axis
-
-#endif // USE_L310_FOR_CONTROLLER_2
+//Controller Mapping - Assigns actions to buttons or axes, see the table in InputBindings.h
 
 #endif //ROBOT_PARAMS_H
@@ -0,0 +1,456 @@
+/** \file
+ * Shared sensor sampling task.
+ *
+ * The schedule tick is the greatest common divisor of the requested sample periods.  Each
+ * sensor runs every N ticks and is given the phase within those N ticks that keeps the
+ * number of sensors read on any one tick as small as possible.  Sensors that share a tick are
+ * read in the order they registered, so a routine that depends on another sensor's data
+ * should register after it.
+ */
+
+#include "SensorSampler.h"
+
+#include <time.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "RobotClock.h"
+#include "RobotParams.h"
+
+SensorSampler *SensorSampler::pInstance = NULL;
+
+SensorRing::SensorRing()
+{
+	memset(samples, 0, sizeof(samples));
+	uWrite.store(0, std::memory_order_relaxed);
+}
+
+void SensorRing::Publish(const SensorSample &sample)
+{
+	unsigned uNext = uWrite.load(std::memory_order_relaxed);
+
+	samples[uNext & (SENSOR_RING_SIZE - 1)] = sample;
+	uWrite.store(uNext + 1, std::memory_order_release);
+}
+
+bool SensorRing::GetLatest(SensorSample &sample) const
+{
+	unsigned uCount;
+
+	do
+	{
+		uCount = uWrite.load(std::memory_order_acquire);
+
+		if(uCount == 0)
+		{
+			return(false);
+		}
+
+		sample = samples[(uCount - 1) & (SENSOR_RING_SIZE - 1)];
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	while(uWrite.load(std::memory_order_relaxed) - uCount >= SENSOR_RING_SIZE - 1);
+
+	return(true);
+}
+
+///Copies samples numbered uFirst onward, returns how many were copied.  Samples already overwritten are skipped.
+unsigned SensorRing::GetSamples(unsigned uFirst, SensorSample *pSamples, unsigned uMax) const
+{
+	unsigned uCount = uWrite.load(std::memory_order_acquire);
+	unsigned uCopied = 0;
+
+	if(uCount - uFirst > SENSOR_RING_SIZE - 1)
+	{
+		uFirst = uCount - (SENSOR_RING_SIZE - 1);
+	}
+
+	for(unsigned u = uFirst; (u != uCount) && (uCopied < uMax); u++)
+	{
+		pSamples[uCopied] = samples[u & (SENSOR_RING_SIZE - 1)];
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(uWrite.load(std::memory_order_relaxed) - u >= SENSOR_RING_SIZE)
+		{
+			// lapped while copying, this slot is no good
+
+			continue;
+		}
+
+		uCopied++;
+	}
+
+	return(uCopied);
+}
+
+SensorSampler *SensorSampler::GetInstance()
+{
+	if(pInstance == NULL)
+	{
+		pInstance = new SensorSampler();
+	}
+
+	return(pInstance);
+}
+
+SensorSampler::SensorSampler()
+{
+	pTask = NULL;
+	iSensorCount = 0;
+	iWatchCount = 0;
+	memset(watches, 0, sizeof(watches));
+	uTickUsec = 1000000 / 100;
+	uTick = 0;
+	uOverruns = 0;
+	bStarted = false;
+	pthread_mutex_init(&scheduleMutex, NULL);
+}
+
+SensorSampler::~SensorSampler()
+{
+	delete(pTask);
+	pthread_mutex_destroy(&scheduleMutex);
+}
+
+double SensorSampler::GetTime()
+{
+	return(RobotClock::GetTime());
+}
+
+///Adds a sensor to the schedule and returns its id, or -1 if the table is full
+int SensorSampler::Register(const char *szName, SensorReadFunc pRead, void *pThis, float fRateHz)
+{
+	int iSensor;
+
+	wpi_assert(pRead && (fRateHz > 0.0));
+
+	pthread_mutex_lock(&scheduleMutex);
+
+	if(iSensorCount >= SENSOR_MAX_SENSORS)
+	{
+		pthread_mutex_unlock(&scheduleMutex);
+		printf("SensorSampler: no room for %s\n", szName);
+		return(-1);
+	}
+
+	iSensor = iSensorCount;
+	sensors[iSensor].szName = szName;
+	sensors[iSensor].pRead = pRead;
+	sensors[iSensor].pThis = pThis;
+	sensors[iSensor].uPeriodUsec = (unsigned)(1000000.0 / fRateHz + 0.5);
+	sensors[iSensor].bEnabled.store(true);
+	iSensorCount++;
+
+	ComputeSchedule();
+	pthread_mutex_unlock(&scheduleMutex);
+
+	return(iSensor);
+}
+
+///Returns the id of the sensor registered as szName, or -1
+int SensorSampler::Find(const char *szName)
+{
+	for(int i = 0; i < iSensorCount; i++)
+	{
+		if(!strcmp(sensors[i].szName, szName))
+		{
+			return(i);
+		}
+	}
+
+	return(-1);
+}
+
+void SensorSampler::Enable(int iSensor, bool bEnable)
+{
+	if((iSensor >= 0) && (iSensor < iSensorCount))
+	{
+		sensors[iSensor].bEnabled.store(bEnable);
+	}
+}
+
+const SensorRing *SensorSampler::GetRing(int iSensor)
+{
+	if((iSensor >= 0) && (iSensor < iSensorCount))
+	{
+		return(&sensors[iSensor].ring);
+	}
+
+	return(NULL);
+}
+
+bool SensorSampler::GetLatest(int iSensor, SensorSample &sample)
+{
+	if((iSensor >= 0) && (iSensor < iSensorCount))
+	{
+		return(sensors[iSensor].ring.GetLatest(sample));
+	}
+
+	return(false);
+}
+
+/** Calls pNotify once, from the sampler task, when value iValue of iSensor meets the condition.
+ *
+ * Returns the watch id for Unwatch(), or -1 if the sensor does not exist or every watch is in
+ * use.  A watch that has fired is already free.
+ */
+int SensorSampler::Watch(int iSensor, int iValue, SensorCompare compare, float fThreshold,
+		SensorWatchFunc pNotify, void *pThis, unsigned uCookie)
+{
+	int iWatch = -1;
+
+	if((iSensor < 0) || (iSensor >= iSensorCount) || (iValue < 0) || (iValue >= SENSOR_MAX_VALUES))
+	{
+		return(-1);
+	}
+
+	pthread_mutex_lock(&scheduleMutex);
+
+	for(int i = 0; i < SENSOR_MAX_WATCHES; i++)
+	{
+		if(!watches[i].bArmed)
+		{
+			iWatch = i;
+			break;
+		}
+	}
+
+	if(iWatch >= 0)
+	{
+		watches[iWatch].iSensor = iSensor;
+		watches[iWatch].iValue = iValue;
+		watches[iWatch].compare = compare;
+		watches[iWatch].fThreshold = fThreshold;
+		watches[iWatch].pNotify = pNotify;
+		watches[iWatch].pThis = pThis;
+		watches[iWatch].uCookie = uCookie;
+		watches[iWatch].bArmed = true;
+		iWatchCount++;
+	}
+
+	pthread_mutex_unlock(&scheduleMutex);
+	return(iWatch);
+}
+
+void SensorSampler::Unwatch(int iWatch)
+{
+	if((iWatch < 0) || (iWatch >= SENSOR_MAX_WATCHES))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&scheduleMutex);
+
+	if(watches[iWatch].bArmed)
+	{
+		watches[iWatch].bArmed = false;
+		iWatchCount--;
+	}
+
+	pthread_mutex_unlock(&scheduleMutex);
+}
+
+bool SensorSampler::Compare(SensorCompare compare, float fValue, float fThreshold)
+{
+	switch(compare)
+	{
+	case SENSOR_ABOVE:
+		return(fValue > fThreshold);
+
+	case SENSOR_AT_LEAST:
+		return(fValue >= fThreshold);
+
+	case SENSOR_BELOW:
+		return(fValue < fThreshold);
+
+	case SENSOR_AT_MOST:
+		return(fValue <= fThreshold);
+	}
+
+	return(false);
+}
+
+void SensorSampler::Start()
+{
+	if(bStarted)
+	{
+		return;
+	}
+
+	bStarted = true;
+	pTask = new Task(SENSOR_TASKNAME, (FUNCPTR) &SensorSampler::StartTask,
+			SENSOR_PRIORITY, SENSOR_STACKSIZE);
+	wpi_assert(pTask);
+	pTask->Start((intptr_t)this);
+}
+
+static unsigned GreatestCommonDivisor(unsigned a, unsigned b)
+{
+	while(b)
+	{
+		unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return(a);
+}
+
+///Called with the schedule mutex held
+void SensorSampler::ComputeSchedule()
+{
+	unsigned uGcd = 0;
+	unsigned uHyperPeriod = 1;
+	unsigned uLoad[SENSOR_MAX_HYPERPERIOD];
+
+	for(int i = 0; i < iSensorCount; i++)
+	{
+		uGcd = GreatestCommonDivisor(sensors[i].uPeriodUsec, uGcd);
+	}
+
+	uTickUsec = (uGcd < SENSOR_MIN_TICK_USEC) ? SENSOR_MIN_TICK_USEC : uGcd;
+
+	for(int i = 0; i < iSensorCount; i++)
+	{
+		sensors[i].uDivider = (sensors[i].uPeriodUsec + uTickUsec / 2) / uTickUsec;
+
+		if(sensors[i].uDivider == 0)
+		{
+			sensors[i].uDivider = 1;
+		}
+
+		if(uHyperPeriod <= SENSOR_MAX_HYPERPERIOD)
+		{
+			uHyperPeriod = uHyperPeriod / GreatestCommonDivisor(uHyperPeriod, sensors[i].uDivider)
+					* sensors[i].uDivider;
+		}
+	}
+
+	// spread the sensors so the fewest possible share a tick
+
+	memset(uLoad, 0, sizeof(uLoad));
+
+	for(int i = 0; i < iSensorCount; i++)
+	{
+		unsigned uBestPhase = 0;
+		unsigned uBestLoad = ~0u;
+
+		if(uHyperPeriod > SENSOR_MAX_HYPERPERIOD)
+		{
+			sensors[i].uPhase = 0;
+			continue;
+		}
+
+		for(unsigned uPhase = 0; uPhase < sensors[i].uDivider; uPhase++)
+		{
+			unsigned uWorst = 0;
+
+			for(unsigned t = uPhase; t < uHyperPeriod; t += sensors[i].uDivider)
+			{
+				if(uLoad[t] > uWorst)
+				{
+					uWorst = uLoad[t];
+				}
+			}
+
+			if(uWorst < uBestLoad)
+			{
+				uBestLoad = uWorst;
+				uBestPhase = uPhase;
+			}
+		}
+
+		sensors[i].uPhase = uBestPhase;
+
+		for(unsigned t = uBestPhase; t < uHyperPeriod; t += sensors[i].uDivider)
+		{
+			uLoad[t]++;
+		}
+	}
+}
+
+void SensorSampler::DoSampling()
+{
+	double fNext;
+	struct sched_param param;
+	SensorSample sample;
+	SensorWatch fired[SENSOR_MAX_WATCHES];
+	SensorSample firedSample[SENSOR_MAX_WATCHES];
+	int iFired;
+
+	// ask for real time scheduling, we carry on at task priority if we are not allowed
+
+	param.sched_priority = SENSOR_RT_PRIORITY;
+
+	if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+	{
+		printf("SensorSampler: running without SCHED_FIFO\n");
+	}
+
+	fNext = GetTime();
+
+	while(true)
+	{
+		// absolute deadlines so the schedule does not drift with the work we do
+
+		fNext += uTickUsec * 1.0e-6;
+		RobotClock::GetInstance()->SleepUntil(fNext);
+
+		pthread_mutex_lock(&scheduleMutex);
+		iFired = 0;
+
+		for(int i = 0; i < iSensorCount; i++)
+		{
+			SensorEntry &sensor = sensors[i];
+
+			if(!sensor.bEnabled.load(std::memory_order_relaxed) ||
+					((uTick % sensor.uDivider) != sensor.uPhase))
+			{
+				continue;
+			}
+
+			sample.fTime = GetTime();
+
+			if(!sensor.pRead(sensor.pThis, sample))
+			{
+				continue;
+			}
+
+			sensor.ring.Publish(sample);
+
+			// watches fire once, the callbacks run after we let go of the schedule
+
+			for(int w = 0; (w < SENSOR_MAX_WATCHES) && iWatchCount; w++)
+			{
+				SensorWatch &watch = watches[w];
+
+				if(watch.bArmed && (watch.iSensor == i) &&
+						Compare(watch.compare, sample.fValue[watch.iValue], watch.fThreshold))
+				{
+					watch.bArmed = false;
+					iWatchCount--;
+					fired[iFired] = watch;
+					firedSample[iFired++] = sample;
+				}
+			}
+		}
+
+		pthread_mutex_unlock(&scheduleMutex);
+
+		for(int w = 0; w < iFired; w++)
+		{
+			fired[w].pNotify(fired[w].pThis, fired[w].uCookie, firedSample[w]);
+		}
+
+		uTick++;
+
+		// if we fell more than a tick behind, skip ahead rather than bursting to catch up
+
+		if(GetTime() - fNext > uTickUsec * 1.0e-6)
+		{
+			uOverruns++;
+			fNext = GetTime();
+		}
+	}
+}
@@ -0,0 +1,139 @@
+/** \file
+ * Shared sensor sampling task.
+ *
+ * Sensors register a read routine and the rate they want to be sampled at.  One high priority
+ * task services every registered sensor on a schedule computed from those rates, so adding a
+ * gyro or an I2C part does not mean adding another thread.  Each sensor publishes timestamped
+ * samples into its own lock free ring which any task may read without blocking the sampler.
+ *
+ * A task that is waiting for a value to cross a threshold can set a watch instead of polling.
+ * The sampler checks the watch against every sample it publishes and calls back once, from
+ * the sampler task, as soon as the condition holds.
+ */
+
+#ifndef SENSOR_SAMPLER_H
+#define SENSOR_SAMPLER_H
+
+#include <pthread.h>
+#include <atomic>
+
+#include "WPILib.h"
+
+const int SENSOR_MAX_SENSORS = 16;
+const int SENSOR_MAX_VALUES = 4;
+const unsigned SENSOR_RING_SIZE = 64;			//must be a power of two
+const unsigned SENSOR_MIN_TICK_USEC = 500;		//fastest schedule tick we allow
+const unsigned SENSOR_MAX_HYPERPERIOD = 1000;	//ticks searched when spreading sensors across the schedule
+const int SENSOR_MAX_WATCHES = 8;
+
+///One reading from a sensor, values are defined by the sensor that published it
+struct SensorSample {
+	double fTime;						//!< sampler clock, seconds
+	float fValue[SENSOR_MAX_VALUES];
+};
+
+///Read routine called from the sampler task; return false when there is no sample to publish
+typedef bool (*SensorReadFunc)(void *pThis, SensorSample &sample);
+
+///Called once from the sampler task when a watched value meets its condition, keep it short
+typedef void (*SensorWatchFunc)(void *pThis, unsigned uCookie, const SensorSample &sample);
+
+typedef enum SensorCompare
+{
+	SENSOR_ABOVE,
+	SENSOR_AT_LEAST,
+	SENSOR_BELOW,
+	SENSOR_AT_MOST
+} SensorCompare;
+
+/** Single writer ring of samples.
+ *
+ * Only the sampler task writes.  Readers copy a slot and then check that the writer has not
+ * lapped them while they were copying, so nobody ever waits on a lock.
+ */
+class SensorRing
+{
+public:
+	SensorRing();
+
+	void Publish(const SensorSample &sample);
+	bool GetLatest(SensorSample &sample) const;
+	unsigned GetSamples(unsigned uFirst, SensorSample *pSamples, unsigned uMax) const;
+	unsigned GetCount() const { return(uWrite.load(std::memory_order_acquire)); };
+
+private:
+	SensorSample samples[SENSOR_RING_SIZE];
+	std::atomic<unsigned> uWrite;
+};
+
+class SensorSampler
+{
+public:
+	static SensorSampler *GetInstance();
+
+	int Register(const char *szName, SensorReadFunc pRead, void *pThis, float fRateHz);
+	int Find(const char *szName);
+	void Enable(int iSensor, bool bEnable);
+	int Watch(int iSensor, int iValue, SensorCompare compare, float fThreshold,
+			SensorWatchFunc pNotify, void *pThis, unsigned uCookie);
+	void Unwatch(int iWatch);
+	const SensorRing *GetRing(int iSensor);
+	bool GetLatest(int iSensor, SensorSample &sample);
+	float GetTickPeriod() { return(uTickUsec * 1.0e-6); };
+	unsigned GetOverruns() { return(uOverruns); };
+	void Start();
+
+	static double GetTime();
+
+	static void *StartTask(void *pThis)
+	{
+		((SensorSampler *)pThis)->DoSampling();
+		return(NULL);
+	}
+
+private:
+	struct SensorEntry {
+		const char *szName;
+		SensorReadFunc pRead;
+		void *pThis;
+		unsigned uPeriodUsec;
+		unsigned uDivider;				//run every uDivider ticks
+		unsigned uPhase;				//on the ticks where (tick % uDivider) == uPhase
+		std::atomic<bool> bEnabled;
+		SensorRing ring;
+	};
+
+	struct SensorWatch {
+		int iSensor;
+		int iValue;
+		SensorCompare compare;
+		float fThreshold;
+		SensorWatchFunc pNotify;
+		void *pThis;
+		unsigned uCookie;
+		bool bArmed;
+	};
+
+	static SensorSampler *pInstance;
+
+	Task *pTask;
+	pthread_mutex_t scheduleMutex;
+	SensorEntry sensors[SENSOR_MAX_SENSORS];
+	SensorWatch watches[SENSOR_MAX_WATCHES];
+
+	int iSensorCount;
+	int iWatchCount;				//watches armed, so the sampler skips the check when there are none
+	unsigned uTickUsec;
+	unsigned uTick;
+	unsigned uOverruns;
+	bool bStarted;
+
+	SensorSampler();
+	~SensorSampler();
+
+	void ComputeSchedule();
+	static bool Compare(SensorCompare compare, float fValue, float fThreshold);
+	void DoSampling();
+};
+
+#endif //SENSOR_SAMPLER_H
@@ -0,0 +1,60 @@
+/** \file
+ * Latest value snapshot shared between tasks.
+ *
+ * One task writes, any task reads.  The writer bumps a sequence number before and after it
+ * copies the value in; a reader retries if the sequence was odd or changed while it copied.
+ * Nobody blocks, and a reader always gets a complete value from a single write.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <string.h>
+
+template <typename T>
+class Snapshot
+{
+public:
+	Snapshot()
+	{
+		memset(&value, 0, sizeof(value));
+		uSequence.store(0, std::memory_order_relaxed);
+	}
+
+	///Only one task may write a given snapshot
+	void Write(const T &newValue)
+	{
+		unsigned uSeq = uSequence.load(std::memory_order_relaxed);
+
+		uSequence.store(uSeq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&value, &newValue, sizeof(T));
+		uSequence.store(uSeq + 2, std::memory_order_release);
+	}
+
+	///Returns false if nothing has been written yet
+	bool Read(T &copy) const
+	{
+		unsigned uSeq;
+
+		do
+		{
+			uSeq = uSequence.load(std::memory_order_acquire);
+			memcpy(&copy, &value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		while((uSeq & 1) || (uSeq != uSequence.load(std::memory_order_relaxed)));
+
+		return(uSeq != 0);
+	}
+
+	///Changes every time a new value is written
+	unsigned GetSequence() const { return(uSequence.load(std::memory_order_acquire)); };
+
+private:
+	T value;
+	std::atomic<unsigned> uSequence;
+};
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,201 @@
+/** \file
+ * Fuses the gyro, accelerometer and drive encoders into one state estimate.
+ *
+ * Each tick the field frame acceleration is integrated into the velocity estimate and the
+ * result is nudged toward the velocity the wheels report.  The accelerometer bias is learned
+ * whenever the gyro and the wheels agree that we are sitting still.  Without encoders the
+ * velocity slowly leaks back to zero so accelerometer drift cannot run away.
+ */
+
+#include "StateEstimator.h"
+#include "Blackboard.h"
+
+#include <math.h>
+#include <string.h>
+
+StateEstimator *StateEstimator::pInstance = NULL;
+
+StateEstimator::StateEstimator(ADXRS453Z *gyro, int iAccelSensor,
+		CANTalon *leftMotor, CANTalon *rightMotor, CANTalon *bottomMotor)
+{
+	this->gyro = gyro;
+	this->iAccelSensor = iAccelSensor;
+	this->leftMotor = leftMotor;
+	this->rightMotor = rightMotor;
+	this->bottomMotor = bottomMotor;
+
+	memset(&estimate, 0, sizeof(estimate));
+	bResetRequested.store(false);
+	fLastTime = 0.0;
+	fBiasX = 0.0;
+	fBiasY = 0.0;
+
+	// we must register after the gyro and accelerometer so we see this tick's samples
+
+	iSensor = SensorSampler::GetInstance()->Register("StateEstimator",
+			&StateEstimator::Sample, this, ESTIMATOR_RATE);
+	pInstance = this;
+}
+
+StateEstimator::~StateEstimator()
+{
+	SensorSampler::GetInstance()->Enable(iSensor, false);
+
+	if(pInstance == this)
+	{
+		pInstance = NULL;
+	}
+}
+
+///The latest estimate, from the blackboard; false before the first tick
+bool StateEstimator::GetEstimate(StateEstimate &estimate) const
+{
+	return(Blackboard::GetInstance()->estimate.Read(estimate));
+}
+
+float StateEstimator::GetHeading() const
+{
+	StateEstimate current;
+
+	if(GetEstimate(current))
+	{
+		return(current.fHeading);
+	}
+
+	return(gyro->GetAngle());
+}
+
+///Clears velocity, call when the gyro is zeroed; safe from any task
+void StateEstimator::Reset()
+{
+	bResetRequested.store(true);
+}
+
+bool StateEstimator::Sample(void *pThis, SensorSample &sample)
+{
+	((StateEstimator *)pThis)->Update(sample);
+	return(true);
+}
+
+bool StateEstimator::ReadWheels(KiwiWheels &wheels)
+{
+	if(!DRIVETRAIN_USE_ENCODERS || !leftMotor || !rightMotor || !bottomMotor)
+	{
+		return(false);
+	}
+
+	// Talon velocity is in counts per 100ms
+
+	wheels.left = leftMotor->GetEncVel() * 10.0 * DRIVETRAIN_INCHES_PER_COUNT;
+	wheels.right = rightMotor->GetEncVel() * 10.0 * DRIVETRAIN_INCHES_PER_COUNT;
+	wheels.bottom = bottomMotor->GetEncVel() * 10.0 * DRIVETRAIN_INCHES_PER_COUNT;
+	return(true);
+}
+
+void StateEstimator::Update(SensorSample &sample)
+{
+	SensorSample gyroSample;
+	SensorSample accelSample;
+	KiwiWheels wheels;
+	float fDelta;
+	float fHeadingRad;
+	float fAccelX = 0.0;
+	float fAccelY = 0.0;
+	bool bStill;
+
+	fDelta = (fLastTime > 0.0) ? (sample.fTime - fLastTime) : 0.0;
+	fLastTime = sample.fTime;
+
+	if(bResetRequested.exchange(false))
+	{
+		estimate.fVelocityX = 0.0;
+		estimate.fVelocityY = 0.0;
+	}
+
+	estimate.fTime = sample.fTime;
+
+	if(SensorSampler::GetInstance()->GetLatest(gyro->GetSensor(), gyroSample))
+	{
+		estimate.fAngularRate = gyroSample.fValue[0];
+		estimate.fHeading = gyroSample.fValue[1];
+	}
+
+	fHeadingRad = estimate.fHeading * KIWI_DEG_TO_RAD;
+
+	// predict with the accelerometer
+
+	if(SensorSampler::GetInstance()->GetLatest(iAccelSensor, accelSample))
+	{
+		fAccelX = accelSample.fValue[0] * ESTIMATOR_G - fBiasX;
+		fAccelY = accelSample.fValue[1] * ESTIMATOR_G - fBiasY;
+	}
+
+	estimate.fAccelX = fAccelX;
+	estimate.fAccelY = fAccelY;
+	KiwiRobotToField(fHeadingRad, estimate.fAccelX, estimate.fAccelY);
+
+	estimate.fVelocityX += estimate.fAccelX * fDelta;
+	estimate.fVelocityY += estimate.fAccelY * fDelta;
+
+	// correct with the wheels
+
+	estimate.bEncodersValid = ReadWheels(wheels);
+	bStill = fabs(estimate.fAngularRate) < ESTIMATOR_STILL_RATE;
+
+	if(estimate.bEncodersValid)
+	{
+		KiwiMotion motion = KiwiForward(wheels, DRIVETRAIN_BASE_RADIUS);
+		float fGain = fDelta / (ESTIMATOR_VELOCITY_TC + fDelta);
+		float fErrorX;
+		float fErrorY;
+
+		bStill = bStill && (fabs(motion.x) < ESTIMATOR_STILL_SPEED) &&
+				(fabs(motion.y) < ESTIMATOR_STILL_SPEED);
+
+		KiwiRobotToField(fHeadingRad, motion.x, motion.y);
+		fErrorX = motion.x - estimate.fVelocityX;
+		fErrorY = motion.y - estimate.fVelocityY;
+
+		estimate.fVelocityX += fGain * fErrorX;
+		estimate.fVelocityY += fGain * fErrorY;
+		estimate.fWheelRate = motion.r / KIWI_DEG_TO_RAD;
+		estimate.fSlipSpeed = sqrtf(fErrorX * fErrorX + fErrorY * fErrorY);
+		estimate.fSlipRate = estimate.fAngularRate - estimate.fWheelRate;
+		estimate.bSlipping = (estimate.fSlipSpeed > ESTIMATOR_SLIP_SPEED) ||
+				(fabs(estimate.fSlipRate) > ESTIMATOR_SLIP_RATE);
+	}
+	else
+	{
+		float fLeak = fDelta / (ESTIMATOR_LEAK_TC + fDelta);
+
+		estimate.fVelocityX -= fLeak * estimate.fVelocityX;
+		estimate.fVelocityY -= fLeak * estimate.fVelocityY;
+		estimate.fWheelRate = 0.0;
+		estimate.fSlipSpeed = 0.0;
+		estimate.fSlipRate = 0.0;
+		estimate.bSlipping = false;
+	}
+
+	// sitting still is our chance to learn the accelerometer bias
+
+	if(bStill && (fDelta > 0.0))
+	{
+		float fGain = fDelta / (ESTIMATOR_BIAS_TC + fDelta);
+
+		fBiasX += fGain * fAccelX;
+		fBiasY += fGain * fAccelY;
+
+		if(estimate.bEncodersValid)
+		{
+			estimate.fVelocityX = 0.0;
+			estimate.fVelocityY = 0.0;
+		}
+	}
+
+	Blackboard::GetInstance()->estimate.Write(estimate);
+
+	sample.fValue[0] = estimate.fHeading;
+	sample.fValue[1] = estimate.fAngularRate;
+	sample.fValue[2] = estimate.fVelocityX;
+	sample.fValue[3] = estimate.fVelocityY;
+}
@@ -0,0 +1,83 @@
+/** \file
+ * Fuses the gyro, accelerometer and drive encoders into one state estimate.
+ *
+ * The estimator is read by the sensor task right after the sensors it uses, so it runs at
+ * sensor rate.  Heading and rate come from the gyro.  Planar velocity is the accelerometer
+ * integrated in the field frame and pulled toward the encoder velocity by a complementary
+ * filter.  When the two disagree, or the wheels turn faster than the gyro says the robot is
+ * turning, the wheels are probably slipping.
+ */
+
+#ifndef STATE_ESTIMATOR_H
+#define STATE_ESTIMATOR_H
+
+#include <atomic>
+
+#include "WPILib.h"
+
+#include "ADXRS453Z.h"
+#include "SensorSampler.h"
+#include "KiwiKinematics.h"
+#include "RobotParams.h"
+
+const float ESTIMATOR_VELOCITY_TC	= 0.25;		//seconds, how fast encoder velocity corrects the accelerometer
+const float ESTIMATOR_LEAK_TC		= 2.0;		//seconds, velocity decay when there are no encoders
+const float ESTIMATOR_BIAS_TC		= 2.0;		//seconds, accelerometer bias learning while still
+const float ESTIMATOR_STILL_RATE	= 2.0;		//deg/s, slower than this we may be sitting still
+const float ESTIMATOR_STILL_SPEED	= 1.0;		//in/s
+const float ESTIMATOR_SLIP_SPEED	= 6.0;		//in/s disagreement before we call it slip
+const float ESTIMATOR_SLIP_RATE		= 30.0;		//deg/s disagreement before we call it slip
+const float ESTIMATOR_G				= 386.09;	//in/s/s
+
+///Everything we know about how the robot is moving, from one sensor tick
+struct StateEstimate {
+	double fTime;				//!< sampler clock, seconds
+	float fHeading;				//!< degrees, same sense as the gyro
+	float fAngularRate;			//!< degrees/s from the gyro
+	float fWheelRate;			//!< degrees/s from the encoders
+	float fVelocityX;			//!< field frame, in/s
+	float fVelocityY;			//!< field frame, in/s
+	float fAccelX;				//!< field frame, in/s/s, bias removed
+	float fAccelY;
+	float fSlipSpeed;			//!< in/s, encoder velocity minus inertial velocity
+	float fSlipRate;			//!< degrees/s, gyro rate minus encoder rate
+	bool bSlipping;
+	bool bEncodersValid;
+};
+
+class StateEstimator
+{
+public:
+	StateEstimator(ADXRS453Z *gyro, int iAccelSensor,
+			CANTalon *leftMotor, CANTalon *rightMotor, CANTalon *bottomMotor);
+	~StateEstimator();
+
+	static StateEstimator *GetInstance() { return(pInstance); };
+
+	bool GetEstimate(StateEstimate &estimate) const;
+	float GetHeading() const;
+	int GetSensor() const { return(iSensor); };	//sampler id, samples hold heading, rate, x and y velocity
+	void Reset();
+
+private:
+	static StateEstimator *pInstance;
+
+	ADXRS453Z *gyro;
+	CANTalon *leftMotor;
+	CANTalon *rightMotor;
+	CANTalon *bottomMotor;
+
+	StateEstimate estimate;
+	std::atomic<bool> bResetRequested;
+	int iSensor;
+	int iAccelSensor;
+	double fLastTime;
+	float fBiasX;
+	float fBiasY;
+
+	static bool Sample(void *pThis, SensorSample &sample);
+	void Update(SensorSample &sample);
+	bool ReadWheels(KiwiWheels &wheels);
+};
+
+#endif //STATE_ESTIMATOR_H
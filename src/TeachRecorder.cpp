@@ -0,0 +1,316 @@
+/** \file
+ * Teach and repeat: record a path driven by hand and play it back in autonomous.
+ *
+ * Every buffer is a fixed member array, so a recording never allocates and a full fifteen
+ * seconds costs the same memory as a short one.  Compression keeps a point only where the
+ * straight line from the last kept point stops describing the points in between, which for
+ * typical driving leaves a few dozen points, eight bytes each, out of hundreds.
+ */
+
+#include "TeachRecorder.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "KiwiKinematics.h"
+
+TeachRecorder::TeachRecorder()
+{
+	uPoints = 0;
+	fStartTime = 0.0;
+	bRecording = false;
+}
+
+void TeachRecorder::Start()
+{
+	uPoints = 0;
+	bRecording = true;
+}
+
+///Called every control tick, anything past TEACH_MAX_TIME is dropped
+void TeachRecorder::Add(double fTime, const RobotPose &pose, float fDriveX, float fDriveY, float fDriveR)
+{
+	if(!bRecording)
+	{
+		return;
+	}
+
+	if(uPoints == 0)
+	{
+		fStartTime = fTime;
+	}
+
+	if((uPoints >= TEACH_MAX_POINTS) || (fTime - fStartTime > TEACH_MAX_TIME))
+	{
+		return;
+	}
+
+	TeachPoint &point = points[uPoints++];
+
+	point.fTime = fTime - fStartTime;
+	point.x = pose.x;
+	point.y = pose.y;
+	point.fHeading = pose.fHeading;
+	point.fDriveX = fDriveX;
+	point.fDriveY = fDriveY;
+	point.fDriveR = fDriveR;
+}
+
+/** Cuts off the idle ends, moves the start to the origin and resamples every TEACH_PERIOD.
+ *
+ * Returns how many points are in resampled[], 0 if the driver never moved the sticks.
+ */
+unsigned TeachRecorder::Resample()
+{
+	int iFirst = -1;
+	int iLast = -1;
+	unsigned uResampled = 0;
+	unsigned k;
+	float fEnd;
+
+	for(unsigned i = 0; i < uPoints; i++)
+	{
+		const TeachPoint &point = points[i];
+
+		if((fabs(point.fDriveX) > TEACH_IDLE_COMMAND) || (fabs(point.fDriveY) > TEACH_IDLE_COMMAND) ||
+				(fabs(point.fDriveR) > TEACH_IDLE_COMMAND))
+		{
+			if(iFirst < 0)
+			{
+				iFirst = i;
+			}
+
+			iLast = i;
+		}
+	}
+
+	if(iFirst < 0)
+	{
+		return(0);
+	}
+
+	const TeachPoint &start = points[iFirst];
+
+	fEnd = fmin(points[iLast].fTime + TEACH_SETTLE_TIME, points[uPoints - 1].fTime);
+	k = iFirst;
+
+	while(uResampled < TEACH_MAX_RESAMPLED)
+	{
+		TeachPoint &point = resampled[uResampled];
+		float fTime = start.fTime + uResampled * TEACH_PERIOD;
+		float f;
+
+		if(fTime > fEnd)
+		{
+			break;
+		}
+
+		while((k + 2 < uPoints) && (points[k + 1].fTime < fTime))
+		{
+			k++;
+		}
+
+		const TeachPoint &before = points[k];
+		const TeachPoint &after = points[(k + 1 < uPoints) ? k + 1 : k];
+
+		f = (after.fTime > before.fTime) ? (fTime - before.fTime) / (after.fTime - before.fTime) : 0.0;
+		f = fmin(fmax(f, 0.0), 1.0);
+
+		// autonomous starts at the origin facing heading zero, so the recording does too
+
+		memset(&point, 0, sizeof(point));
+		point.fTime = uResampled * TEACH_PERIOD;
+		point.x = before.x + (after.x - before.x) * f - start.x;
+		point.y = before.y + (after.y - before.y) * f - start.y;
+		point.fHeading = before.fHeading + (after.fHeading - before.fHeading) * f - start.fHeading;
+		KiwiFieldToRobot(start.fHeading * KIWI_DEG_TO_RAD, point.x, point.y);
+		uResampled++;
+	}
+
+	return(uResampled);
+}
+
+///True if a line from resampled[uFrom] to resampled[uTo] passes close to every point between
+bool TeachRecorder::Covers(unsigned uFrom, unsigned uTo) const
+{
+	const TeachPoint &from = resampled[uFrom];
+	const TeachPoint &to = resampled[uTo];
+
+	// the steps have to fit in their 16 bits
+
+	if((fabs(to.x - from.x) * TEACH_SCALE > INT16_MAX - 1) ||
+			(fabs(to.y - from.y) * TEACH_SCALE > INT16_MAX - 1) ||
+			(fabs(to.fHeading - from.fHeading) * TEACH_SCALE > INT16_MAX - 1))
+	{
+		return(false);
+	}
+
+	for(unsigned m = uFrom + 1; m < uTo; m++)
+	{
+		float f = (float)(m - uFrom) / (uTo - uFrom);
+
+		if((hypot(from.x + (to.x - from.x) * f - resampled[m].x,
+				from.y + (to.y - from.y) * f - resampled[m].y) > TEACH_TOLERANCE) ||
+				(fabs(from.fHeading + (to.fHeading - from.fHeading) * f - resampled[m].fHeading) >
+						TEACH_HEADING_TOLERANCE))
+		{
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/** Drops the points a line already describes and turns the rest into steps.
+ *
+ * Each step is taken from the rounded values of the previous point, not the exact ones, so
+ * rounding never adds up along the path.  Returns how many steps are in steps[].
+ */
+unsigned TeachRecorder::Compress(unsigned uResampled)
+{
+	int iX = 0;
+	int iY = 0;
+	int iHeading = 0;
+	unsigned uSteps = 0;
+	unsigned uFrom = 0;
+
+	while(uFrom + 1 < uResampled)
+	{
+		unsigned uTo = uFrom + 1;
+
+		while((uTo + 1 < uResampled) && Covers(uFrom, uTo + 1))
+		{
+			uTo++;
+		}
+
+		const TeachPoint &point = resampled[uTo];
+		TeachStep &step = steps[uSteps++];
+		int iNextX = (int)lround(point.x * TEACH_SCALE);
+		int iNextY = (int)lround(point.y * TEACH_SCALE);
+		int iNextHeading = (int)lround(point.fHeading * TEACH_SCALE);
+
+		step.uTicks = uTo - uFrom;
+		step.dx = iNextX - iX;
+		step.dy = iNextY - iY;
+		step.dHeading = iNextHeading - iHeading;
+
+		iX = iNextX;
+		iY = iNextY;
+		iHeading = iNextHeading;
+		uFrom = uTo;
+	}
+
+	return(uSteps);
+}
+
+///Ends the recording and writes it, compressed, to szFileName
+bool TeachRecorder::Stop(const char *szFileName)
+{
+	TeachFileHeader header;
+	char szTempName[256];
+	unsigned uResampled;
+	unsigned uSteps;
+	FILE *pFile;
+	bool bReturn;
+
+	if(!bRecording)
+	{
+		return(false);
+	}
+
+	bRecording = false;
+	uResampled = Resample();
+
+	if(uResampled < 2)
+	{
+		printf("TeachRecorder: nothing was driven\n");
+		return(false);
+	}
+
+	uSteps = Compress(uResampled);
+
+	snprintf(szTempName, sizeof(szTempName), "%s.tmp", szFileName);
+	pFile = fopen(szTempName, "wb");
+
+	if(pFile == NULL)
+	{
+		return(false);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.uMagic = TEACH_MAGIC;
+	header.uVersion = TEACH_VERSION;
+	header.uCount = uSteps;
+	header.fPeriod = TEACH_PERIOD;
+
+	bReturn = (fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+			(fwrite(steps, sizeof(TeachStep), uSteps, pFile) == uSteps);
+
+	if((fclose(pFile) != 0) || !bReturn)
+	{
+		remove(szTempName);
+		return(false);
+	}
+
+	printf("TeachRecorder: %0.2f s, %u ticks, %u points kept, %u bytes\n",
+			resampled[uResampled - 1].fTime, uPoints, uSteps + 1,
+			(unsigned)(sizeof(header) + uSteps * sizeof(TeachStep)));
+
+	return(rename(szTempName, szFileName) == 0);
+}
+
+///Reads a recording written by Stop() and fills trajectory from it
+bool TeachRecorder::Load(const char *szFileName, Trajectory &trajectory)
+{
+	TeachFileHeader header;
+	TeachStep step;
+	std::vector<TrajectorySample> knots;
+	TrajectorySample knot;
+	FILE *pFile = fopen(szFileName, "rb");
+	unsigned uTicks = 0;
+	int iX = 0;
+	int iY = 0;
+	int iHeading = 0;
+	bool bReturn = false;
+
+	if(pFile == NULL)
+	{
+		return(false);
+	}
+
+	if((fread(&header, sizeof(header), 1, pFile) == 1) && (header.uMagic == TEACH_MAGIC) &&
+			(header.uVersion == TEACH_VERSION) && (header.uCount < TEACH_MAX_RESAMPLED) &&
+			(header.fPeriod > 0.0))
+	{
+		memset(&knot, 0, sizeof(knot));
+		knots.reserve(header.uCount + 1);
+		knots.push_back(knot);
+
+		for(unsigned i = 0; i < header.uCount; i++)
+		{
+			if(fread(&step, sizeof(step), 1, pFile) != 1)
+			{
+				break;
+			}
+
+			uTicks += step.uTicks;
+			iX += step.dx;
+			iY += step.dy;
+			iHeading += step.dHeading;
+
+			knot.fTime = uTicks * header.fPeriod;
+			knot.x = iX / TEACH_SCALE;
+			knot.y = iY / TEACH_SCALE;
+			knot.fHeading = iHeading / TEACH_SCALE;
+			knots.push_back(knot);
+		}
+
+		bReturn = (knots.size() == header.uCount + 1) && trajectory.Resample(&knots[0], knots.size());
+	}
+
+	fclose(pFile);
+	return(bReturn);
+}
@@ -0,0 +1,82 @@
+/** \file
+ * Teach and repeat: record a path driven by hand and play it back in autonomous.
+ *
+ * While recording, the drivetrain adds the joystick command and the pose it ended up at every
+ * control tick.  When the recording stops the quiet time before the driver started and after
+ * they stopped is cut off, the path is moved so it starts at the origin facing heading zero,
+ * as autonomous does, and it is resampled every TEACH_PERIOD.  Points a straight line through
+ * their neighbours already describes within tolerance are dropped, and what is left is stored
+ * as small integer steps from one point to the next.
+ *
+ * A recording in the path cache directory is followed with TRAJECTORY like any other
+ * trajectory file; the planner turns it back into samples at the control rate.
+ */
+
+#ifndef TEACH_RECORDER_H
+#define TEACH_RECORDER_H
+
+#include <stdint.h>
+
+#include "KiwiOdometry.h"
+#include "Trajectory.h"
+
+const float TEACH_MAX_TIME = 15.0;					//seconds, recording stops by itself after this
+const unsigned TEACH_MAX_POINTS = 1600;				//TEACH_MAX_TIME at the control rate, and then some
+const float TEACH_PERIOD = 0.02;					//seconds between points after resampling
+const unsigned TEACH_MAX_RESAMPLED = 751;			//TEACH_MAX_TIME / TEACH_PERIOD + 1
+const float TEACH_TOLERANCE = 0.5;					//inches a dropped point may be off the line
+const float TEACH_HEADING_TOLERANCE = 1.0;			//degrees
+const float TEACH_IDLE_COMMAND = 0.05;				//stick values smaller than this are not driving
+const float TEACH_SETTLE_TIME = 0.5;				//seconds kept after the last command, the robot coasts
+const float TEACH_SCALE = 100.0;					//steps are stored in hundredths of an inch or degree
+const uint32_t TEACH_MAGIC = 0x48434554;			//"TECH"
+const uint32_t TEACH_VERSION = 1;
+const char* const TEACH_FILE_NAME = "taught.teach";	//in PATH_CACHE_DIR, each recording replaces the last
+
+///One control tick of a recording
+struct TeachPoint {
+	float fTime;				//!< seconds from the start of the recording
+	float x, y, fHeading;		//!< pose, inches and degrees
+	float fDriveX, fDriveY, fDriveR;	//!< the joystick command, only used to find where driving starts
+};
+
+///The header at the front of a recording file, followed by uCount steps
+struct TeachFileHeader {
+	uint32_t uMagic;
+	uint32_t uVersion;
+	uint32_t uCount;
+	float fPeriod;				//!< seconds per tick of TeachStep::uTicks
+};
+
+///From one kept point to the next, in TEACH_SCALE units
+struct TeachStep {
+	uint16_t uTicks;
+	int16_t dx, dy, dHeading;
+};
+
+class TeachRecorder
+{
+public:
+	TeachRecorder();
+
+	void Start();
+	bool IsRecording() const { return(bRecording); };
+	void Add(double fTime, const RobotPose &pose, float fDriveX, float fDriveY, float fDriveR);
+	bool Stop(const char *szFileName);
+
+	static bool Load(const char *szFileName, Trajectory &trajectory);
+
+private:
+	TeachPoint points[TEACH_MAX_POINTS];
+	TeachPoint resampled[TEACH_MAX_RESAMPLED];
+	TeachStep steps[TEACH_MAX_RESAMPLED];
+	unsigned uPoints;
+	double fStartTime;
+	bool bRecording;
+
+	unsigned Resample();
+	unsigned Compress(unsigned uResampled);
+	bool Covers(unsigned uFrom, unsigned uTo) const;
+};
+
+#endif //TEACH_RECORDER_H
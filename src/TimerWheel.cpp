@@ -0,0 +1,354 @@
+/** \file
+ * Central timer service.
+ *
+ * Time is counted in ticks since the service started.  A timer lives in the lowest wheel
+ * whose span covers the time left until it expires.  Whenever a wheel wraps, the next slot of
+ * the wheel above it is emptied back into the wheels below, so by the time a timer is due it
+ * has reached the first wheel and fires on its own tick.  Callbacks run on the timer task with
+ * the wheel unlocked, so they may add or cancel timers.
+ */
+
+#include "TimerWheel.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "RobotClock.h"
+#include "RobotParams.h"
+
+TimerWheel *TimerWheel::pInstance = NULL;
+
+TimerWheel *TimerWheel::GetInstance()
+{
+	if(pInstance == NULL)
+	{
+		pInstance = new TimerWheel();
+	}
+
+	return(pInstance);
+}
+
+double TimerWheel::GetTime()
+{
+	return(RobotClock::GetTime());
+}
+
+TimerWheel::TimerWheel()
+{
+	for(unsigned i = 0; i < TIMER_WHEEL_MAX_TIMERS; i++)
+	{
+		timers[i].pCallback = NULL;
+		timers[i].pThis = NULL;
+		timers[i].uCookie = 0;
+		timers[i].uExpiry = 0;
+		timers[i].uGeneration = 1;
+		timers[i].iNext = (i + 1 < TIMER_WHEEL_MAX_TIMERS) ? (int)(i + 1) : -1;
+		timers[i].iPrev = -1;
+		timers[i].iSlot = -1;
+	}
+
+	for(unsigned i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++)
+	{
+		iSlotHead[i] = -1;
+	}
+
+	fStartTime = GetTime();
+	uNow = 0;
+	iFree = 0;
+	uActive = 0;
+
+	RobotClock::InitCondition(&wheelCond);
+	pthread_mutex_init(&wheelMutex, NULL);
+
+	pTask = new Task(TIMER_TASKNAME, (FUNCPTR) &TimerWheel::StartTask,
+			TIMER_PRIORITY, TIMER_STACKSIZE);
+	wpi_assert(pTask);
+	pTask->Start((intptr_t)this);
+}
+
+TimerWheel::~TimerWheel()
+{
+	delete(pTask);
+	pthread_cond_destroy(&wheelCond);
+	pthread_mutex_destroy(&wheelMutex);
+}
+
+unsigned long long TimerWheel::TimeToTick(double fTime, bool bRoundUp)
+{
+	double fTicks = (fTime - fStartTime) * (1000000.0 / TIMER_WHEEL_TICK_USEC);
+
+	if(fTicks <= 0.0)
+	{
+		return(0);
+	}
+
+	// deadlines round up so a timer never fires early
+
+	if(bRoundUp)
+	{
+		return((unsigned long long)ceil(fTicks));
+	}
+
+	return((unsigned long long)fTicks);
+}
+
+/** Arms a timer for the absolute robot clock time fDeadline.
+ *
+ * Returns a handle for Cancel(), or TIMER_WHEEL_NONE if every timer is in use.
+ */
+unsigned TimerWheel::Add(double fDeadline, TimerCallback pCallback, void *pThis, unsigned uCookie)
+{
+	unsigned uHandle;
+	int iTimer;
+
+	pthread_mutex_lock(&wheelMutex);
+
+	if(iFree < 0)
+	{
+		pthread_mutex_unlock(&wheelMutex);
+		printf("TimerWheel: out of timers\n");
+		return(TIMER_WHEEL_NONE);
+	}
+
+	// an empty wheel may have slept a long time, skip the ticks it never needed to visit
+
+	if(uActive == 0)
+	{
+		unsigned long long uCurrent = TimeToTick(GetTime(), false);
+
+		if(uCurrent > uNow)
+		{
+			uNow = uCurrent;
+		}
+	}
+
+	iTimer = iFree;
+	iFree = timers[iTimer].iNext;
+
+	timers[iTimer].pCallback = pCallback;
+	timers[iTimer].pThis = pThis;
+	timers[iTimer].uCookie = uCookie;
+	timers[iTimer].uExpiry = TimeToTick(fDeadline, true);
+
+	// anything already due goes off on the next tick
+
+	if(timers[iTimer].uExpiry <= uNow)
+	{
+		timers[iTimer].uExpiry = uNow + 1;
+	}
+
+	Insert(iTimer);
+	uActive++;
+
+	uHandle = (timers[iTimer].uGeneration << 8) | iTimer;
+
+	// it may be due before whatever the timer task is sleeping for
+
+	RobotClock::Signal(&wheelCond);
+	pthread_mutex_unlock(&wheelMutex);
+	return(uHandle);
+}
+
+///Returns true if the timer was stopped before it fired
+bool TimerWheel::Cancel(unsigned uHandle)
+{
+	unsigned uTimer = uHandle & 0xff;
+	bool bCancelled = false;
+
+	if((uHandle == TIMER_WHEEL_NONE) || (uTimer >= TIMER_WHEEL_MAX_TIMERS))
+	{
+		return(false);
+	}
+
+	pthread_mutex_lock(&wheelMutex);
+
+	if((timers[uTimer].iSlot >= 0) && (timers[uTimer].uGeneration == (uHandle >> 8)))
+	{
+		Unlink(uTimer);
+		Release(uTimer);
+		bCancelled = true;
+	}
+
+	pthread_mutex_unlock(&wheelMutex);
+	return(bCancelled);
+}
+
+///Cancels every timer armed by pThis, for shutting a component down
+void TimerWheel::CancelOwner(void *pThis)
+{
+	pthread_mutex_lock(&wheelMutex);
+
+	for(unsigned i = 0; i < TIMER_WHEEL_MAX_TIMERS; i++)
+	{
+		if((timers[i].iSlot >= 0) && (timers[i].pThis == pThis))
+		{
+			Unlink(i);
+			Release(i);
+		}
+	}
+
+	pthread_mutex_unlock(&wheelMutex);
+}
+
+///Puts a timer in the lowest wheel that reaches its expiry, called with the wheel locked
+void TimerWheel::Insert(int iTimer)
+{
+	unsigned long long uExpiry = timers[iTimer].uExpiry;
+	unsigned long long uDelta;
+	unsigned uLevel = 0;
+	int iSlot;
+
+	// a timer cascading down on its own tick belongs in the slot about to fire
+
+	if(uExpiry < uNow)
+	{
+		uExpiry = uNow;
+	}
+
+	uDelta = uExpiry - uNow;
+
+	while((uLevel < TIMER_WHEEL_LEVELS - 1) && (uDelta >= (1ULL << (TIMER_WHEEL_BITS * (uLevel + 1)))))
+	{
+		uLevel++;
+	}
+
+	// past the top wheel we park it as far out as we can and it cascades again from there
+
+	if(uDelta >= (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+	{
+		uExpiry = uNow + (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+	}
+
+	iSlot = uLevel * TIMER_WHEEL_SLOTS + ((uExpiry >> (TIMER_WHEEL_BITS * uLevel)) & (TIMER_WHEEL_SLOTS - 1));
+
+	timers[iTimer].iSlot = iSlot;
+	timers[iTimer].iPrev = -1;
+	timers[iTimer].iNext = iSlotHead[iSlot];
+
+	if(iSlotHead[iSlot] >= 0)
+	{
+		timers[iSlotHead[iSlot]].iPrev = iTimer;
+	}
+
+	iSlotHead[iSlot] = iTimer;
+}
+
+void TimerWheel::Unlink(int iTimer)
+{
+	TimerEntry &timer = timers[iTimer];
+
+	if(timer.iPrev >= 0)
+	{
+		timers[timer.iPrev].iNext = timer.iNext;
+	}
+	else
+	{
+		iSlotHead[timer.iSlot] = timer.iNext;
+	}
+
+	if(timer.iNext >= 0)
+	{
+		timers[timer.iNext].iPrev = timer.iPrev;
+	}
+
+	timer.iSlot = -1;
+}
+
+void TimerWheel::Release(int iTimer)
+{
+	// a new generation makes any handle still held for this timer harmless
+
+	timers[iTimer].uGeneration = (timers[iTimer].uGeneration + 1) & 0xffffff;
+
+	if(timers[iTimer].uGeneration == 0)
+	{
+		timers[iTimer].uGeneration = 1;
+	}
+
+	timers[iTimer].iSlot = -1;
+	timers[iTimer].iNext = iFree;
+	iFree = iTimer;
+	uActive--;
+}
+
+/** The next tick the timer task has to visit.
+ *
+ * That is the next occupied slot of the first wheel, or the next time it wraps and the wheel
+ * above has to be cascaded, whichever comes first.
+ */
+unsigned long long TimerWheel::NextExpiry()
+{
+	unsigned long long uTick = uNow + 1;
+
+	while(((uTick & (TIMER_WHEEL_SLOTS - 1)) != 0) && (iSlotHead[uTick & (TIMER_WHEEL_SLOTS - 1)] < 0))
+	{
+		uTick++;
+	}
+
+	return(uTick);
+}
+
+void TimerWheel::DoTimers()
+{
+	pthread_mutex_lock(&wheelMutex);
+
+	while(true)
+	{
+		unsigned long long uCurrent = TimeToTick(GetTime(), false);
+
+		while(uNow < uCurrent)
+		{
+			int iSlot;
+
+			uNow++;
+
+			// every time a wheel wraps, the slot above it is due to move down
+
+			for(unsigned uLevel = 1; uLevel < TIMER_WHEEL_LEVELS; uLevel++)
+			{
+				if((uNow & ((1ULL << (TIMER_WHEEL_BITS * uLevel)) - 1)) != 0)
+				{
+					break;
+				}
+
+				iSlot = uLevel * TIMER_WHEEL_SLOTS + ((uNow >> (TIMER_WHEEL_BITS * uLevel)) & (TIMER_WHEEL_SLOTS - 1));
+
+				while(iSlotHead[iSlot] >= 0)
+				{
+					int iTimer = iSlotHead[iSlot];
+
+					Unlink(iTimer);
+					Insert(iTimer);
+				}
+			}
+
+			iSlot = uNow & (TIMER_WHEEL_SLOTS - 1);
+
+			while(iSlotHead[iSlot] >= 0)
+			{
+				int iTimer = iSlotHead[iSlot];
+				TimerCallback pCallback = timers[iTimer].pCallback;
+				void *pThis = timers[iTimer].pThis;
+				unsigned uCookie = timers[iTimer].uCookie;
+
+				Unlink(iTimer);
+				Release(iTimer);
+
+				pthread_mutex_unlock(&wheelMutex);
+				pCallback(pThis, uCookie);
+				pthread_mutex_lock(&wheelMutex);
+			}
+		}
+
+		if(uActive == 0)
+		{
+			RobotClock::GetInstance()->WaitCondition(&wheelCond, &wheelMutex, CLOCK_FOREVER);
+		}
+		else
+		{
+			RobotClock::GetInstance()->WaitCondition(&wheelCond, &wheelMutex,
+					fStartTime + NextExpiry() * (TIMER_WHEEL_TICK_USEC * 1.0e-6));
+		}
+	}
+}
@@ -0,0 +1,84 @@
+/** \file
+ * Central timer service.
+ *
+ * A hierarchical timer wheel on the robot clock.  Timers are set for an absolute deadline,
+ * so a wait never picks up error from how long the code around it took.  The first wheel holds
+ * the next TIMER_WHEEL_SLOTS ticks one slot per tick; each wheel above it covers the whole
+ * wheel below it per slot and its timers cascade down as time reaches them.  Adding and
+ * cancelling are constant time and the timer task only wakes when something is due.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <pthread.h>
+
+#include "WPILib.h"
+
+const unsigned TIMER_WHEEL_TICK_USEC = 1000;		//resolution of every timer
+const unsigned TIMER_WHEEL_BITS = 6;
+const unsigned TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+const unsigned TIMER_WHEEL_LEVELS = 4;				//64^4 ms is about 4.6 hours
+const unsigned TIMER_WHEEL_MAX_TIMERS = 64;
+const unsigned TIMER_WHEEL_NONE = 0;				//never a valid timer handle
+
+///Called from the timer task when a timer expires.  Keep it short, it holds up other timers.
+typedef void (*TimerCallback)(void *pThis, unsigned uCookie);
+
+class TimerWheel
+{
+public:
+	static TimerWheel *GetInstance();
+	static double GetTime();
+
+	unsigned Add(double fDeadline, TimerCallback pCallback, void *pThis, unsigned uCookie);
+	unsigned AddDelay(double fDelay, TimerCallback pCallback, void *pThis, unsigned uCookie)
+	{
+		return(Add(GetTime() + fDelay, pCallback, pThis, uCookie));
+	}
+	bool Cancel(unsigned uHandle);
+	void CancelOwner(void *pThis);
+
+	static void *StartTask(void *pThis)
+	{
+		((TimerWheel *)pThis)->DoTimers();
+		return(NULL);
+	}
+
+private:
+	struct TimerEntry {
+		TimerCallback pCallback;
+		void *pThis;
+		unsigned uCookie;
+		unsigned long long uExpiry;		//in ticks
+		unsigned uGeneration;			//bumped on reuse so stale handles do nothing
+		int iNext;						//slot list, or free list when unused
+		int iPrev;
+		int iSlot;						//level * TIMER_WHEEL_SLOTS + slot, -1 when not in the wheel
+	};
+
+	static TimerWheel *pInstance;
+
+	Task *pTask;
+	pthread_mutex_t wheelMutex;
+	pthread_cond_t wheelCond;
+	TimerEntry timers[TIMER_WHEEL_MAX_TIMERS];
+	int iSlotHead[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+
+	double fStartTime;
+	unsigned long long uNow;			//last tick processed
+	int iFree;
+	unsigned uActive;
+
+	TimerWheel();
+	~TimerWheel();
+
+	unsigned long long TimeToTick(double fTime, bool bRoundUp);
+	void Insert(int iTimer);
+	void Unlink(int iTimer);
+	void Release(int iTimer);
+	unsigned long long NextExpiry();
+	void DoTimers();
+};
+
+#endif //TIMER_WHEEL_H
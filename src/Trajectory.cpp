@@ -0,0 +1,434 @@
+/** \file
+ * Holonomic trajectory generation for the kiwi base.
+ *
+ * The path between waypoints is a Catmull-Rom spline, so it passes through every waypoint
+ * with a continuous direction.  It is cut into a dense list of points about TRAJECTORY_STEP
+ * apart in wheel travel.  Each point gets a speed limit from the velocity limit and from the
+ * curvature of the path; a forward pass limits acceleration out of each point and a backward
+ * pass limits deceleration into it.  Time comes from integrating that speed profile, and the
+ * result is resampled at TRAJECTORY_PERIOD.
+ */
+
+#include "Trajectory.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "RobotParams.h"
+#include "KiwiKinematics.h"
+
+///A point of the dense path before it is resampled in time
+struct PathPoint {
+	float x, y, fHeading;
+	float fTravel;				//wheel travel from the start, inches
+	float fSpeed;				//wheel speed, inches/s
+	double fTime;
+};
+
+static float CatmullRom(float p0, float p1, float p2, float p3, float t)
+{
+	return(0.5f * ((2.0f * p1) + (p2 - p0) * t +
+			(2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t +
+			(3.0f * p1 - p0 - 3.0f * p2 + p3) * t * t * t));
+}
+
+///Curvature of the circle through three points, 0 if they are in a line
+static float Curvature(const PathPoint &a, const PathPoint &b, const PathPoint &c)
+{
+	float fAB = hypotf(b.x - a.x, b.y - a.y);
+	float fBC = hypotf(c.x - b.x, c.y - b.y);
+	float fCA = hypotf(a.x - c.x, a.y - c.y);
+	float fCross = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+
+	if((fAB < 1.0e-4f) || (fBC < 1.0e-4f) || (fCA < 1.0e-4f))
+	{
+		return(0.0f);
+	}
+
+	return(2.0f * fabsf(fCross) / (fAB * fBC * fCA));
+}
+
+Trajectory::Trajectory()
+{
+	uKey = 0;
+	pSamples = NULL;
+	uCount = 0;
+	pMap = NULL;
+	uMapSize = 0;
+}
+
+Trajectory::~Trajectory()
+{
+	Release();
+}
+
+///Drops the samples, unmapping the file or freeing the generated ones
+void Trajectory::Release()
+{
+	if(pMap != NULL)
+	{
+		munmap(pMap, uMapSize);
+		pMap = NULL;
+		uMapSize = 0;
+	}
+
+	std::vector<TrajectorySample>().swap(samples);
+	pSamples = NULL;
+	uCount = 0;
+}
+
+///FNV-1a of a name, for trajectories that come from a file rather than waypoints
+uint64_t Trajectory::MakeKey(const char *szName)
+{
+	uint64_t uHash = 14695981039346656037ULL;
+
+	while(*szName != '\0')
+	{
+		uHash ^= (unsigned char)*szName++;
+		uHash *= 1099511628211ULL;
+	}
+
+	return(uHash);
+}
+
+///FNV-1a over the format version, the limits and the waypoints
+uint64_t Trajectory::MakeKey(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+		const TrajectoryLimits &limits)
+{
+	uint64_t uHash = 14695981039346656037ULL;
+	const unsigned char *pBytes;
+
+	struct {
+		const void *pData;
+		size_t uSize;
+	} parts[] = {
+			{ &TRAJECTORY_VERSION,	sizeof(TRAJECTORY_VERSION) },
+			{ &limits,				sizeof(limits) },
+			{ &uWaypoints,			sizeof(uWaypoints) },
+			{ pWaypoints,			uWaypoints * sizeof(TrajectoryWaypoint) },
+	};
+
+	for(unsigned i = 0; i < sizeof(parts) / sizeof(parts[0]); i++)
+	{
+		pBytes = (const unsigned char *)parts[i].pData;
+
+		for(size_t u = 0; u < parts[i].uSize; u++)
+		{
+			uHash ^= pBytes[u];
+			uHash *= 1099511628211ULL;
+		}
+	}
+
+	return(uHash);
+}
+
+bool Trajectory::Generate(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+		const TrajectoryLimits &limits)
+{
+	std::vector<PathPoint> path;
+	PathPoint point;
+	unsigned k;
+
+	Release();
+	uKey = MakeKey(pWaypoints, uWaypoints, limits);
+
+	if((uWaypoints < 2) || (uWaypoints > TRAJECTORY_MAX_WAYPOINTS) ||
+			(limits.fMaxVelocity <= 0.0) || (limits.fMaxAccel <= 0.0))
+	{
+		return(false);
+	}
+
+	// cut the spline into short pieces, turning counts as wheel travel
+
+	memset(&point, 0, sizeof(point));
+	point.x = pWaypoints[0].x;
+	point.y = pWaypoints[0].y;
+	point.fHeading = pWaypoints[0].fHeading;
+	path.push_back(point);
+
+	for(unsigned i = 0; i + 1 < uWaypoints; i++)
+	{
+		const TrajectoryWaypoint &p0 = pWaypoints[(i > 0) ? i - 1 : i];
+		const TrajectoryWaypoint &p1 = pWaypoints[i];
+		const TrajectoryWaypoint &p2 = pWaypoints[i + 1];
+		const TrajectoryWaypoint &p3 = pWaypoints[(i + 2 < uWaypoints) ? i + 2 : i + 1];
+		float fLength = hypotf(p2.x - p1.x, p2.y - p1.y) +
+				DRIVETRAIN_BASE_RADIUS * fabsf(p2.fHeading - p1.fHeading) * KIWI_DEG_TO_RAD;
+		unsigned uSteps = (unsigned)ceilf(fLength / TRAJECTORY_STEP);
+
+		if(uSteps == 0)
+		{
+			continue;
+		}
+
+		for(unsigned j = 1; j <= uSteps; j++)
+		{
+			float t = (float)j / uSteps;
+			const PathPoint &last = path.back();
+
+			point.x = CatmullRom(p0.x, p1.x, p2.x, p3.x, t);
+			point.y = CatmullRom(p0.y, p1.y, p2.y, p3.y, t);
+			point.fHeading = p1.fHeading + (p2.fHeading - p1.fHeading) * t;
+			point.fTravel = last.fTravel + sqrtf((point.x - last.x) * (point.x - last.x) +
+					(point.y - last.y) * (point.y - last.y) +
+					powf(DRIVETRAIN_BASE_RADIUS * (point.fHeading - last.fHeading) * KIWI_DEG_TO_RAD, 2));
+			path.push_back(point);
+		}
+	}
+
+	if(path.size() < 2)
+	{
+		return(false);
+	}
+
+	// speed limits: the velocity limit, and no more sideways acceleration than forward
+
+	for(k = 0; k < path.size(); k++)
+	{
+		float fKappa = ((k > 0) && (k + 1 < path.size())) ? Curvature(path[k - 1], path[k], path[k + 1]) : 0.0;
+
+		path[k].fSpeed = limits.fMaxVelocity;
+
+		if(fKappa > 1.0e-6)
+		{
+			path[k].fSpeed = fminf(path[k].fSpeed, sqrtf(limits.fMaxAccel / fKappa));
+		}
+	}
+
+	// start and stop at rest, and accelerate and brake within the limit
+
+	path.front().fSpeed = 0.0;
+	path.back().fSpeed = 0.0;
+
+	for(k = 1; k < path.size(); k++)
+	{
+		float fStep = path[k].fTravel - path[k - 1].fTravel;
+
+		path[k].fSpeed = fminf(path[k].fSpeed,
+				sqrtf(path[k - 1].fSpeed * path[k - 1].fSpeed + 2.0f * limits.fMaxAccel * fStep));
+	}
+
+	for(k = path.size() - 1; k > 0; k--)
+	{
+		float fStep = path[k].fTravel - path[k - 1].fTravel;
+
+		path[k - 1].fSpeed = fminf(path[k - 1].fSpeed,
+				sqrtf(path[k].fSpeed * path[k].fSpeed + 2.0f * limits.fMaxAccel * fStep));
+	}
+
+	// constant acceleration between points
+
+	path[0].fTime = 0.0;
+
+	for(k = 1; k < path.size(); k++)
+	{
+		float fStep = path[k].fTravel - path[k - 1].fTravel;
+		float fSpeed = path[k].fSpeed + path[k - 1].fSpeed;
+
+		path[k].fTime = path[k - 1].fTime + ((fSpeed > 0.0) ? 2.0f * fStep / fSpeed : 0.0);
+	}
+
+	// resample on the control period
+
+	std::vector<TrajectorySample> knots(path.size());
+
+	for(k = 0; k < path.size(); k++)
+	{
+		memset(&knots[k], 0, sizeof(TrajectorySample));
+		knots[k].fTime = path[k].fTime;
+		knots[k].x = path[k].x;
+		knots[k].y = path[k].y;
+		knots[k].fHeading = path[k].fHeading;
+	}
+
+	return(Resample(&knots[0], knots.size()));
+}
+
+/** Fills the trajectory from poses at increasing times, sampled every TRAJECTORY_PERIOD.
+ *
+ * Only the time and pose of the knots are used.  Poses in between are interpolated and the
+ * velocity and acceleration come from central differences, at rest at both ends.
+ */
+bool Trajectory::Resample(const TrajectorySample *pKnots, unsigned uKnots)
+{
+	unsigned uSamples;
+	unsigned k = 0;
+
+	Release();
+
+	if(uKnots < 2)
+	{
+		return(false);
+	}
+
+	uSamples = (unsigned)ceil(pKnots[uKnots - 1].fTime / TRAJECTORY_PERIOD) + 1;
+
+	if(uSamples > TRAJECTORY_MAX_SAMPLES)
+	{
+		printf("Trajectory: %0.1f seconds is too long\n", pKnots[uKnots - 1].fTime);
+		return(false);
+	}
+
+	samples.resize(uSamples);
+
+	for(unsigned i = 0; i < uSamples; i++)
+	{
+		TrajectorySample &sample = samples[i];
+		double fTime = fmin(i * TRAJECTORY_PERIOD, pKnots[uKnots - 1].fTime);
+		const TrajectorySample *pBefore;
+		const TrajectorySample *pAfter;
+		float f;
+
+		while((k + 2 < uKnots) && (pKnots[k + 1].fTime < fTime))
+		{
+			k++;
+		}
+
+		pBefore = &pKnots[k];
+		pAfter = &pKnots[k + 1];
+		f = (pAfter->fTime > pBefore->fTime) ? (fTime - pBefore->fTime) / (pAfter->fTime - pBefore->fTime) : 1.0;
+
+		memset(&sample, 0, sizeof(sample));
+		sample.fTime = fTime;
+		sample.x = pBefore->x + (pAfter->x - pBefore->x) * f;
+		sample.y = pBefore->y + (pAfter->y - pBefore->y) * f;
+		sample.fHeading = pBefore->fHeading + (pAfter->fHeading - pBefore->fHeading) * f;
+	}
+
+	// velocity and acceleration by central differences, at rest at both ends
+
+	for(int iPass = 0; iPass < 2; iPass++)
+	{
+		for(unsigned i = 1; i + 1 < uSamples; i++)
+		{
+			TrajectorySample &sample = samples[i];
+			const TrajectorySample &before = samples[i - 1];
+			const TrajectorySample &after = samples[i + 1];
+			float fSpan = after.fTime - before.fTime;
+
+			if(fSpan <= 0.0)
+			{
+				continue;
+			}
+
+			if(iPass == 0)
+			{
+				sample.vx = (after.x - before.x) / fSpan;
+				sample.vy = (after.y - before.y) / fSpan;
+				sample.fRate = (after.fHeading - before.fHeading) / fSpan;
+			}
+			else
+			{
+				sample.ax = (after.vx - before.vx) / fSpan;
+				sample.ay = (after.vy - before.vy) / fSpan;
+				sample.fAngularAccel = (after.fRate - before.fRate) / fSpan;
+			}
+		}
+	}
+
+	pSamples = &samples[0];
+	uCount = uSamples;
+	return(true);
+}
+
+/** Maps a trajectory saved by Save() read-only.
+ *
+ * Fails if the file was made from anything but uExpectedKey, unless that is
+ * TRAJECTORY_ANY_KEY.  The samples stay in the page cache rather than on the heap.
+ */
+bool Trajectory::Load(const char *szFileName, uint64_t uExpectedKey)
+{
+	const TrajectoryFileHeader *pHeader;
+	struct stat status;
+	int iFile;
+
+	Release();
+
+	iFile = open(szFileName, O_RDONLY);
+
+	if(iFile < 0)
+	{
+		return(false);
+	}
+
+	if((fstat(iFile, &status) == 0) && (status.st_size >= (off_t)sizeof(TrajectoryFileHeader)))
+	{
+		uMapSize = status.st_size;
+		pMap = mmap(NULL, uMapSize, PROT_READ, MAP_SHARED, iFile, 0);
+
+		if(pMap == MAP_FAILED)
+		{
+			pMap = NULL;
+			uMapSize = 0;
+		}
+	}
+
+	close(iFile);
+
+	if(pMap == NULL)
+	{
+		return(false);
+	}
+
+	pHeader = (const TrajectoryFileHeader *)pMap;
+
+	if((pHeader->uMagic != TRAJECTORY_MAGIC) || (pHeader->uVersion != TRAJECTORY_VERSION) ||
+			((uExpectedKey != TRAJECTORY_ANY_KEY) && (pHeader->uKey != uExpectedKey)) ||
+			(pHeader->uSampleSize != sizeof(TrajectorySample)) ||
+			(pHeader->uCount == 0) || (pHeader->uCount > TRAJECTORY_MAX_SAMPLES) ||
+			(uMapSize < sizeof(TrajectoryFileHeader) + pHeader->uCount * sizeof(TrajectorySample)))
+	{
+		Release();
+		return(false);
+	}
+
+	uKey = pHeader->uKey;
+	uCount = pHeader->uCount;
+	pSamples = (const TrajectorySample *)(pHeader + 1);
+	return(true);
+}
+
+///Writes to a temporary file and renames it, so a reader never sees half a trajectory
+bool Trajectory::Save(const char *szFileName) const
+{
+	TrajectoryFileHeader header;
+	char szTempName[256];
+	FILE *pFile;
+	bool bReturn;
+
+	if(uCount == 0)
+	{
+		return(false);
+	}
+
+	snprintf(szTempName, sizeof(szTempName), "%s.tmp", szFileName);
+	pFile = fopen(szTempName, "wb");
+
+	if(pFile == NULL)
+	{
+		return(false);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.uMagic = TRAJECTORY_MAGIC;
+	header.uVersion = TRAJECTORY_VERSION;
+	header.uKey = uKey;
+	header.uCount = uCount;
+	header.uSampleSize = sizeof(TrajectorySample);
+
+	bReturn = (fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+			(fwrite(pSamples, sizeof(TrajectorySample), uCount, pFile) == uCount);
+
+	if((fclose(pFile) != 0) || !bReturn)
+	{
+		remove(szTempName);
+		return(false);
+	}
+
+	return(rename(szTempName, szFileName) == 0);
+}
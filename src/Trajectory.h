@@ -0,0 +1,102 @@
+/** \file
+ * Holonomic trajectories for the kiwi base.
+ *
+ * A path is a list of field frame waypoints, each with the heading the robot should have when
+ * it gets there.  The generator runs a spline through the waypoints, turns the heading between
+ * them into wheel travel with DRIVETRAIN_BASE_RADIUS so translation and rotation share one set
+ * of limits, and time-parameterizes the result with a forward and backward pass over the
+ * velocity and acceleration limits.  The output is sampled every TRAJECTORY_PERIOD seconds so
+ * a follower can step through it one sample per control tick.
+ *
+ * Trajectories are saved to disk keyed by a hash of everything that went into them, so an
+ * unchanged path is read back instead of generated again.  The file is a small header and then
+ * the samples exactly as they sit in memory, so loading one maps the file read-only and points
+ * at it: there is nothing to parse and no heap to allocate however long the trajectory is.
+ * Files made off the robot in the same format can be mapped the same way.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+const float TRAJECTORY_PERIOD = 0.01;			//seconds between samples, the drivetrain control period
+const float TRAJECTORY_STEP = 0.25;				//inches of wheel travel between points of the dense path
+const unsigned TRAJECTORY_MAX_WAYPOINTS = 32;
+const unsigned TRAJECTORY_MAX_SAMPLES = 6000;	//a minute of driving
+const uint32_t TRAJECTORY_MAGIC = 0x4a415254;	//"TRAJ"
+const uint32_t TRAJECTORY_VERSION = 1;
+const uint64_t TRAJECTORY_ANY_KEY = 0;			//Load() takes the file whatever made it
+
+///Where the path goes, field frame
+struct TrajectoryWaypoint {
+	float x;					//!< inches
+	float y;					//!< inches
+	float fHeading;				//!< degrees, same sense as the gyro
+};
+
+///Limits on wheel surface speed, shared by translation and rotation
+struct TrajectoryLimits {
+	float fMaxVelocity;			//!< inches/s
+	float fMaxAccel;			//!< inches/s/s
+};
+
+///One step of a trajectory, field frame
+struct TrajectorySample {
+	float fTime;				//!< seconds from the start
+	float x, y, fHeading;		//!< inches, degrees
+	float vx, vy, fRate;		//!< inches/s, degrees/s
+	float ax, ay, fAngularAccel; //!< inches/s/s, degrees/s/s
+};
+
+/** The header at the front of a trajectory file, followed by uCount samples.
+ *
+ * Everything is native byte order and 4 byte aligned, the samples start right after the
+ * header so they can be used straight out of the mapped file.
+ */
+struct TrajectoryFileHeader {
+	uint32_t uMagic;
+	uint32_t uVersion;
+	uint64_t uKey;				//!< hash of the waypoints and limits
+	uint32_t uCount;
+	uint32_t uSampleSize;		//!< sizeof(TrajectorySample) when it was written
+};
+
+class Trajectory
+{
+public:
+	Trajectory();
+	~Trajectory();
+
+	static uint64_t MakeKey(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+			const TrajectoryLimits &limits);
+	static uint64_t MakeKey(const char *szName);
+
+	bool Generate(const TrajectoryWaypoint *pWaypoints, unsigned uWaypoints,
+			const TrajectoryLimits &limits);
+	bool Resample(const TrajectorySample *pKnots, unsigned uKnots);
+	bool Load(const char *szFileName, uint64_t uExpectedKey);
+	bool Save(const char *szFileName) const;
+
+	uint64_t GetKey() const { return(uKey); };
+	unsigned GetSize() const { return(uCount); };
+	const TrajectorySample &GetSample(unsigned uIndex) const { return(pSamples[uIndex]); };
+	float GetDuration() const { return((uCount == 0) ? 0.0 : pSamples[uCount - 1].fTime); };
+
+private:
+	uint64_t uKey;
+	const TrajectorySample *pSamples;	//either samples or the mapped file
+	unsigned uCount;
+	std::vector<TrajectorySample> samples;	//only used when the samples are computed here
+	void *pMap;
+	size_t uMapSize;
+
+	void Release();
+
+	Trajectory(const Trajectory &);
+	Trajectory &operator=(const Trajectory &);
+};
+
+#endif //TRAJECTORY_H